@@ -1,15 +1,45 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <bitset>
+#include <cassert>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <exception>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using usize   = std::size_t;
 using ptrdiff = std::ptrdiff_t;
 using intptr  = std::intptr_t;
@@ -23,1279 +53,8639 @@ using i32     = std::int32_t;
 using u64     = std::uint64_t;
 using i64     = std::int64_t;
 using f32     = float;
+using f64     = double;
 using f128    = long double;
 
+// Types that can be moved to another address with a plain memcpy, leaving the source as raw storage. Specialize this
+// for handle types that are safe to relocate bitwise even though they are not trivially copyable.
 template <typename T>
-class Vec
+struct IsTriviallyRelocatable : std::bool_constant<std::is_trivially_copyable_v<T>>
 {
-private:
-    T*    m_Buffer   = nullptr;
-    usize m_Size     = 0;
-    usize m_Capacity = 0;
+};
+template <typename T>
+inline constexpr bool TriviallyRelocatable = IsTriviallyRelocatable<T>::value;
 
+// Allocators hand out raw bytes and get the same size and alignment back on Deallocate(). They are stored inside the
+// container, so stateful allocators are cheap handles to a shared resource rather than the resource itself.
+class HeapAllocator
+{
 public:
-    class ConstIterator;
-    class Iterator
+    inline void* Allocate(const usize size, const usize alignment)
     {
-        friend class ConstIterator;
-
-        using iterator_category = std::input_iterator_tag;
-        using difference_type   = ptrdiff;
-        using value_type        = T;
-        using pointer           = value_type*;
-        using reference         = value_type&;
-
-    private:
-        pointer m_Ptr;
-
-    public:
-        explicit Iterator(pointer ptr) noexcept : m_Ptr(ptr) {}
-
-    public:
-        constexpr reference operator*() const noexcept { return *m_Ptr; }
-        constexpr pointer   operator->() const noexcept { return m_Ptr; };
-        inline Iterator&    operator++() noexcept
-        {
-            ++m_Ptr;
-            return *this;
-        }
-        Iterator operator++(const i32) noexcept
-        {
-            auto t = *this;
-            ++(*this);
-            return t;
-        }
-        constexpr ptrdiff operator-(const Iterator& other) const noexcept { return m_Ptr - other.m_Ptr; }
-        inline Iterator   operator+(const uintptr disp) const noexcept
-        {
-            Iterator temp = *this;
-            temp.m_Ptr += disp;
-            return temp;
-        };
-        inline Iterator operator-(const uintptr disp) const noexcept
-        {
-            Iterator temp = *this;
-            temp.m_Ptr -= disp;
-            return temp;
-        }
+        return ::operator new(size, std::align_val_t{ alignment });
+    }
+    inline void Deallocate(void* ptr, const usize, const usize alignment) noexcept
+    {
+        ::operator delete(ptr, std::align_val_t{ alignment });
+    }
+};
 
-    public:
-        friend bool operator==(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Ptr == rhv.m_Ptr; }
-        friend bool operator!=(const Iterator& lhv, const Iterator& rhv) noexcept { return !(lhv == rhv); }
-    };
-    class ConstIterator
+// Bump allocator that carves allocations out of large chunks and gives everything back at once. Deallocate() only
+// reclaims the most recent allocation, which is enough for a growing vector to extend itself in place.
+class MonotonicArena
+{
+private:
+    struct Chunk
     {
-        using iterator_category = std::input_iterator_tag;
-        using difference_type   = ptrdiff;
-        using value_type        = T;
-        using pointer           = const value_type*;
-        using reference         = const value_type&;
+        Chunk* Next;
+        usize  Size;
+    };
 
-    private:
-        pointer m_Ptr;
+private:
+    Chunk* m_Head       = nullptr;
+    u8*    m_Cursor     = nullptr;
+    u8*    m_End        = nullptr;
+    usize  m_ChunkSize  = 0;
+    usize  m_ChunkCount = 0;
+    usize  m_HeapAllocs = 0;
 
-    public:
-        explicit ConstIterator(pointer ptr) noexcept : m_Ptr(ptr) {}
-        explicit ConstIterator(Iterator it) noexcept : m_Ptr(it.m_Ptr) {}
+public:
+    explicit MonotonicArena(const usize chunkSize = 64 * 1024) noexcept : m_ChunkSize(chunkSize) {}
+    MonotonicArena(const MonotonicArena&)            = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+    ~MonotonicArena() { Release(); }
 
-    public:
-        constexpr reference   operator*() const noexcept { return *m_Ptr; }
-        constexpr pointer     operator->() const noexcept { return m_Ptr; };
-        inline ConstIterator& operator++() noexcept
-        {
-            ++m_Ptr;
-            return *this;
-        }
-        inline ConstIterator operator++(const i32) noexcept
-        {
-            auto t = *this;
-            ++(*this);
-            return t;
-        }
-        constexpr ptrdiff    operator-(const ConstIterator& other) const noexcept { return m_Ptr - other.m_Ptr; }
-        inline ConstIterator operator+(const i32 disp) const noexcept
-        {
-            ConstIterator temp = *this;
-            temp.m_Ptr += disp;
-            return temp;
-        };
-        inline ConstIterator operator-(const i32 disp) const noexcept
-        {
-            ConstIterator temp = *this;
-            temp.m_Ptr -= disp;
-            return temp;
-        }
+public:
+    constexpr usize ChunkCount() const noexcept { return m_ChunkCount; }
+    constexpr usize ChunkSize() const noexcept { return m_ChunkSize; }
+    // Number of chunks ever requested from the global heap.
+    constexpr usize HeapAllocCount() const noexcept { return m_HeapAllocs; }
 
-    public:
-        friend bool operator==(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+public:
+    void* Allocate(const usize size, const usize alignment)
+    {
+        u8* ptr = AlignUp(m_Cursor, alignment);
+        if (!m_Cursor || ptr > m_End || static_cast<usize>(m_End - ptr) < size)
         {
-            return lhv.m_Ptr == rhv.m_Ptr;
+            NewChunk(size + alignment);
+            ptr = AlignUp(m_Cursor, alignment);
         }
-        friend bool operator!=(const ConstIterator& lhv, const ConstIterator& rhv) noexcept { return !(lhv == rhv); }
-    };
-    class ForwardIterator
+        m_Cursor = ptr + size;
+        return ptr;
+    }
+    inline void Deallocate(void* ptr, const usize size, const usize) noexcept
     {
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = ptrdiff;
-        using value_type        = T;
-        using pointer           = value_type*;
-        using reference         = value_type&;
-
-    private:
-        pointer m_Ptr = nullptr;
-
-    public:
-        ForwardIterator() = default;
-        ForwardIterator(pointer ptr) noexcept : m_Ptr(ptr) {}
-        ForwardIterator(Iterator it) noexcept : m_Ptr(it.m_Ptr) {}
+        if (static_cast<u8*>(ptr) + size == m_Cursor)
+            m_Cursor = static_cast<u8*>(ptr);
+    }
+    // Forgets every allocation but keeps the most recent chunk around so the next round does not touch the heap.
+    void Reset() noexcept
+    {
+        if (!m_Head)
+            return;
 
-    public:
-        constexpr reference   operator*() noexcept { return *m_Ptr; }
-        constexpr pointer     operator->() noexcept { return m_Ptr; };
-        inline ForwardIterator& operator++() noexcept
-        {
-            ++m_Ptr;
-            return *this;
-        }
-        inline ForwardIterator& operator++(const i32) noexcept
-        {
-            auto t = *this;
-            ++(*this);
-            return t;
-        }
-        constexpr ptrdiff    operator-(const ForwardIterator& other) noexcept { return m_Ptr - other.m_Ptr; }
-        inline ForwardIterator operator+(const i32 disp) noexcept
-        {
-            auto temp = *this;
-            temp.m_Ptr += disp;
-            return temp;
-        };
-        inline ForwardIterator operator-(const i32 disp) noexcept
+        Chunk* keep = m_Head;
+        m_Head      = m_Head->Next;
+        Release();
+        keep->Next   = nullptr;
+        m_Head       = keep;
+        m_ChunkCount = 1;
+        m_Cursor     = reinterpret_cast<u8*>(keep + 1);
+        m_End        = reinterpret_cast<u8*>(keep) + keep->Size;
+    }
+    void Release() noexcept
+    {
+        while (m_Head)
         {
-            auto temp = *this;
-            temp.m_Ptr -= disp;
-            return temp;
+            Chunk* next = m_Head->Next;
+            ::operator delete(m_Head);
+            m_Head = next;
         }
+        m_Cursor     = nullptr;
+        m_End        = nullptr;
+        m_ChunkCount = 0;
+    }
 
-    public:
-        friend bool operator==(const ForwardIterator& lhv, const ForwardIterator& rhv) noexcept
-        {
-            return lhv.m_Ptr == rhv.m_Ptr;
-        }
-        friend bool operator!=(const ForwardIterator& lhv, const ForwardIterator& rhv) noexcept { return !(lhv == rhv); }
-    };
-    class RandomAccessIterator
+private:
+    static inline u8* AlignUp(u8* ptr, const usize alignment) noexcept
     {
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = ptrdiff;
-        using value_type        = T;
-        using pointer           = value_type*;
-        using reference         = value_type&;
+        return reinterpret_cast<u8*>((reinterpret_cast<uintptr>(ptr) + alignment - 1) & ~(alignment - 1));
+    }
+    void NewChunk(const usize minSize)
+    {
+        const usize size  = std::max(m_ChunkSize, minSize + sizeof(Chunk));
+        Chunk*      chunk = static_cast<Chunk*>(::operator new(size));
+        chunk->Next       = m_Head;
+        chunk->Size       = size;
+        m_Head            = chunk;
+        m_Cursor          = reinterpret_cast<u8*>(chunk + 1);
+        m_End             = reinterpret_cast<u8*>(chunk) + size;
+        ++m_ChunkCount;
+        ++m_HeapAllocs;
+    }
+};
 
-    private:
-        pointer m_Ptr = nullptr;
+class ArenaAllocator
+{
+private:
+    MonotonicArena* m_Arena = nullptr;
 
-    public:
-        ForwardIterator() = default;
-        ForwardIterator(pointer ptr) noexcept : m_Ptr(ptr) {}
-        ForwardIterator(Iterator it) noexcept : m_Ptr(it.m_Ptr) {}
+public:
+    ArenaAllocator() = default;
+    ArenaAllocator(MonotonicArena& arena) noexcept : m_Arena(&arena) {}
 
-    public:
-        constexpr reference   operator*() noexcept { return *m_Ptr; }
-        constexpr pointer     operator->() noexcept { return m_Ptr; };
-        inline ForwardIterator& operator++() noexcept
-        {
-            ++m_Ptr;
-            return *this;
-        }
-        inline ForwardIterator& operator++(const i32) noexcept
-        {
-            auto t = *this;
-            ++(*this);
-            return t;
-        }
-        constexpr ptrdiff    operator-(const ForwardIterator& other) noexcept { return m_Ptr - other.m_Ptr; }
-        inline ForwardIterator operator+(const i32 disp) noexcept
-        {
-            auto temp = *this;
-            temp.m_Ptr += disp;
-            return temp;
-        };
-        inline ForwardIterator operator-(const i32 disp) noexcept
-        {
-            auto temp = *this;
-            temp.m_Ptr -= disp;
-            return temp;
-        }
+public:
+    inline void* Allocate(const usize size, const usize alignment) { return m_Arena->Allocate(size, alignment); }
+    inline void  Deallocate(void* ptr, const usize size, const usize alignment) noexcept
+    {
+        m_Arena->Deallocate(ptr, size, alignment);
+    }
+};
 
-    public:
-        friend bool operator==(const ForwardIterator& lhv, const ForwardIterator& rhv) noexcept
-        {
-            return lhv.m_Ptr == rhv.m_Ptr;
-        }
-        friend bool operator!=(const ForwardIterator& lhv, const ForwardIterator& rhv) noexcept { return !(lhv == rhv); }
+// Free-list of equally sized blocks. Requests larger than a block go straight to the heap.
+class FixedPool
+{
+private:
+    struct FreeBlock
+    {
+        FreeBlock* Next;
     };
 
+private:
+    MonotonicArena m_Blocks;
+    FreeBlock*     m_Free      = nullptr;
+    usize          m_BlockSize = 0;
+
 public:
-    Vec() = default;
-    Vec(const usize size) : m_Size(size), m_Capacity(size * 2), m_Buffer(new T[m_Capacity]) {}
-    Vec(const std::initializer_list<T> list)
+    explicit FixedPool(const usize blockSize, const usize blocksPerChunk = 256)
+        : m_Blocks(AlignedBlockSize(blockSize) * blocksPerChunk + 64), m_BlockSize(AlignedBlockSize(blockSize))
     {
-        m_Size     = list.size();
-        m_Capacity = m_Size * 2;
-        m_Buffer   = new T[m_Capacity];
-        if (!m_Buffer)
-            throw std::bad_alloc();
-        std::copy(list.begin(), list.end(), m_Buffer);
     }
-    Vec(const Vec<T>& other)
+    FixedPool(const FixedPool&)            = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+public:
+    constexpr usize BlockSize() const noexcept { return m_BlockSize; }
+    constexpr usize ChunkCount() const noexcept { return m_Blocks.ChunkCount(); }
+    constexpr usize HeapAllocCount() const noexcept { return m_Blocks.HeapAllocCount(); }
+
+public:
+    void* Allocate(const usize size, const usize alignment)
     {
-        if (&other == this)
-            return;
+        if (size > m_BlockSize || alignment > alignof(std::max_align_t))
+            return ::operator new(size, std::align_val_t{ alignment });
 
-        m_Size     = other.m_Size;
-        m_Capacity = other.m_Capacity;
-        m_Buffer   = new T[m_Capacity];
-        if (!m_Buffer)
-            throw std::bad_alloc();
-        std::memcpy(m_Buffer, other.m_Buffer, m_Size * sizeof(T));
+        if (m_Free)
+        {
+            FreeBlock* block = m_Free;
+            m_Free           = block->Next;
+            return block;
+        }
+        return m_Blocks.Allocate(m_BlockSize, alignof(std::max_align_t));
     }
-    Vec(Vec<T>&& other)
+    void Deallocate(void* ptr, const usize size, const usize alignment) noexcept
     {
-        if (&other == this)
+        if (size > m_BlockSize || alignment > alignof(std::max_align_t))
+        {
+            ::operator delete(ptr, std::align_val_t{ alignment });
             return;
+        }
 
-        m_Size           = other.m_Size;
-        m_Capacity       = other.m_Capacity;
-        other.m_Size     = 0;
-        other.m_Capacity = 0;
-        std::swap(m_Buffer, other.m_Buffer);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->Next      = m_Free;
+        m_Free           = block;
     }
-    ~Vec() { Drop(); }
+
+private:
+    static constexpr usize AlignedBlockSize(const usize size) noexcept
+    {
+        constexpr usize align = alignof(std::max_align_t);
+        return std::max((size + align - 1) & ~(align - 1), sizeof(FreeBlock));
+    }
+};
+
+class PoolAllocator
+{
+private:
+    FixedPool* m_Pool = nullptr;
 
 public:
-    constexpr usize Size() const noexcept { return m_Size; }
-    constexpr usize Capacity() const noexcept { return m_Capacity; }
-    constexpr bool  Empty() const noexcept { return m_Size == 0; }
-    constexpr T*    Data() const noexcept { return m_Buffer; }
-    constexpr usize MaxSize() const noexcept { return std::numeric_limits<usize>::max() / sizeof(T); }
+    PoolAllocator() = default;
+    PoolAllocator(FixedPool& pool) noexcept : m_Pool(&pool) {}
 
 public:
-    inline Iterator      begin() noexcept { return Iterator(m_Buffer); }
-    inline Iterator      end() noexcept { return Iterator(m_Buffer + m_Size); }
-    inline ConstIterator begin() const noexcept { return ConstIterator(m_Buffer); }
-    inline ConstIterator end() const noexcept { return ConstIterator(m_Buffer + m_Size); }
+    inline void* Allocate(const usize size, const usize alignment) { return m_Pool->Allocate(size, alignment); }
+    inline void  Deallocate(void* ptr, const usize size, const usize alignment) noexcept
+    {
+        m_Pool->Deallocate(ptr, size, alignment);
+    }
+};
 
+// Serves the first allocation that fits from storage embedded in the allocator itself and everything else from the
+// heap. Copies never share the storage, so this only makes sense inside the container that owns it, see SmallVec.
+template <usize Bytes, usize Alignment>
+class InlineAllocator
+{
 private:
-    void Realloc(const usize newSize, const bool reserveExtra = true)
-    {
-        if (newSize == m_Size)
-            return;
+    alignas(Alignment) u8 m_Storage[Bytes];
+    bool m_InUse = false;
 
-        const usize prev_size = m_Size;
-        m_Size                = newSize;
+public:
+    static constexpr usize InlineBytes = Bytes;
 
-        if (reserveExtra)
-            m_Capacity = newSize * 2;
-        else
-            m_Capacity = newSize;
+public:
+    InlineAllocator() noexcept {}
+    InlineAllocator(const InlineAllocator&) noexcept {}
+    InlineAllocator& operator=(const InlineAllocator&) noexcept { return *this; }
 
-        if (prev_size > 0)
+public:
+    inline void* Allocate(const usize size, const usize alignment)
+    {
+        if (!m_InUse && size <= Bytes && alignment <= Alignment)
         {
-            T* temp  = m_Buffer;
-            m_Buffer = new T[m_Capacity];
-            if (!m_Buffer)
-                throw std::bad_alloc();
-            if (prev_size < m_Size)
-                std::memcpy(m_Buffer, temp, prev_size * sizeof(T));
-            else
-                std::memcpy(m_Buffer, temp, m_Size * sizeof(T));
-            delete[] temp;
+            m_InUse = true;
+            return m_Storage;
         }
+        return ::operator new(size, std::align_val_t{ alignment });
+    }
+    inline void Deallocate(void* ptr, const usize, const usize alignment) noexcept
+    {
+        if (ptr == m_Storage)
+            m_InUse = false;
         else
-        {
-            if (m_Buffer)
-                delete[] m_Buffer;
-            m_Buffer = new T[m_Capacity];
-            if (!m_Buffer)
-                throw std::bad_alloc();
-        }
+            ::operator delete(ptr, std::align_val_t{ alignment });
     }
-    inline void Drop() noexcept
+    // Hands out the inline storage, which the caller knows to be free.
+    inline void* AllocateInline() noexcept
     {
-        delete[] m_Buffer;
-        m_Buffer   = nullptr;
-        m_Size     = 0;
-        m_Capacity = 0;
+        m_InUse = true;
+        return m_Storage;
     }
+    constexpr bool IsInline(const void* ptr) const noexcept { return ptr == m_Storage; }
+};
+
+#if defined(__linux__)
+// Gives every allocation its own anonymous mapping and implements the optional Reallocate() hook with mremap(): the
+// kernel extends a mapping in place when the address space behind it is free and otherwise moves its page table
+// entries, never the bytes, so growing a huge buffer needs neither a second copy of it nor a memcpy. Pages are only
+// backed once touched, so spare capacity costs address space rather than memory. With hugePages set, mappings are
+// advised MADV_HUGEPAGE so that large buffers can be backed by transparent huge pages.
+class MappedAllocator
+{
+private:
+    bool m_HugePages = false;
 
 public:
-    void Push(const T& e)
+    MappedAllocator() = default;
+    explicit MappedAllocator(const bool hugePages) noexcept : m_HugePages(hugePages) {}
+
+public:
+    static usize PageSize() noexcept
     {
-        if (m_Size >= m_Capacity)
-        {
-            Realloc(m_Size + 1);
-            m_Buffer[m_Size - 1] = e;
-        }
-        else
-            m_Buffer[m_Size++] = e;
+        static const usize size = static_cast<usize>(::sysconf(_SC_PAGESIZE));
+        return size;
     }
-    inline T Pop()
-    {
-        if (m_Size > 0)
-            return std::move(m_Buffer[m_Size--]);
-        else
-            throw std::out_of_range("Tried calling Pop() on an empty vector.");
-    }
-    inline T& Front()
+    constexpr bool HugePages() const noexcept { return m_HugePages; }
+
+public:
+    void* Allocate(const usize size, const usize alignment)
     {
-        if (m_Size > 0)
-            return m_Buffer[0];
-        else
-            throw std::out_of_range("Tried calling Front() on an empty vector.");
+        if (alignment > PageSize())
+            throw std::bad_alloc();
+
+        void* ptr = ::mmap(nullptr, MappedSize(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+        Advise(ptr, size);
+        return ptr;
     }
-    inline const T& Front() const
+    inline void Deallocate(void* ptr, const usize size, const usize) noexcept { ::munmap(ptr, MappedSize(size)); }
+    // Resizes an allocation, keeping its first min(oldSize, newSize) bytes, possibly at a new address. Containers use
+    // it instead of allocate-relocate-free when their elements are trivially relocatable.
+    void* Reallocate(void* ptr, const usize oldSize, const usize newSize, const usize)
     {
-        if (m_Size > 0)
-            return m_Buffer[0];
-        else
-            throw std::out_of_range("Tried calling Front() on an empty vector.");
+        void* moved = ::mremap(ptr, MappedSize(oldSize), MappedSize(newSize), MREMAP_MAYMOVE);
+        if (moved == MAP_FAILED)
+            throw std::bad_alloc();
+        Advise(moved, newSize);
+        return moved;
     }
-    inline T& Back()
+
+private:
+    static inline usize MappedSize(const usize size) noexcept { return (size + PageSize() - 1) & ~(PageSize() - 1); }
+    inline void         Advise(void* ptr, const usize size) const noexcept
     {
-        if (m_Size > 0)
-            return m_Buffer[m_Size - 1];
-        else
-            throw std::out_of_range("Tried calling Back() on an empty vector.");
+        if (m_HugePages)
+            ::madvise(ptr, MappedSize(size), MADV_HUGEPAGE);
     }
-    inline const T& Back() const
+};
+#endif
+
+// Growth policies decide how much room to reserve once a container runs out of capacity, and when a container that
+// has drained should hand memory back. A container shrinks automatically only once its size drops below
+// capacity / ShrinkDivisor (the low-water mark), so alternating grow/shrink workloads do not thrash the allocator.
+// A ShrinkDivisor of 0 disables automatic shrinking.
+template <usize Num, usize Den, usize LowWater = 4>
+struct GrowthFactor
+{
+    static constexpr usize ShrinkDivisor = LowWater;
+
+    static constexpr usize Grow(const usize required, const usize) noexcept
     {
-        if (m_Size > 0)
-            return m_Buffer[m_Size - 1];
-        else
-            throw std::out_of_range("Tried calling Back() on an empty vector.");
+        return std::max(required, required / Den * Num + required % Den * Num / Den);
     }
-    inline T& At(const usize index)
+};
+using GrowthDouble     = GrowthFactor<2, 1>;
+using GrowthOneAndHalf = GrowthFactor<3, 2>;
+
+template <usize LowWater = 4>
+struct GrowthPowerOfTwo
+{
+    static constexpr usize ShrinkDivisor = LowWater;
+
+    static constexpr usize Grow(const usize required, const usize) noexcept { return std::bit_ceil(required); }
+};
+
+// Grows by 1.5x and then rounds the byte size up to the next size class of a jemalloc/tcmalloc style allocator
+// (16 byte steps up to 128 bytes, then four classes per power of two), so the slack the allocator would waste
+// anyway becomes usable capacity.
+template <usize LowWater = 4>
+struct GrowthSizeClass
+{
+    static constexpr usize ShrinkDivisor = LowWater;
+
+    static constexpr usize Grow(const usize required, const usize elementSize) noexcept
     {
-        if (m_Size - 1 >= index)
-            return m_Buffer[index];
-        else
-            throw std::out_of_range("Index out of bounds.");
+        if (required == 0)
+            return 0;
+
+        const usize bytes = RoundToSizeClass((required + required / 2) * elementSize);
+        return std::max(required, bytes / elementSize);
     }
-    inline const T& At(const usize index) const
+    static constexpr usize RoundToSizeClass(const usize bytes) noexcept
     {
-        if (m_Size - 1 >= index)
-            return m_Buffer[index];
-        else
-            throw std::out_of_range("Index out of bounds.");
+        if (bytes <= 128)
+            return (bytes + 15) & ~usize(15);
+
+        const usize step = std::bit_floor(bytes - 1) / 4;
+        return (bytes + step - 1) & ~(step - 1);
     }
-    void Assign(const usize count, const T& value)
+};
+
+template <typename T>
+concept Integral = std::is_integral_v<T>;
+template <typename T>
+concept FloatingPoint = std::is_floating_point_v<T>;
+template <typename T>
+concept Arithmetic = Integral<T> || FloatingPoint<T>;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define VEC_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define VEC_X86_SIMD 0
+#endif
+
+// Widest instruction set the bulk kernels may use on this machine, detected once at first use.
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+inline SimdLevel DetectSimdLevel() noexcept
+{
+#if VEC_X86_SIMD
+    __builtin_cpu_init();
+    // The AVX2 and AVX-512 kernels also use BMI2 (pext/pdep), which every CPU with either of them has.
+    const bool bmi2 = __builtin_cpu_supports("bmi2");
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && bmi2)
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2") && bmi2)
+        return SimdLevel::AVX2;
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+// Upper bound on the level the kernels may use, lowered by LimitSimdLevel() to run the narrower kernels in tests.
+inline std::atomic<SimdLevel>& SimdLevelLimit() noexcept
+{
+    static std::atomic<SimdLevel> limit = SimdLevel::AVX512;
+    return limit;
+}
+inline SimdLevel CurrentSimdLevel() noexcept
+{
+    static const SimdLevel level = DetectSimdLevel();
+    return std::min(level, SimdLevelLimit().load(std::memory_order_relaxed));
+}
+inline void LimitSimdLevel(const SimdLevel level) noexcept
+{
+    SimdLevelLimit().store(level, std::memory_order_relaxed);
+}
+
+// Search and reduction kernels over raw arrays. Each kernel is written once against GCC vector extensions and
+// instantiated for 16, 32 and 64 byte registers; the public entry points pick one at runtime and fall back to plain
+// loops for element types without vector lanes (bool, long double) and for non-x86 builds.
+namespace simd
+{
+    template <typename T>
+    concept Vectorizable = Arithmetic<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, long double>;
+
+    // Integer sums and dot products accumulate in 64 bits so that narrow element types do not wrap.
+    template <typename T>
+    using SumType = std::conditional_t<FloatingPoint<T>, T, std::conditional_t<std::is_signed_v<T>, i64, u64>>;
+
+    template <typename T>
+    usize FindScalar(const T* data, const usize size, const T value) noexcept
     {
-        Realloc(count);
-        std::fill(begin(), end(), value);
+        for (usize i = 0; i < size; ++i)
+            if (data[i] == value)
+                return i;
+        return size;
     }
-    void Assign(const ConstIterator begin, const ConstIterator end)
+    template <typename T>
+    usize CountScalar(const T* data, const usize size, const T value) noexcept
     {
-        Realloc(end - begin);
-        std::copy(begin, end, this->begin());
+        usize count = 0;
+        for (usize i = 0; i < size; ++i)
+            count += data[i] == value;
+        return count;
     }
-    void Assign(const std::initializer_list<T> list)
+    template <typename T>
+    SumType<T> SumScalar(const T* data, const usize size) noexcept
     {
-        Realloc(list.size());
-        std::copy(list.begin(), list.end(), begin());
+        SumType<T> sum{};
+        for (usize i = 0; i < size; ++i)
+            sum += data[i];
+        return sum;
     }
-    constexpr void Swap(Vec<T>& other)
+    template <typename T>
+    std::pair<T, T> MinMaxScalar(const T* data, const usize size) noexcept
     {
-        std::swap(m_Size, other.m_Size);
-        std::swap(m_Capacity, other.m_Capacity);
-        std::swap(m_Buffer, other.m_Buffer);
+        T lo = data[0], hi = data[0];
+        for (usize i = 1; i < size; ++i)
+        {
+            lo = (data[i] < lo) ? data[i] : lo;
+            hi = (data[i] > hi) ? data[i] : hi;
+        }
+        return { lo, hi };
     }
-    inline void Resize(const usize newSize) { Realloc(newSize); }
-    void        Insert(const ConstIterator pos, const T& value)
+    template <typename T>
+    SumType<T> DotScalar(const T* lhv, const T* rhv, const usize size) noexcept
     {
-        const auto diff = pos - begin();
-        const T*   temp = m_Buffer;
-
-        ++m_Size;
-        m_Capacity = m_Size * 2;
-        m_Buffer   = new T[m_Capacity];
-        std::copy(temp, temp + diff, m_Buffer);
-        m_Buffer[diff] = value;
-        std::copy(temp + diff, temp + m_Size - 1, m_Buffer + diff + 1);
-
-        delete[] temp;
+        SumType<T> sum{};
+        for (usize i = 0; i < size; ++i)
+            sum += static_cast<SumType<T>>(lhv[i]) * static_cast<SumType<T>>(rhv[i]);
+        return sum;
     }
-    void Insert(const ConstIterator pos, const ConstIterator first, const ConstIterator last)
+
+    [[gnu::always_inline]] inline usize PopCountScalar(const u64* words, const usize count) noexcept
     {
-        const auto  diff        = pos - begin();
-        const usize insert_size = last - first;
-        const usize prev_size   = m_Size;
-        T*          temp        = m_Buffer;
+        usize bits = 0;
+        for (usize i = 0; i < count; ++i)
+            bits += static_cast<usize>(std::popcount(words[i]));
+        return bits;
+    }
 
-        m_Size += insert_size;
-        m_Capacity = m_Size * 2;
-        m_Buffer   = new T[m_Capacity];
-        std::copy(temp, temp + diff, m_Buffer);
-        std::copy(first, last, m_Buffer + diff);
-        std::copy(temp + diff, temp + prev_size, m_Buffer + diff + insert_size);
+#if VEC_X86_SIMD
+    // std::popcount only becomes a single instruction when the popcnt extension is enabled, every AVX2 CPU has it.
+    [[gnu::target("popcnt")]] inline usize PopCountPOPCNT(const u64* words, const usize count) noexcept
+    {
+        return PopCountScalar(words, count);
+    }
 
-        delete[] temp;
+    template <typename TMask>
+    [[gnu::always_inline]] inline bool AnyLane(const TMask& mask) noexcept
+    {
+        u64 words[sizeof(TMask) / sizeof(u64)];
+        std::memcpy(words, &mask, sizeof(TMask));
+        u64 any = 0;
+        for (const u64 w : words)
+            any |= w;
+        return any != 0;
     }
-    void Erase(const ConstIterator pos)
+
+    template <typename T, usize Bytes>
+    [[gnu::always_inline]] inline usize FindKernel(const T* data, const usize size, const T value) noexcept
     {
-        if (!Empty())
+        typedef T           V __attribute__((vector_size(Bytes)));
+        constexpr usize     lanes  = Bytes / sizeof(T);
+        const V             needle = V{} + value;
+        usize               i      = 0;
+        for (; i + lanes <= size; i += lanes)
         {
-            const usize   prev_size = m_Size;
-            const ptrdiff index     = pos - begin();
-
-            T* temp = m_Buffer;
-            --m_Size;
-            m_Capacity = m_Size * 2;
-            m_Buffer   = new T[m_Capacity];
-
-            for (usize i = 0, j = 0; i < prev_size; ++i)
-                if (i != index)
-                    m_Buffer[j++] = temp[i];
-            delete[] temp;
+            V chunk;
+            std::memcpy(&chunk, data + i, Bytes);
+            const auto eq = chunk == needle;
+            if (AnyLane(eq))
+                for (usize j = 0; j < lanes; ++j)
+                    if (eq[j])
+                        return i + j;
         }
-        else
-            throw std::out_of_range("Tried calling Erase() on an empty vector.");
+        return i + FindScalar(data + i, size - i, value);
     }
-    constexpr void Reserve(const usize newCapacity)
+    template <typename T, usize Bytes>
+    [[gnu::always_inline]] inline usize CountKernel(const T* data, const usize size, const T value) noexcept
     {
-        if (newCapacity > m_Capacity)
+        typedef T       V __attribute__((vector_size(Bytes)));
+        // Comparisons yield lanes of the signed integer type of the same width.
+        using Lane = std::conditional_t<sizeof(T) == 1, u8, std::conditional_t<sizeof(T) == 2, u16, std::conditional_t<sizeof(T) == 4, u32, u64>>>;
+        typedef std::make_signed_t<Lane> M __attribute__((vector_size(Bytes)));
+        constexpr usize lanes  = Bytes / sizeof(T);
+        const V         needle = V{} + value;
+        M               acc{};
+        usize           count = 0, i = 0, rounds = 0;
+        for (; i + lanes <= size; i += lanes)
         {
-            const usize prev_capacity = m_Capacity;
-            m_Capacity                = newCapacity;
-            T* temp                   = m_Buffer;
-            m_Buffer                  = new T[m_Capacity];
-            std::memcpy(m_Buffer, m_Capacity, prev_capacity * sizeof(T));
-            delete[] temp;
+            V chunk;
+            std::memcpy(&chunk, data + i, Bytes);
+            acc -= chunk == needle; // matching lanes are all ones, i.e. -1
+            // Flush before 8-bit lanes can overflow.
+            if (++rounds == 127)
+            {
+                for (usize j = 0; j < lanes; ++j)
+                    count += static_cast<Lane>(acc[j]);
+                acc    = M{};
+                rounds = 0;
+            }
         }
+        for (usize j = 0; j < lanes; ++j)
+            count += static_cast<Lane>(acc[j]);
+        return count + CountScalar(data + i, size - i, value);
     }
-    void Erase(const ConstIterator first, const ConstIterator last)
+    template <typename T, usize Bytes>
+    [[gnu::always_inline]] inline SumType<T> SumKernel(const T* data, const usize size) noexcept
     {
-        if (!Empty())
+        typedef T       V __attribute__((vector_size(Bytes)));
+        constexpr usize lanes = Bytes / sizeof(T);
+        typedef SumType<T> W __attribute__((vector_size(lanes * sizeof(SumType<T>))));
+        W                  acc{};
+        usize              i = 0;
+        for (; i + lanes <= size; i += lanes)
         {
-            const usize prev_size = m_Size;
-            T*          temp      = m_Buffer;
-            m_Size -= last - first;
-            m_Capacity = m_Size * 2;
-            m_Buffer   = new T[m_Capacity];
-
-            std::copy(temp, temp + (first - temp), m_Buffer);
-            std::copy(temp + (last - first) + (first - temp), temp + prev_size, m_Buffer + (first - temp));
-
-            delete[] temp;
+            V chunk;
+            std::memcpy(&chunk, data + i, Bytes);
+            acc += __builtin_convertvector(chunk, W);
         }
-        else
-            throw std::out_of_range("Tried calling Erase() on an empty vector.");
+        SumType<T> sum{};
+        for (usize j = 0; j < lanes; ++j)
+            sum += acc[j];
+        return sum + SumScalar(data + i, size - i);
     }
-    inline void    ShrinkToFit() { Realloc(m_Size, false); }
-    constexpr void Clear() noexcept { m_Size = 0; }
-
-public:
-    template <typename... TArgs>
-    void Emplace(const Iterator pos, TArgs&&... args)
+    template <typename T, usize Bytes>
+    [[gnu::always_inline]] inline std::pair<T, T> MinMaxKernel(const T* data, const usize size) noexcept
     {
-        const auto diff = pos - begin();
-        const T*   temp = m_Buffer;
-
-        ++m_Size;
-        m_Capacity = m_Size * 2;
-        m_Buffer   = new T[m_Capacity];
+        typedef T       V __attribute__((vector_size(Bytes)));
+        constexpr usize lanes = Bytes / sizeof(T);
+        if (size < lanes)
+            return MinMaxScalar(data, size);
 
-        std::copy(temp, temp + diff, m_Buffer);
-        m_Buffer[diff] = T(std::forward<TArgs>(args)...);
-        std::copy(temp + diff, temp + m_Size - 1, m_Buffer + diff + 1);
+        V lo, hi;
+        std::memcpy(&lo, data, Bytes);
+        hi      = lo;
+        usize i = lanes;
+        for (; i + lanes <= size; i += lanes)
+        {
+            V chunk;
+            std::memcpy(&chunk, data + i, Bytes);
+            lo = (chunk < lo) ? chunk : lo;
+            hi = (chunk > hi) ? chunk : hi;
+        }
 
-        delete[] temp;
+        T rlo = lo[0], rhi = hi[0];
+        for (usize j = 1; j < lanes; ++j)
+        {
+            rlo = (lo[j] < rlo) ? lo[j] : rlo;
+            rhi = (hi[j] > rhi) ? hi[j] : rhi;
+        }
+        for (; i < size; ++i)
+        {
+            rlo = (data[i] < rlo) ? data[i] : rlo;
+            rhi = (data[i] > rhi) ? data[i] : rhi;
+        }
+        return { rlo, rhi };
     }
-    template <typename... TArgs>
-    void EmplaceBack(TArgs&&... args)
+    template <typename T, usize Bytes>
+    [[gnu::always_inline]] inline SumType<T> DotKernel(const T* lhv, const T* rhv, const usize size) noexcept
     {
-        if (m_Size >= m_Capacity)
+        typedef T       V __attribute__((vector_size(Bytes)));
+        constexpr usize lanes = Bytes / sizeof(T);
+        typedef SumType<T> W __attribute__((vector_size(lanes * sizeof(SumType<T>))));
+        W                  acc{};
+        usize              i = 0;
+        for (; i + lanes <= size; i += lanes)
         {
-            Realloc(m_Size + 1);
-            m_Buffer[m_Size - 1] = T(std::forward<TArgs>(args)...);
+            V a, b;
+            std::memcpy(&a, lhv + i, Bytes);
+            std::memcpy(&b, rhv + i, Bytes);
+            acc += __builtin_convertvector(a, W) * __builtin_convertvector(b, W);
         }
-        else
-            m_Buffer[m_Size++] = T(std::forward<TArgs>(args)...);
+        SumType<T> sum{};
+        for (usize j = 0; j < lanes; ++j)
+            sum += acc[j];
+        return sum + DotScalar(lhv + i, rhv + i, size - i);
     }
 
-public:
-    constexpr T&       operator[](const usize index) noexcept { return m_Buffer[index]; }
-    constexpr const T& operator[](const usize index) const noexcept { return m_Buffer[index]; }
-    inline Vec<T>&     operator=(const std::initializer_list<T> list)
+    template <typename T>
+    [[gnu::target("avx2")]] usize FindAVX2(const T* data, const usize size, const T value) noexcept
     {
-        Realloc(list.size());
-        std::copy(list.begin(), list.end(), begin());
-        return *this;
+        return FindKernel<T, 32>(data, size, value);
     }
-    inline Vec<T>& operator=(const Vec<T>& other)
+    template <typename T>
+    [[gnu::target("avx512f,avx512bw")]] usize FindAVX512(const T* data, const usize size, const T value) noexcept
     {
-        if (&other == this)
-            return *this;
-
-        Realloc(other.m_Size);
-        std::memcpy(m_Buffer, other.m_Buffer, m_Size * sizeof(T));
-        return *this;
+        return FindKernel<T, 64>(data, size, value);
     }
-    inline Vec<T>& operator=(Vec<T>&& other) noexcept
+    template <typename T>
+    [[gnu::target("avx2")]] usize CountAVX2(const T* data, const usize size, const T value) noexcept
     {
-        if (&other == this)
-            return *this;
-
-        Drop();
-        m_Size           = other.m_Size;
-        m_Capacity       = other.m_Capacity;
-        other.m_Size     = 0;
-        other.m_Capacity = 0;
-        std::swap(m_Buffer, other.m_Buffer);
-        return *this;
+        return CountKernel<T, 32>(data, size, value);
     }
-    inline Vec<T>& operator<<(const Vec<T>& other)
+    template <typename T>
+    [[gnu::target("avx512f,avx512bw")]] usize CountAVX512(const T* data, const usize size, const T value) noexcept
     {
-        if (&other == this)
-            return *this;
-
-        const usize prev_size = m_Size;
-        Realloc(m_Size + other.m_Size);
-        std::copy(other.begin(), other.end(), begin() + prev_size);
-        return *this;
+        return CountKernel<T, 64>(data, size, value);
+    }
+    template <typename T>
+    [[gnu::target("avx2")]] SumType<T> SumAVX2(const T* data, const usize size) noexcept
+    {
+        return SumKernel<T, 32>(data, size);
     }
+    template <typename T>
+    [[gnu::target("avx512f,avx512bw")]] SumType<T> SumAVX512(const T* data, const usize size) noexcept
+    {
+        return SumKernel<T, 64>(data, size);
+    }
+    template <typename T>
+    [[gnu::target("avx2")]] std::pair<T, T> MinMaxAVX2(const T* data, const usize size) noexcept
+    {
+        return MinMaxKernel<T, 32>(data, size);
+    }
+    template <typename T>
+    [[gnu::target("avx512f,avx512bw")]] std::pair<T, T> MinMaxAVX512(const T* data, const usize size) noexcept
+    {
+        return MinMaxKernel<T, 64>(data, size);
+    }
+    template <typename T>
+    [[gnu::target("avx2")]] SumType<T> DotAVX2(const T* lhv, const T* rhv, const usize size) noexcept
+    {
+        return DotKernel<T, 32>(lhv, rhv, size);
+    }
+    template <typename T>
+    [[gnu::target("avx512f,avx512bw")]] SumType<T> DotAVX512(const T* lhv, const T* rhv, const usize size) noexcept
+    {
+        return DotKernel<T, 64>(lhv, rhv, size);
+    }
+#endif
 
-public:
-    friend std::ostream& operator<<(std::ostream& stream, const Vec<T>& other)
+    // Index of the first element equal to value, or size if there is none.
+    template <typename T>
+    usize Find(const T* data, const usize size, const T value) noexcept
     {
-        stream << "[ ";
-        for (usize i = 0; i < other.m_Size; ++i)
+#if VEC_X86_SIMD
+        if constexpr (Vectorizable<T>)
         {
-            if (i + 1 != other.m_Size)
-                stream << other.m_Buffer[i] << ", ";
-            else
-                stream << other.m_Buffer[i];
+            switch (CurrentSimdLevel())
+            {
+                case SimdLevel::AVX512: return FindAVX512(data, size, value);
+                case SimdLevel::AVX2: return FindAVX2(data, size, value);
+                case SimdLevel::SSE2: return FindKernel<T, 16>(data, size, value);
+                default: break;
+            }
         }
-        stream << " ]";
-        return stream;
+#endif
+        return FindScalar(data, size, value);
     }
-};
-
-template <typename T>
-concept Integral = std::is_integral_v<T>;
-
-template <>
-class Vec<bool>
-{
-    // Based on std::bitset
-
-    using BufferType              = u8;
-    static constexpr auto BitSize = sizeof(BufferType) * 8;
-
-private:
-    BufferType* m_Buffer   = nullptr;
-    usize       m_Size     = 0;
-    usize       m_Capacity = 0;
-
-public:
-    class BitRef
+    template <typename T>
+    usize Count(const T* data, const usize size, const T value) noexcept
     {
-    private:
-        BufferType* m_Ptr   = nullptr;
-        usize       m_Index = 0;
-
-    public:
-        BitRef(BufferType* ptr, const usize index) : m_Ptr(ptr), m_Index(index) {}
-
-    public:
-        constexpr operator bool() const noexcept
+#if VEC_X86_SIMD
+        if constexpr (Vectorizable<T>)
         {
-            return (m_Ptr[m_Index / BitSize] >> ((BitSize - 1) - m_Index % BitSize) & 1);
+            switch (CurrentSimdLevel())
+            {
+                case SimdLevel::AVX512: return CountAVX512(data, size, value);
+                case SimdLevel::AVX2: return CountAVX2(data, size, value);
+                case SimdLevel::SSE2: return CountKernel<T, 16>(data, size, value);
+                default: break;
+            }
         }
-        inline BitRef& operator=(const bool value) noexcept
+#endif
+        return CountScalar(data, size, value);
+    }
+    template <typename T>
+    SumType<T> Sum(const T* data, const usize size) noexcept
+    {
+#if VEC_X86_SIMD
+        if constexpr (Vectorizable<T>)
         {
-            if (value)
-                m_Ptr[m_Index / BitSize] |= 1 << ((BitSize - 1) - m_Index % BitSize);
-            else
-                m_Ptr[m_Index / BitSize] &= ~(1 << ((BitSize - 1) - m_Index % BitSize));
-            return *this;
+            switch (CurrentSimdLevel())
+            {
+                case SimdLevel::AVX512: return SumAVX512(data, size);
+                case SimdLevel::AVX2: return SumAVX2(data, size);
+                case SimdLevel::SSE2: return SumKernel<T, 16>(data, size);
+                default: break;
+            }
         }
-        inline BitRef& operator=(const BitRef& value) noexcept { return this->operator=(value.operator bool()); }
-        constexpr bool operator~() const noexcept
+#endif
+        return SumScalar(data, size);
+    }
+    // size must be at least 1.
+    template <typename T>
+    std::pair<T, T> MinMax(const T* data, const usize size) noexcept
+    {
+#if VEC_X86_SIMD
+        if constexpr (Vectorizable<T>)
         {
-            return ~(((m_Ptr[m_Index / BitSize] >> ((BitSize - 1) - m_Index % BitSize)) & 1));
+            switch (CurrentSimdLevel())
+            {
+                case SimdLevel::AVX512: return MinMaxAVX512(data, size);
+                case SimdLevel::AVX2: return MinMaxAVX2(data, size);
+                case SimdLevel::SSE2: return MinMaxKernel<T, 16>(data, size);
+                default: break;
+            }
         }
-        constexpr bool operator&(const bool value) const noexcept
+#endif
+        return MinMaxScalar(data, size);
+    }
+    // Number of set bits in words[0, count).
+    inline usize PopCount(const u64* words, const usize count) noexcept
+    {
+#if VEC_X86_SIMD
+        if (CurrentSimdLevel() >= SimdLevel::AVX2)
+            return PopCountPOPCNT(words, count);
+#endif
+        return PopCountScalar(words, count);
+    }
+    template <typename T>
+    SumType<T> Dot(const T* lhv, const T* rhv, const usize size) noexcept
+    {
+#if VEC_X86_SIMD
+        if constexpr (Vectorizable<T>)
         {
-            return (bool)((u8)value & (u8)this->operator bool());
+            switch (CurrentSimdLevel())
+            {
+                case SimdLevel::AVX512: return DotAVX512(lhv, rhv, size);
+                case SimdLevel::AVX2: return DotAVX2(lhv, rhv, size);
+                case SimdLevel::SSE2: return DotKernel<T, 16>(lhv, rhv, size);
+                default: break;
+            }
         }
-        inline BitRef& operator&=(const bool value) noexcept
+#endif
+        return DotScalar(lhv, rhv, size);
+    }
+
+    // Word-wise bitmap kernels: dst[i] = lhv[i] op rhv[i]. dst may alias either input. Not ignores rhv.
+    enum class BitOp
+    {
+        And,
+        Or,
+        Xor,
+        AndNot,
+        Not
+    };
+
+    template <BitOp Op, typename V>
+    [[gnu::always_inline]] inline void ApplyBitOp(V& lhv, const V& rhv) noexcept
+    {
+        if constexpr (Op == BitOp::And)
+            lhv &= rhv;
+        else if constexpr (Op == BitOp::Or)
+            lhv |= rhv;
+        else if constexpr (Op == BitOp::Xor)
+            lhv ^= rhv;
+        else if constexpr (Op == BitOp::AndNot)
+            lhv &= ~rhv;
+        else
+            lhv = ~lhv;
+    }
+    template <BitOp Op, usize Bytes>
+    [[gnu::always_inline]] inline void BitwiseKernel(u64* dst, const u64* lhv, const u64* rhv, const usize count) noexcept
+    {
+        usize i = 0;
+#if VEC_X86_SIMD
+        typedef u64     V __attribute__((vector_size(Bytes)));
+        constexpr usize lanes = Bytes / sizeof(u64);
+        for (; i + lanes <= count; i += lanes)
         {
-            this->operator=(this->operator&(value));
-            return *this;
+            V a, b{};
+            std::memcpy(&a, lhv + i, Bytes);
+            if constexpr (Op != BitOp::Not)
+                std::memcpy(&b, rhv + i, Bytes);
+            ApplyBitOp<Op>(a, b);
+            std::memcpy(dst + i, &a, Bytes);
         }
-        constexpr bool operator|(const bool value) const noexcept
+#endif
+        for (; i < count; ++i)
         {
-            return (bool)((u8)this->operator bool() | (u8)value);
+            u64 word = lhv[i];
+            ApplyBitOp<Op>(word, (Op != BitOp::Not) ? rhv[i] : u64{ 0 });
+            dst[i] = word;
         }
-        inline BitRef& operator|=(const bool value) noexcept
+    }
+    [[gnu::always_inline]] inline usize AndCountKernel(const u64* lhv, const u64* rhv, const usize count) noexcept
+    {
+        usize bits = 0;
+        for (usize i = 0; i < count; ++i)
+            bits += static_cast<usize>(std::popcount(lhv[i] & rhv[i]));
+        return bits;
+    }
+
+#if VEC_X86_SIMD
+    template <BitOp Op>
+    [[gnu::target("avx2")]] void BitwiseAVX2(u64* dst, const u64* lhv, const u64* rhv, const usize count) noexcept
+    {
+        BitwiseKernel<Op, 32>(dst, lhv, rhv, count);
+    }
+    template <BitOp Op>
+    [[gnu::target("avx512f")]] void BitwiseAVX512(u64* dst, const u64* lhv, const u64* rhv, const usize count) noexcept
+    {
+        BitwiseKernel<Op, 64>(dst, lhv, rhv, count);
+    }
+    [[gnu::target("popcnt")]] inline usize AndCountPOPCNT(const u64* lhv, const u64* rhv, const usize count) noexcept
+    {
+        return AndCountKernel(lhv, rhv, count);
+    }
+#endif
+
+    template <BitOp Op>
+    void Bitwise(u64* dst, const u64* lhv, const u64* rhv, const usize count) noexcept
+    {
+#if VEC_X86_SIMD
+        switch (CurrentSimdLevel())
         {
-            this->operator=(this->operator|(value));
-            return *this;
+            case SimdLevel::AVX512: return BitwiseAVX512<Op>(dst, lhv, rhv, count);
+            case SimdLevel::AVX2: return BitwiseAVX2<Op>(dst, lhv, rhv, count);
+            default: break;
         }
-        constexpr bool operator^(const bool value) const noexcept
-        {
-            return (bool)((u8)this->operator bool() ^ (u8)value);
-        }
-        inline BitRef& operator^=(const bool value) noexcept
-        {
-            this->operator=(this->operator^(value));
-            return *this;
-        }
-        inline BitRef& Flip() noexcept { return this->operator=(!*this); }
-
-    public:
-        friend std::ostream& operator<<(std::ostream& stream, const BitRef& ref)
-        {
-            stream << ref.operator bool();
-            return stream;
-        }
-    };
-    class ConstIterator;
-    class Iterator
+#endif
+        BitwiseKernel<Op, 16>(dst, lhv, rhv, count);
+    }
+    // Number of bits set in both lhv and rhv.
+    inline usize AndCount(const u64* lhv, const u64* rhv, const usize count) noexcept
     {
-        friend class ConstIterator;
-
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = ptrdiff;
-        using value_type        = bool;
-        using pointer           = BufferType*;
-        using reference         = BitRef;
-
-    private:
-        pointer m_Ptr;
-        usize   m_Index;
+#if VEC_X86_SIMD
+        if (CurrentSimdLevel() >= SimdLevel::AVX2)
+            return AndCountPOPCNT(lhv, rhv, count);
+#endif
+        return AndCountKernel(lhv, rhv, count);
+    }
 
-    public:
-        Iterator(pointer ptr, const usize index) noexcept : m_Ptr(ptr), m_Index(index) {}
+    // Bit-packing kernels for PackedVec. Value i of a packed stream occupies bits [i * Bits, (i + 1) * Bits) of an
+    // LSB-first u64 array, so every 64 values fill exactly Bits words. The kernels work on such 64-value blocks, in
+    // which all shifts are compile-time constants and the loops unroll into straight-line shift/or code.
+    template <usize Bits>
+    inline constexpr u64 PackMask = (Bits == 64) ? ~u64(0) : (u64(1) << Bits) - 1;
 
-    public:
-        inline reference  operator*() const noexcept { return BitRef(m_Ptr, m_Index); }
-        constexpr pointer operator->() const noexcept = delete;
-        inline Iterator&  operator++() noexcept
-        {
-            ++m_Index;
-            return *this;
-        }
-        inline Iterator operator++(const i32) noexcept
+    template <usize Bits, typename T>
+    [[gnu::always_inline]] inline void PackKernel(const T* in, u64* words, const usize blocks) noexcept
+    {
+        for (usize b = 0; b < blocks; ++b, in += 64, words += Bits)
         {
-            auto t = *this;
-            ++(*this);
-            return t;
+#pragma GCC unroll 64
+            for (usize j = 0; j < 64; ++j)
+            {
+                const usize bit   = j * Bits;
+                const usize shift = bit % 64;
+                const u64   value = static_cast<u64>(in[j]) & PackMask<Bits>;
+                // The first value touching a word assigns it, later ones OR into it.
+                if (shift == 0)
+                    words[bit / 64] = value;
+                else
+                    words[bit / 64] |= value << shift;
+                if (shift + Bits > 64)
+                    words[bit / 64 + 1] = value >> (64 - shift);
+            }
         }
-        constexpr ptrdiff operator-(const Iterator& other) const noexcept { return m_Index - other.m_Index; }
-        inline Iterator   operator+(const uintptr disp) const noexcept
-        {
-            Iterator temp = *this;
-            temp.m_Index += disp;
-            return temp;
-        };
-        inline Iterator operator-(const uintptr disp) const noexcept
+    }
+    template <usize Bits, typename T>
+    [[gnu::always_inline]] inline void UnpackKernel(const u64* words, T* out, const usize blocks) noexcept
+    {
+        for (usize b = 0; b < blocks; ++b, words += Bits, out += 64)
         {
-            Iterator temp = *this;
-            temp.m_Index -= disp;
-            return temp;
+#pragma GCC unroll 64
+            for (usize j = 0; j < 64; ++j)
+            {
+                const usize bit   = j * Bits;
+                const usize shift = bit % 64;
+                u64         value = words[bit / 64] >> shift;
+                if (shift + Bits > 64)
+                    value |= words[bit / 64 + 1] << (64 - shift);
+                out[j] = static_cast<T>(value & PackMask<Bits>);
+            }
         }
+    }
 
-    public:
-        friend bool operator==(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Index == rhv.m_Index; }
-        friend bool operator!=(const Iterator& lhv, const Iterator& rhv) noexcept { return !(lhv == rhv); }
+#if VEC_X86_SIMD
+    // __builtin_shuffle rejects vector types whose size depends on a template parameter, these are spelled out.
+    template <usize Bytes>
+    struct U32Lanes;
+    template <>
+    struct U32Lanes<32>
+    {
+        typedef u32 V __attribute__((vector_size(32)));
     };
-    class ConstIterator
+    template <>
+    struct U32Lanes<64>
     {
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = ptrdiff;
-        using value_type        = bool;
-        using pointer           = const BufferType*;
-        using reference         = const BitRef;
-
-    private:
-        pointer m_Ptr;
-        usize   m_Index;
+        typedef u32 V __attribute__((vector_size(64)));
+    };
 
-    public:
-        ConstIterator(pointer ptr, const usize index) noexcept : m_Ptr(ptr), m_Index(index) {}
+    // Whether every group of Lanes values in a block lies within Lanes consecutive u32 words.
+    template <usize Bits, usize Lanes>
+    consteval bool UnpackWindowFits()
+    {
+        for (usize j = 0; j < 64; j += Lanes)
+            if (((j + Lanes) * Bits - 1) / 32 - j * Bits / 32 >= Lanes)
+                return false;
+        return true;
+    }
+    // Unpacks a group of lanes values out of one vector load: two constant shuffles pick the u32 words each value
+    // starts and ends in, and per-lane variable shifts (vpsrlvd/vpsllvd) line them up. A load can run up to lanes u32
+    // past its block, so the last few blocks go through the scalar kernel.
+    template <usize Bits, typename T, usize Bytes>
+    [[gnu::always_inline]] inline void UnpackShuffleKernel(const u64* words, T* out, const usize blocks) noexcept
+    {
+        using V                    = typename U32Lanes<Bytes>::V;
+        constexpr usize lanes      = Bytes / sizeof(u32);
+        constexpr usize tailBlocks = (lanes / 2 + Bits - 1) / Bits;
+        typedef T W __attribute__((vector_size(lanes * sizeof(T))));
+        typedef u16 H __attribute__((vector_size(lanes * sizeof(u16))));
 
-    public:
-        inline reference      operator*() const noexcept { return BitRef((BufferType*)m_Ptr, m_Index); }
-        constexpr pointer     operator->() const noexcept = delete;
-        inline ConstIterator& operator++() noexcept
-        {
-            ++m_Index;
-            return *this;
-        }
-        inline ConstIterator operator++(const i32) noexcept
-        {
-            auto t = *this;
-            ++(*this);
-            return t;
-        }
-        constexpr ptrdiff    operator-(const Iterator& other) const noexcept { return m_Index - other.m_Index; }
-        inline ConstIterator operator+(const uintptr disp) const noexcept
+        const usize vectorBlocks = (blocks > tailBlocks) ? blocks - tailBlocks : 0;
+        const u8*   bytes        = reinterpret_cast<const u8*>(words);
+        for (usize b = 0; b < vectorBlocks; ++b, bytes += Bits * sizeof(u64), out += 64)
         {
-            auto temp = *this;
-            temp.m_Index += disp;
-            return temp;
-        };
-        inline ConstIterator operator-(const uintptr disp) const noexcept
-        {
-            auto temp = *this;
-            temp.m_Index -= disp;
-            return temp;
-        }
+#pragma GCC unroll 64
+            for (usize j = 0; j < 64; j += lanes)
+            {
+                const usize base = j * Bits / 32;
+                u32         loIndex[lanes], hiIndex[lanes], shifts[lanes];
+#pragma GCC unroll 16
+                for (usize k = 0; k < lanes; ++k)
+                {
+                    const usize bit = (j + k) * Bits;
+                    loIndex[k]      = static_cast<u32>(bit / 32 - base);
+                    // Values that do not cross into the next word shift their high part out, any lane will do.
+                    hiIndex[k] = static_cast<u32>(std::min(bit / 32 - base + 1, lanes - 1));
+                    shifts[k]  = static_cast<u32>(bit % 32);
+                }
+                V window, lo, hi, shift;
+                std::memcpy(&window, bytes + base * sizeof(u32), Bytes);
+                std::memcpy(&lo, loIndex, Bytes);
+                std::memcpy(&hi, hiIndex, Bytes);
+                std::memcpy(&shift, shifts, Bytes);
+                lo = __builtin_shuffle(window, lo);
+                hi = __builtin_shuffle(window, hi);
 
-    public:
-        friend bool operator==(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
-        {
-            return lhv.m_Index == rhv.m_Index;
+                const V value = ((lo >> shift) | ((hi << 1) << (31 - shift))) & static_cast<u32>(PackMask<Bits>);
+                W       narrow;
+                // Going through u16 keeps AVX2 from narrowing u32 lanes to bytes one element at a time.
+                if constexpr (sizeof(T) == 1)
+                    narrow = __builtin_convertvector(__builtin_convertvector(value, H), W);
+                else
+                    narrow = __builtin_convertvector(value, W);
+                std::memcpy(out + j, &narrow, sizeof(W));
+            }
         }
-        friend bool operator!=(const ConstIterator& lhv, const ConstIterator& rhv) noexcept { return !(lhv == rhv); }
-    };
+        UnpackKernel<Bits>(reinterpret_cast<const u64*>(bytes), out, blocks - vectorBlocks);
+    }
 
-public:
-    Vec() = default;
-    Vec(const usize size) noexcept : m_Size(size), m_Capacity(std::ceil((f128)m_Size / (f32)BitSize) * 2)
+    template <usize Bits, typename T>
+    [[gnu::target("avx2")]] void UnpackAVX2(const u64* words, T* out, const usize blocks) noexcept
     {
-        m_Buffer = new BufferType[m_Capacity];
+        UnpackShuffleKernel<Bits, T, 32>(words, out, blocks);
     }
-    Vec(const std::initializer_list<bool> list)
+    template <usize Bits, typename T>
+    [[gnu::target("avx512f,avx512bw")]] void UnpackAVX512(const u64* words, T* out, const usize blocks) noexcept
     {
-        m_Size     = list.size();
-        m_Capacity = std::ceil((f128)m_Size / (f32)BitSize) * 2;
-        m_Buffer   = new BufferType[m_Capacity]{ 0 };
-        if (!m_Buffer)
-            throw std::bad_alloc();
+        UnpackShuffleKernel<Bits, T, 64>(words, out, blocks);
+    }
+#endif
 
-        usize i = 0;
-        for (const auto& e : list)
-        {
-            m_Buffer[i / BitSize] |= e << ((BitSize - 1) - i % BitSize);
-            ++i;
-        }
+    // Packs blocks * 64 values into blocks * Bits words, keeping the low Bits bits of each value.
+    template <usize Bits, typename T>
+    void Pack(const T* in, u64* words, const usize blocks) noexcept
+    {
+        PackKernel<Bits>(in, words, blocks);
     }
-    Vec(const Vec<bool>& other) noexcept
+    template <usize Bits, typename T>
+    void Unpack(const u64* words, T* out, const usize blocks) noexcept
     {
-        if (&other == this)
-            return;
-
-        if (other.m_Buffer)
+#if VEC_X86_SIMD
+        if constexpr (UnpackWindowFits<Bits, 16>())
         {
-            m_Size     = other.m_Size;
-            m_Capacity = other.m_Capacity;
-            m_Buffer   = new BufferType[m_Capacity]{ 0 };
-            std::memcpy(m_Buffer, other.m_Buffer, std::ceil((f128)m_Size / (f32)BitSize));
+            if (CurrentSimdLevel() == SimdLevel::AVX512)
+                return UnpackAVX512<Bits>(words, out, blocks);
         }
-    }
-    Vec(Vec<bool>&& other) noexcept
-    {
-        if (&other == this)
-            return;
-
-        if (other.m_Buffer && other.m_Size)
+        if constexpr (UnpackWindowFits<Bits, 8>())
         {
-            std::swap(m_Size, other.m_Size);
-            std::swap(m_Capacity, other.m_Capacity);
-            std::swap(m_Buffer, other.m_Buffer);
+            if (CurrentSimdLevel() >= SimdLevel::AVX2)
+                return UnpackAVX2<Bits>(words, out, blocks);
         }
+#endif
+        UnpackKernel<Bits>(words, out, blocks);
     }
-    ~Vec() { Drop(); }
-
-public:
-    constexpr usize       Size() const noexcept { return m_Size; }
-    constexpr usize       Capacity() const noexcept { return m_Capacity; }
-    constexpr bool        Empty() const noexcept { return m_Size == 0; }
-    constexpr BufferType* Data() const noexcept { return m_Buffer; }
 
-public:
-    inline Iterator begin() const noexcept { return Iterator(m_Buffer, 0); }
-    inline Iterator end() const noexcept { return Iterator(m_Buffer, m_Size); }
+    // Predicate-to-mask kernels: bit i of words (LSB-first, as in Vec<bool>) is data[i] op value. Bits past size in
+    // the last word come out 0. Float comparisons follow the scalar rules, NaN only satisfies NotEqual.
+    enum class CmpOp
+    {
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual
+    };
 
-private:
-    constexpr void BitInsert(const bool e, const usize index) noexcept
+    template <CmpOp Op, typename T>
+    constexpr bool CompareOne(const T lhv, const T rhv) noexcept
     {
-        m_Buffer[index / BitSize] |= e << ((BitSize - 1) - index % BitSize);
+        if constexpr (Op == CmpOp::Equal)
+            return lhv == rhv;
+        else if constexpr (Op == CmpOp::NotEqual)
+            return lhv != rhv;
+        else if constexpr (Op == CmpOp::Less)
+            return lhv < rhv;
+        else if constexpr (Op == CmpOp::LessEqual)
+            return lhv <= rhv;
+        else if constexpr (Op == CmpOp::Greater)
+            return lhv > rhv;
+        else
+            return lhv >= rhv;
     }
-    constexpr bool BitAt(const usize index) const noexcept
+    template <CmpOp Op, typename T>
+    void CompareScalar(const T* data, const usize size, const T value, u64* words) noexcept
     {
-        return (m_Buffer[index / BitSize] >> ((BitSize - 1) - index % BitSize)) & 1;
+        for (usize w = 0; w * 64 < size; ++w)
+        {
+            const usize count = std::min<usize>(64, size - w * 64);
+            u64         bits  = 0;
+            for (usize j = 0; j < count; ++j)
+                bits |= u64{ CompareOne<Op>(data[w * 64 + j], value) } << j;
+            words[w] = bits;
+        }
     }
-    void Realloc(const usize newSize, const bool reserveExtra = true)
-    {
-        if (newSize == m_Size)
-            return;
-
-        const usize prev_size     = m_Size;
-        const usize prev_capacity = m_Capacity;
-        m_Size                    = newSize;
 
-        if (reserveExtra)
-            m_Capacity = std::ceil((f128)newSize * 2.0 / (f32)BitSize);
-        else
-            m_Capacity = std::ceil((f128)newSize / (f32)BitSize);
+    // Mask-driven compaction: copies the data[i] whose mask bit is set to out, in order, and returns how many there
+    // were. The vector paths store whole registers, so out needs room for CompactSlack elements past the last one.
+    inline constexpr usize CompactSlack = 16;
 
-        if (prev_size > 0)
+    template <typename T>
+    [[gnu::always_inline]] inline usize CompactScalar(const T* data, const u64* words, const usize size, T* out) noexcept
+    {
+        usize count = 0;
+        if constexpr (std::is_trivially_copyable_v<T>)
         {
-            BufferType* temp = m_Buffer;
-            m_Buffer         = new BufferType[m_Capacity];
-            if (!m_Buffer)
-                throw std::bad_alloc();
-            if (prev_size < m_Size)
-                std::memcpy(m_Buffer, temp, prev_capacity * sizeof(BufferType));
-            else
-                std::memcpy(m_Buffer, temp, m_Capacity * sizeof(BufferType));
-            delete[] temp;
+            // Branch-free: every element is written, only selected ones advance the cursor.
+            for (usize i = 0; i < size; ++i)
+            {
+                out[count] = data[i];
+                count += (words[i / 64] >> (i % 64)) & 1;
+            }
         }
         else
         {
-            if (m_Buffer)
-                delete[] m_Buffer;
-            m_Buffer = new BufferType[m_Capacity]{ 0 };
-            if (!m_Buffer)
-                throw std::bad_alloc();
+            for (usize i = 0; i < size; ++i)
+                if ((words[i / 64] >> (i % 64)) & 1)
+                    out[count++] = data[i];
         }
+        return count;
     }
-    inline void Drop() noexcept
+
+#if VEC_X86_SIMD
+    // Intrinsics may only be expanded inside functions compiled for their instruction set, so the generic kernels
+    // reach them through these small targeted wrappers, which inline once the kernel lands in a targeted entry point.
+    inline u64 ByteMask(const __m128i& mask) noexcept { return static_cast<u32>(_mm_movemask_epi8(mask)); }
+    [[gnu::target("avx2")]] inline u64 ByteMask(const __m256i& mask) noexcept
     {
-        delete[] m_Buffer;
-        m_Buffer   = nullptr;
-        m_Size     = 0;
-        m_Capacity = 0;
+        return static_cast<u32>(_mm256_movemask_epi8(mask));
     }
-
-public:
-    inline BitRef       operator[](const usize index) noexcept { return BitRef(m_Buffer, index); }
-    inline const BitRef operator[](const usize index) const noexcept { return BitRef(m_Buffer, index); }
-    inline Vec<bool>&   operator=(const Vec<bool>& other) noexcept
+    [[gnu::target("avx512f,avx512bw")]] inline u64 ByteMask(const __m512i& mask) noexcept
     {
-        if (&other == this)
-            return *this;
-
-        if (m_Buffer)
-            Drop();
+        return _mm512_movepi8_mask(mask);
+    }
+    [[gnu::target("bmi2")]] inline u64 Pext(const u64 value, const u64 mask) noexcept { return _pext_u64(value, mask); }
+    [[gnu::target("bmi2")]] inline u64 Pdep(const u64 value, const u64 mask) noexcept { return _pdep_u64(value, mask); }
 
-        m_Size     = other.m_Size;
-        m_Capacity = other.m_Capacity;
-        m_Buffer   = new BufferType[m_Capacity]{ 0 };
-        if (other.m_Buffer)
-            std::memcpy(m_Buffer, other.m_Buffer, std::ceil((f128)m_Size / (f32)BitSize));
+    // One bit per lane from a comparison result: movemask gives one bit per byte, pext keeps one per lane.
+    template <usize LaneBytes, usize Bytes, typename TMask>
+    [[gnu::always_inline]] inline u64 LaneBits(const TMask& mask) noexcept
+    {
+        u64 bytes;
+        if constexpr (Bytes == 16)
+        {
+            __m128i reg;
+            std::memcpy(&reg, &mask, Bytes);
+            bytes = ByteMask(reg);
+        }
+        else if constexpr (Bytes == 32)
+        {
+            __m256i reg;
+            std::memcpy(&reg, &mask, Bytes);
+            bytes = ByteMask(reg);
+        }
+        else
+        {
+            __m512i reg;
+            std::memcpy(&reg, &mask, Bytes);
+            bytes = ByteMask(reg);
+        }
 
-        return *this;
+        if constexpr (LaneBytes == 1)
+            return bytes;
+        else if constexpr (Bytes == 16)
+        {
+            // SSE2-only CPUs have no pext.
+            u64 bits = 0;
+            for (usize j = 0; j < Bytes / LaneBytes; ++j)
+                bits |= ((bytes >> (j * LaneBytes)) & 1) << j;
+            return bits;
+        }
+        else
+            return Pext(bytes, ~u64(0) / ((u64(1) << LaneBytes) - 1));
     }
-    inline Vec<bool>& operator=(Vec<bool>&& other) noexcept
+    // The comparison result goes straight into LaneBits, returning it would pass a vector by value (-Wpsabi).
+    template <CmpOp Op, usize LaneBytes, usize Bytes, typename V>
+    [[gnu::always_inline]] inline u64 MatchBits(const V& lhv, const V& rhv) noexcept
     {
-        if (&other == this)
-            return *this;
-
-        if (m_Buffer)
-            Drop();
-
-        std::swap(m_Size, other.m_Size);
-        std::swap(m_Capacity, other.m_Capacity);
-        std::swap(m_Buffer, other.m_Buffer);
-        return *this;
+        if constexpr (Op == CmpOp::Equal)
+            return LaneBits<LaneBytes, Bytes>(lhv == rhv);
+        else if constexpr (Op == CmpOp::NotEqual)
+            return LaneBits<LaneBytes, Bytes>(lhv != rhv);
+        else if constexpr (Op == CmpOp::Less)
+            return LaneBits<LaneBytes, Bytes>(lhv < rhv);
+        else if constexpr (Op == CmpOp::LessEqual)
+            return LaneBits<LaneBytes, Bytes>(lhv <= rhv);
+        else if constexpr (Op == CmpOp::Greater)
+            return LaneBits<LaneBytes, Bytes>(lhv > rhv);
+        else
+            return LaneBits<LaneBytes, Bytes>(lhv >= rhv);
     }
-    inline Vec<bool>& operator&=(const Vec<bool>& other) noexcept
+    template <CmpOp Op, typename T, usize Bytes>
+    [[gnu::always_inline]] inline void CompareKernel(const T* data, const usize size, const T value, u64* words) noexcept
     {
-        for (usize i = 0; i < m_Size / BitSize; ++i)
+        typedef T       V __attribute__((vector_size(Bytes)));
+        constexpr usize lanes  = Bytes / sizeof(T);
+        const V         needle = V{} + value;
+        const usize     full   = size / 64;
+        for (usize w = 0; w < full; ++w)
         {
-            if (other.m_Size / BitSize >= i)
-                m_Buffer[i] &= other.m_Buffer[i];
-            else
-                m_Buffer[i] &= 0;
+            u64 bits = 0;
+            for (usize v = 0; v < 64 / lanes; ++v)
+            {
+                V chunk;
+                std::memcpy(&chunk, data + w * 64 + v * lanes, Bytes);
+                bits |= MatchBits<Op, sizeof(T), Bytes>(chunk, needle) << (v * lanes);
+            }
+            words[w] = bits;
         }
-        return *this;
+        CompareScalar<Op>(data + full * 64, size - full * 64, value, words + full);
     }
-    inline Vec<bool> operator&(const Vec<bool>& other) const noexcept
+    template <CmpOp Op, typename T>
+    [[gnu::target("avx2,bmi2")]] void CompareAVX2(const T* data, const usize size, const T value, u64* words) noexcept
     {
-        auto cpy = *this;
-        for (usize i = 0; i < m_Size / BitSize; ++i)
-        {
-            if (other.m_Size / BitSize >= i)
-                cpy.m_Buffer[i] &= other.m_Buffer[i];
-            else
-                cpy.m_Buffer[i] &= 0;
-        }
-        return cpy;
+        CompareKernel<Op, T, 32>(data, size, value, words);
     }
-    inline Vec<bool>& operator|=(const Vec<bool>& other) noexcept
+    template <CmpOp Op, typename T>
+    [[gnu::target("avx512f,avx512bw,bmi2")]] void CompareAVX512(const T* data, const usize size, const T value,
+                                                               u64* words) noexcept
     {
-        for (usize i = 0; i < m_Size / BitSize; ++i)
-        {
-            if (other.m_Size / BitSize >= i)
-                m_Buffer[i] |= other.m_Buffer[i];
-            else
-                m_Buffer[i] |= 0;
-        }
-        return *this;
+        CompareKernel<Op, T, 64>(data, size, value, words);
     }
-    inline Vec<bool> operator|(const Vec<bool>& other) const noexcept
+
+    // Compaction runs a 64-bit mask word at a time. 1 and 2 byte elements are compacted eight bytes at a time by pext
+    // itself, with the mask bits spread into a byte mask by pdep.
+    template <typename Lane>
+    [[gnu::always_inline]] inline usize CompactNarrowWord(const Lane* data, const u64 bits, Lane* out) noexcept
     {
-        auto cpy = *this;
-        for (usize i = 0; i < m_Size / BitSize; ++i)
+        constexpr usize perChunk = 8 / sizeof(Lane);
+        constexpr u64   spread   = (sizeof(Lane) == 1) ? 0x0101010101010101 : 0x0001000100010001;
+        constexpr u64   laneMask = (sizeof(Lane) == 1) ? 0xFF : 0xFFFF;
+        usize           count    = 0;
+        for (usize j = 0; j < 64; j += perChunk)
         {
-            if (other.m_Size / BitSize >= i)
-                cpy.m_Buffer[i] |= other.m_Buffer[i];
-            else
-                cpy.m_Buffer[i] |= 0;
+            const u64 select = (bits >> j) & ((u64(1) << perChunk) - 1);
+            u64       chunk;
+            std::memcpy(&chunk, data + j, 8);
+            chunk = Pext(chunk, Pdep(select, spread) * laneMask);
+            std::memcpy(out + count, &chunk, 8);
+            count += static_cast<usize>(std::popcount(select));
         }
-        return cpy;
+        return count;
     }
-    inline Vec<bool>& operator^=(const Vec<bool>& other) noexcept
+    // 4 and 8 byte elements go through vpermd, its indices pulled out of 0x0706050403020100 by pext. 8-byte lanes
+    // are handled as pairs of 32-bit halves.
+    template <typename Lane>
+    [[gnu::target("avx2,bmi2")]] usize CompactAVX2(const Lane* data, const u64* words, const usize size, Lane* out) noexcept
     {
-        for (usize i = 0; i < m_Size / BitSize; ++i)
+        constexpr u64 byteLanes = 0x0101010101010101;
+        const usize   full      = size / 64;
+        usize         count     = 0;
+        for (usize w = 0; w < full; ++w, data += 64)
         {
-            if (other.m_Size / BitSize >= i)
-                m_Buffer[i] ^= other.m_Buffer[i];
+            if constexpr (sizeof(Lane) <= 2)
+                count += CompactNarrowWord(data, words[w], out + count);
             else
-                m_Buffer[i] ^= 0;
+            {
+                constexpr usize lanes = 32 / sizeof(Lane);
+                for (usize j = 0; j < 64; j += lanes)
+                {
+                    const u64 select  = (words[w] >> j) & ((u64(1) << lanes) - 1);
+                    const u64 dwords  = (sizeof(Lane) == 4) ? select : _pdep_u64(select, 0x55) * 3;
+                    const u64 indices = _pext_u64(0x0706050403020100, _pdep_u64(dwords, byteLanes) * 0xFF);
+                    const __m256i perm  = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<i64>(indices)));
+                    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + j));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + count), _mm256_permutevar8x32_epi32(chunk, perm));
+                    count += static_cast<usize>(std::popcount(select));
+                }
+            }
         }
-        return *this;
+        return count + CompactScalar(data, words + full, size - full * 64, out + count);
     }
-    inline Vec<bool> operator^(const Vec<bool>& other) const noexcept
+    // 4 and 8 byte elements go through vpcompressd/q.
+    template <typename Lane>
+    [[gnu::target("avx512f,avx512bw,bmi2")]] usize CompactAVX512(const Lane* data, const u64* words, const usize size,
+                                                                Lane* out) noexcept
     {
-        auto cpy = *this;
-        for (usize i = 0; i > m_Size / BitSize; ++i)
+        const usize full  = size / 64;
+        usize       count = 0;
+        for (usize w = 0; w < full; ++w, data += 64)
         {
-            if (other.m_Size / BitSize >= i)
-                cpy.m_Buffer[i] ^= other.m_Buffer[i];
+            if constexpr (sizeof(Lane) <= 2)
+                count += CompactNarrowWord(data, words[w], out + count);
             else
-                cpy.m_Buffer[i] ^= 0;
+            {
+                constexpr usize lanes = 64 / sizeof(Lane);
+                for (usize j = 0; j < 64; j += lanes)
+                {
+                    const u64     select = (words[w] >> j) & ((u64(1) << lanes) - 1);
+                    const __m512i chunk  = _mm512_loadu_si512(data + j);
+                    if constexpr (sizeof(Lane) == 4)
+                        _mm512_storeu_si512(out + count, _mm512_maskz_compress_epi32(static_cast<__mmask16>(select), chunk));
+                    else
+                        _mm512_storeu_si512(out + count, _mm512_maskz_compress_epi64(static_cast<__mmask8>(select), chunk));
+                    count += static_cast<usize>(std::popcount(select));
+                }
+            }
         }
-        return cpy;
+        return count + CompactScalar(data, words + full, size - full * 64, out + count);
     }
-    inline Vec<bool>& operator<<=(const usize pos) noexcept
+#endif
+
+    template <CmpOp Op, typename T>
+    void Compare(const T* data, const usize size, const T value, u64* words) noexcept
     {
-        BufferType t1{}, t2{};
-        for (usize i = m_Size / BitSize; i >= 0 && i != (usize)-1; --i)
+#if VEC_X86_SIMD
+        if constexpr (Vectorizable<T>)
         {
-            if (i == m_Size / BitSize)
-            {
-                t1 = m_Buffer[i];
-                t1 >>= (sizeof(BufferType) * 8) - pos;
-                m_Buffer[i] <<= pos;
-            }
-            else
+            switch (CurrentSimdLevel())
             {
-                t2 = m_Buffer[i];
-                t2 >>= (sizeof(BufferType) * 8) - pos;
-                m_Buffer[i] = (m_Buffer[i] << pos) | t1;
-                t1          = t2;
+                case SimdLevel::AVX512: return CompareAVX512<Op>(data, size, value, words);
+                case SimdLevel::AVX2: return CompareAVX2<Op>(data, size, value, words);
+                case SimdLevel::SSE2: return CompareKernel<Op, T, 16>(data, size, value, words);
+                default: break;
             }
         }
-        return *this;
+#endif
+        CompareScalar<Op>(data, size, value, words);
     }
-    inline Vec<bool>& operator>>=(const usize pos) noexcept
+    template <typename T>
+    usize Compact(const T* data, const u64* words, const usize size, T* out) noexcept
     {
-        BufferType t1{}, t2{};
-        for (usize i = 0; i < m_Size / BitSize; ++i)
+#if VEC_X86_SIMD
+        if constexpr (std::is_trivially_copyable_v<T> && std::has_single_bit(sizeof(T)) && sizeof(T) <= 8)
         {
-            if (i == 0)
-            {
-                t1 = m_Buffer[i];
-                t1 <<= (sizeof(BufferType) * 8) - pos;
-                m_Buffer[i] >>= pos;
-            }
-            else
+            // Elements are moved as raw lanes of the same width.
+            using Lane = std::conditional_t<sizeof(T) == 1, u8, std::conditional_t<sizeof(T) == 2, u16, std::conditional_t<sizeof(T) == 4, u32, u64>>>;
+            const Lane* src = reinterpret_cast<const Lane*>(data);
+            Lane*       dst = reinterpret_cast<Lane*>(out);
+            switch (CurrentSimdLevel())
             {
-                t2 = m_Buffer[i];
-                t2 <<= (sizeof(BufferType) * 8) - pos;
-                m_Buffer[i] = (m_Buffer[i] >> pos) | t1;
-                t1          = t2;
+                case SimdLevel::AVX512: return CompactAVX512(src, words, size, dst);
+                case SimdLevel::AVX2: return CompactAVX2(src, words, size, dst);
+                default: break;
             }
         }
-        return *this;
+#endif
+        return CompactScalar(data, words, size, out);
+    }
+
+    // Vec<bool>'s text form, one '0' or '1' per bit with bit i at character i. SpreadBits turns the 8 bits of a byte
+    // into the 8 bytes of a word, bit j into byte j as 0 or 1: the multiply copies the byte into every byte, the mask
+    // keeps bit j in byte j, and adding 0x7F carries any set bit into the top bit of its byte.
+    constexpr u64 SpreadBits(const u64 byte) noexcept
+    {
+        const u64 selected = (byte * 0x0101010101010101) & 0x8040201008040201;
+        return ((selected + 0x7F7F7F7F7F7F7F7F) >> 7) & 0x0101010101010101;
     }
-    inline Vec<bool> operator>>=(const usize pos) const noexcept
+    [[gnu::always_inline]] inline void BitsToCharsScalar(const u64* words, const usize bits, char* out) noexcept
     {
-        auto       cpy = *this;
-        BufferType t1{}, t2{};
-        for (usize i = 0; i < m_Size / BitSize; ++i)
+        usize i = 0;
+        if constexpr (std::endian::native == std::endian::little)
         {
-            if (i == 0)
-            {
-                t1 = cpy.m_Buffer[i];
-                t1 <<= (sizeof(BufferType) * 8) - pos;
-                cpy.m_Buffer[i] >>= pos;
-            }
-            else
+            for (; i + 8 <= bits; i += 8)
             {
-                t2 = cpy.m_Buffer[i];
-                t2 <<= (sizeof(BufferType) * 8) - pos;
-                cpy.m_Buffer[i] = (cpy.m_Buffer[i] >> pos) | t1;
-                t1              = t2;
+                const u64 chars = SpreadBits((words[i / 64] >> (i % 64)) & 0xFF) | 0x3030303030303030;
+                std::memcpy(out + i, &chars, sizeof(chars));
             }
         }
-        return cpy;
+        for (; i < bits; ++i)
+            out[i] = static_cast<char>('0' + ((words[i / 64] >> (i % 64)) & 1));
     }
-    inline Vec<bool> operator<<(const usize pos) const noexcept
+    // Returns false if a character is neither '0' nor '1'; bits past size in the last word come out 0.
+    [[gnu::always_inline]] inline bool CharsToBitsScalar(const char* text, const usize size, u64* words) noexcept
     {
-        auto       cpy = *this;
-        BufferType t1{}, t2{};
-        for (usize i = cpy.m_Size / BitSize; i >= 0 && i != (usize)-1; --i)
+        u8 invalid = 0;
+        for (usize w = 0; w * 64 < size; ++w)
         {
-            if (i == cpy.m_Size / BitSize)
-            {
-                t1 = cpy.m_Buffer[i];
-                t1 >>= (sizeof(BufferType) * 8) - pos;
-                cpy.m_Buffer[i] <<= pos;
-            }
-            else
+            const usize count = std::min<usize>(64, size - w * 64);
+            u64         bits  = 0;
+            for (usize j = 0; j < count; ++j)
             {
-                t2 = cpy.m_Buffer[i];
-                t2 >>= (sizeof(BufferType) * 8) - pos;
-                cpy.m_Buffer[i] = (cpy.m_Buffer[i] << pos) | t1;
-                t1              = t2;
+                const u8 c = static_cast<u8>(text[w * 64 + j]);
+                bits |= u64{ c == '1' } << j;
+                invalid |= (c & 0xFE) ^ '0';
             }
+            words[w] = bits;
         }
-        return cpy;
+        return invalid == 0;
     }
-    inline Vec<bool>& operator<<(const Vec<bool>& other) noexcept
+
+#if VEC_X86_SIMD
+    // '0' and '1' differ only in the lowest bit, so a character is valid exactly when it equals '0' with that bit
+    // cleared.
+    template <usize Bytes>
+    [[gnu::always_inline]] inline bool CharsToBitsKernel(const char* text, const usize size, u64* words) noexcept
     {
-        if (&other == this)
-            return *this;
+        typedef u8 V __attribute__((vector_size(Bytes)));
+        V          zero, one, clear;
+        std::memset(&zero, '0', Bytes);
+        std::memset(&one, '1', Bytes);
+        std::memset(&clear, 0xFE, Bytes);
 
-        if (other.m_Size > 0)
+        const usize full    = size / 64;
+        u64         invalid = 0;
+        for (usize w = 0; w < full; ++w)
         {
-            const usize prev_size = m_Size;
-            Realloc(other.m_Size + m_Size);
-            for (usize i = prev_size; i < m_Size; ++i)
-                this->operator[](i) = other[i - prev_size];
+            u64 bits = 0;
+            for (usize v = 0; v < 64 / Bytes; ++v)
+            {
+                V chunk;
+                std::memcpy(&chunk, text + w * 64 + v * Bytes, Bytes);
+                bits |= MatchBits<CmpOp::Equal, 1, Bytes>(chunk, one) << (v * Bytes);
+                invalid |= MatchBits<CmpOp::NotEqual, 1, Bytes>(chunk & clear, zero);
+            }
+            words[w] = bits;
         }
-        return *this;
+        return CharsToBitsScalar(text + full * 64, size - full * 64, words + full) && invalid == 0;
     }
-    inline Vec<bool> operator~() const noexcept
+    [[gnu::target("avx2,bmi2")]] inline bool CharsToBitsAVX2(const char* text, const usize size, u64* words) noexcept
     {
-        auto copy = *this;
-        for (usize i = 0; i < m_Size / BitSize; ++i)
-            copy.m_Buffer[i] = ~m_Buffer[i];
-        return copy;
+        return CharsToBitsKernel<32>(text, size, words);
+    }
+    [[gnu::target("avx512f,avx512bw,bmi2")]] inline bool CharsToBitsAVX512(const char* text, const usize size,
+                                                                           u64* words) noexcept
+    {
+        return CharsToBitsKernel<64>(text, size, words);
     }
 
-public:
-    void Push(const bool e)
+    // Each half of a word is broadcast, every output byte picks the byte of the half holding its bit, and comparing
+    // against that bit's mask gives 0 or -1, which subtracted from '0' gives '0' or '1'.
+    [[gnu::target("avx2")]] inline void BitsToCharsAVX2(const u64* words, const usize bits, char* out) noexcept
     {
-        if (m_Size >= m_Capacity)
+        const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
+                                                3, 3, 3, 3, 3, 3, 3, 3);
+        const __m256i select = _mm256_set1_epi64x(static_cast<i64>(0x8040201008040201));
+        const __m256i zero   = _mm256_set1_epi8('0');
+        const usize   full   = bits / 64;
+        for (usize w = 0; w < full; ++w)
         {
-            Realloc(m_Size + 1);
-            BitInsert(e, m_Size - 1);
+            for (usize half = 0; half < 2; ++half)
+            {
+                const u32 bits32 = static_cast<u32>(words[w] >> (half * 32));
+                __m256i   chars  = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<i32>(bits32)), spread);
+                chars            = _mm256_cmpeq_epi8(_mm256_and_si256(chars, select), select);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w * 64 + half * 32), _mm256_sub_epi8(zero, chars));
+            }
         }
-        else
-            BitInsert(e, m_Size++);
+        BitsToCharsScalar(words + full, bits - full * 64, out + full * 64);
     }
-    constexpr bool Pop()
+    // AVX-512 selects between '0' and '1' under a 64-bit mask, which is exactly one word.
+    [[gnu::target("avx512f,avx512bw")]] inline void BitsToCharsAVX512(const u64* words, const usize bits,
+                                                                      char* out) noexcept
     {
-        if (m_Size > 0)
-            return BitAt(m_Size--);
-        else
-            throw std::out_of_range("Tried calling Pop() on an empty vector.");
+        const __m512i zero = _mm512_set1_epi8('0');
+        const __m512i one  = _mm512_set1_epi8('1');
+        const usize   full = bits / 64;
+        for (usize w = 0; w < full; ++w)
+            _mm512_storeu_si512(out + w * 64, _mm512_mask_blend_epi8(words[w], zero, one));
+        BitsToCharsScalar(words + full, bits - full * 64, out + full * 64);
     }
-    inline BitRef Front()
+#endif
+
+    inline void BitsToChars(const u64* words, const usize bits, char* out) noexcept
     {
-        if (m_Size > 0)
-            return this->operator[](0);
-        else
-            throw std::out_of_range("Tried calling Front() on an empty vector.");
+#if VEC_X86_SIMD
+        switch (CurrentSimdLevel())
+        {
+            case SimdLevel::AVX512: return BitsToCharsAVX512(words, bits, out);
+            case SimdLevel::AVX2: return BitsToCharsAVX2(words, bits, out);
+            default: break;
+        }
+#endif
+        BitsToCharsScalar(words, bits, out);
     }
-    inline const BitRef Front() const
+    inline bool CharsToBits(const char* text, const usize size, u64* words) noexcept
     {
-        if (m_Size > 0)
-            return this->operator[](0);
+#if VEC_X86_SIMD
+        switch (CurrentSimdLevel())
+        {
+            case SimdLevel::AVX512: return CharsToBitsAVX512(text, size, words);
+            case SimdLevel::AVX2: return CharsToBitsAVX2(text, size, words);
+            case SimdLevel::SSE2: return CharsToBitsKernel<16>(text, size, words);
+            default: break;
+        }
+#endif
+        return CharsToBitsScalar(text, size, words);
+    }
+} // namespace simd
+
+// LSD radix sort over 8-bit digits. Keys are mapped to unsigned integers whose natural order matches the key order
+// (signed keys get their sign bit flipped), then each pass scatters the elements by one digit into the other buffer.
+// Every element is relocated exactly once per pass, so the element type only has to be trivially relocatable. Passes
+// where all keys share the same digit are skipped, which makes small key ranges in wide types cheap.
+namespace radix
+{
+    template <typename K>
+    concept Key = Integral<K> && !std::is_same_v<K, bool>;
+
+    // Below this many elements a comparison sort beats building the histograms.
+    inline constexpr usize SmallSortThreshold = 64;
+
+    template <Key K>
+    constexpr std::make_unsigned_t<K> OrderedBits(const K key) noexcept
+    {
+        using U = std::make_unsigned_t<K>;
+        if constexpr (std::is_signed_v<K>)
+            return static_cast<U>(key) ^ static_cast<U>(U{ 1 } << (sizeof(K) * 8 - 1));
         else
-            throw std::out_of_range("Tried calling Front() on an empty vector.");
+            return static_cast<U>(key);
+    }
+
+    // Stable sort of data[0, size) by keyOf(element). scratch must have room for size elements, its contents are
+    // garbage afterwards.
+    template <typename T, typename TKeyOf>
+    void Sort(T* data, T* scratch, const usize size, TKeyOf& keyOf) noexcept
+    {
+        using K                = std::remove_cvref_t<std::invoke_result_t<TKeyOf&, const T&>>;
+        constexpr usize passes = sizeof(K);
+        const auto      digit  = [&](const T& value, const usize pass) noexcept -> usize
+        { return (OrderedBits(keyOf(value)) >> (pass * 8)) & 0xFF; };
+
+        usize counts[passes][256]{};
+        for (usize i = 0; i < size; ++i)
+            for (usize p = 0; p < passes; ++p)
+                ++counts[p][digit(data[i], p)];
+
+        T* src = data;
+        T* dst = scratch;
+        for (usize p = 0; p < passes; ++p)
+        {
+            usize* offsets = counts[p];
+            if (offsets[digit(src[0], p)] == size)
+                continue;
+
+            usize offset = 0;
+            for (usize d = 0; d < 256; ++d)
+            {
+                const usize count = offsets[d];
+                offsets[d]        = offset;
+                offset += count;
+            }
+            for (usize i = 0; i < size; ++i)
+                std::memcpy(static_cast<void*>(dst + offsets[digit(src[i], p)]++), src + i, sizeof(T));
+            std::swap(src, dst);
+        }
+        if (src != data)
+            std::memcpy(static_cast<void*>(data), src, size * sizeof(T));
+    }
+} // namespace radix
+
+// Bulk number formatting on std::to_chars. The caller provides room for MaxChars<T> characters per element plus the
+// separators, so elements are written straight into the buffer with no stream or locale in between.
+namespace text
+{
+    template <typename T>
+    concept Number = Arithmetic<T> && !std::is_same_v<T, bool>;
+
+    // Longest std::to_chars output: sign and digits for integers, the shortest round-trip form for floating point
+    // (sign, 21 digits, point, exponent sign and a 4 digit exponent for an 80-bit long double).
+    template <Number T>
+    inline constexpr usize MaxChars = FloatingPoint<T> ? 32 : std::numeric_limits<T>::digits10 + 3;
+
+    // Writes data[0..count) to out, separated by separator, and returns the end of what was written.
+    template <Number T>
+    char* Format(const T* data, const usize count, const std::string_view separator, char* out) noexcept
+    {
+        for (usize i = 0; i < count; ++i)
+        {
+            if (i > 0)
+            {
+                std::memcpy(out, separator.data(), separator.size());
+                out += separator.size();
+            }
+            out = std::to_chars(out, out + MaxChars<T>, data[i]).ptr;
+        }
+        return out;
+    }
+    constexpr bool IsSpace(const char c) noexcept { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+} // namespace text
+
+// Fixed set of worker threads with one task deque per worker. Workers pop their own deque from the back and steal
+// from the front of the others when they run dry. Threads that wait inside ParallelFor() run queued tasks as well,
+// so nested parallel calls cannot starve the pool.
+class ThreadPool
+{
+private:
+    struct Queue
+    {
+        std::mutex                        m_Mutex;
+        std::deque<std::function<void()>> m_Tasks;
+    };
+
+private:
+    usize                          m_WorkerCount = 0;
+    std::unique_ptr<Queue[]>       m_Queues;
+    std::unique_ptr<std::thread[]> m_Threads;
+    std::atomic<usize>             m_Pending = 0;
+    std::atomic<usize>             m_NextQueue = 0;
+    std::atomic<bool>              m_Stop      = false;
+    std::mutex                     m_SleepMutex;
+    std::condition_variable        m_Wake;
+
+private:
+    static inline thread_local const ThreadPool* s_Owner       = nullptr;
+    static inline thread_local usize             s_WorkerIndex = 0;
+
+public:
+    // A chunk should carry at least this many bytes of elements, smaller chunks cost more in scheduling than they
+    // gain in parallelism.
+    static constexpr usize MinChunkBytes = 16 * 1024;
+    // Chunks per participating thread, enough slack for stealing to even out uneven chunks.
+    static constexpr usize ChunksPerThread = 4;
+
+public:
+    explicit ThreadPool(const usize workerCount = DefaultWorkerCount())
+        : m_WorkerCount(workerCount), m_Queues(std::make_unique<Queue[]>(std::max<usize>(workerCount, 1))),
+          m_Threads(std::make_unique<std::thread[]>(workerCount))
+    {
+        for (usize i = 0; i < m_WorkerCount; ++i)
+            m_Threads[i] = std::thread([this, i] { WorkerLoop(i); });
+    }
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(m_SleepMutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (usize i = 0; i < m_WorkerCount; ++i)
+            m_Threads[i].join();
+    }
+
+public:
+    // The thread calling ParallelFor() takes part in the work, so a pool for N cores needs N - 1 workers.
+    static usize DefaultWorkerCount() noexcept
+    {
+        const usize cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+    constexpr usize WorkerCount() const noexcept { return m_WorkerCount; }
+
+public:
+    void Submit(std::function<void()> task)
+    {
+        const usize index = (s_Owner == this) ? s_WorkerIndex : m_NextQueue.fetch_add(1) % QueueCount();
+        m_Pending.fetch_add(1);
+        {
+            std::lock_guard lock(m_Queues[index].m_Mutex);
+            m_Queues[index].m_Tasks.push_back(std::move(task));
+        }
+        // Taking the lock orders this wake-up after a worker's check of m_Pending, so it cannot be lost.
+        {
+            std::lock_guard lock(m_SleepMutex);
+        }
+        m_Wake.notify_one();
+    }
+
+    // Number of chunks ParallelFor() cuts count items into when every chunk should hold at least grain items.
+    usize ChunkCount(const usize count, const usize grain) const noexcept
+    {
+        return std::min(count / std::max<usize>(grain, 1), (m_WorkerCount + 1) * ChunksPerThread);
+    }
+
+    // Calls fn(chunk) for every chunk in [0, chunks), on the calling thread and the workers. Returns once every chunk
+    // has run; the first exception thrown by fn is rethrown here and the chunks that have not started yet are skipped.
+    template <typename TFn>
+    void ParallelChunks(const usize chunks, TFn&& fn)
+    {
+        if (chunks <= 1)
+        {
+            if (chunks == 1)
+                fn(usize{ 0 });
+            return;
+        }
+
+        std::atomic<usize> remaining = chunks;
+        std::atomic<bool>  failed    = false;
+        std::exception_ptr error;
+        const auto         runChunk = [&](const usize chunk)
+        {
+            try
+            {
+                if (!failed.load(std::memory_order_relaxed))
+                    fn(chunk);
+            }
+            catch (...)
+            {
+                if (!failed.exchange(true))
+                    error = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_release);
+        };
+
+        for (usize chunk = 1; chunk < chunks; ++chunk)
+            Submit([&runChunk, chunk] { runChunk(chunk); });
+        runChunk(0);
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (!RunOne())
+                std::this_thread::yield();
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+    // Splits [0, count) into chunks of at least grain items and calls fn(begin, end) on each. Inputs too small for
+    // two chunks run serially on the calling thread.
+    template <typename TFn>
+    void ParallelFor(const usize count, const usize grain, TFn&& fn)
+    {
+        const usize chunks = ChunkCount(count, grain);
+        if (chunks <= 1)
+        {
+            if (count > 0)
+                fn(usize{ 0 }, count);
+            return;
+        }
+        ParallelChunks(chunks, [&](const usize chunk) { fn(count * chunk / chunks, count * (chunk + 1) / chunks); });
+    }
+
+private:
+    constexpr usize QueueCount() const noexcept { return std::max<usize>(m_WorkerCount, 1); }
+    bool            TryPop(const usize index, const bool steal, std::function<void()>& task)
+    {
+        Queue&          queue = m_Queues[index];
+        std::lock_guard lock(queue.m_Mutex);
+        if (queue.m_Tasks.empty())
+            return false;
+
+        if (steal)
+        {
+            task = std::move(queue.m_Tasks.front());
+            queue.m_Tasks.pop_front();
+        }
+        else
+        {
+            task = std::move(queue.m_Tasks.back());
+            queue.m_Tasks.pop_back();
+        }
+        m_Pending.fetch_sub(1);
+        return true;
+    }
+    // Runs one queued task, preferring the caller's own queue. Returns false if every queue was empty.
+    bool RunOne()
+    {
+        const usize self = (s_Owner == this) ? s_WorkerIndex : 0;
+
+        std::function<void()> task;
+        bool                  found = s_Owner == this && TryPop(self, false, task);
+        for (usize i = 0; !found && i < QueueCount(); ++i)
+            found = TryPop((self + i) % QueueCount(), true, task);
+        if (found)
+            task();
+        return found;
+    }
+    void WorkerLoop(const usize index)
+    {
+        s_Owner       = this;
+        s_WorkerIndex = index;
+        while (true)
+        {
+            if (RunOne())
+                continue;
+
+            std::unique_lock lock(m_SleepMutex);
+            m_Wake.wait(lock, [this] { return m_Stop || m_Pending.load() > 0; });
+            if (m_Stop)
+                return;
+        }
+    }
+};
+
+inline ThreadPool& DefaultThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+template <typename T, typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+class Vec
+{
+private:
+    T*                           m_Buffer   = nullptr;
+    usize                        m_Size     = 0;
+    usize                        m_Capacity = 0;
+    [[no_unique_address]] TAlloc m_Alloc;
+
+private:
+    static inline std::atomic<usize> s_AllocCount = 0;
+
+public:
+    class ConstIterator;
+    class Iterator
+    {
+        friend class ConstIterator;
+
+    public:
+        using iterator_concept  = std::contiguous_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = T;
+        using element_type      = T;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+
+    private:
+        pointer m_Ptr = nullptr;
+
+    public:
+        Iterator() = default;
+        explicit Iterator(pointer ptr) noexcept : m_Ptr(ptr) {}
+
+    public:
+        constexpr reference operator*() const noexcept { return *m_Ptr; }
+        constexpr pointer   operator->() const noexcept { return m_Ptr; };
+        constexpr reference operator[](const difference_type index) const noexcept { return m_Ptr[index]; }
+        inline Iterator&    operator++() noexcept
+        {
+            ++m_Ptr;
+            return *this;
+        }
+        Iterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+        inline Iterator& operator--() noexcept
+        {
+            --m_Ptr;
+            return *this;
+        }
+        Iterator operator--(const i32) noexcept
+        {
+            auto t = *this;
+            --(*this);
+            return t;
+        }
+        inline Iterator& operator+=(const difference_type disp) noexcept
+        {
+            m_Ptr += disp;
+            return *this;
+        }
+        inline Iterator& operator-=(const difference_type disp) noexcept
+        {
+            m_Ptr -= disp;
+            return *this;
+        }
+        constexpr difference_type operator-(const Iterator& other) const noexcept { return m_Ptr - other.m_Ptr; }
+        inline Iterator           operator+(const difference_type disp) const noexcept
+        {
+            Iterator temp = *this;
+            temp.m_Ptr += disp;
+            return temp;
+        };
+        inline Iterator operator-(const difference_type disp) const noexcept
+        {
+            Iterator temp = *this;
+            temp.m_Ptr -= disp;
+            return temp;
+        }
+
+    public:
+        friend Iterator operator+(const difference_type disp, const Iterator& it) noexcept { return it + disp; }
+        friend bool operator==(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Ptr == rhv.m_Ptr; }
+        friend auto operator<=>(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Ptr <=> rhv.m_Ptr; }
+    };
+    class ConstIterator
+    {
+    public:
+        using iterator_concept  = std::contiguous_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = T;
+        using element_type      = const T;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+    private:
+        pointer m_Ptr = nullptr;
+
+    public:
+        ConstIterator() = default;
+        explicit ConstIterator(pointer ptr) noexcept : m_Ptr(ptr) {}
+        ConstIterator(Iterator it) noexcept : m_Ptr(it.m_Ptr) {}
+
+    public:
+        constexpr reference   operator*() const noexcept { return *m_Ptr; }
+        constexpr pointer     operator->() const noexcept { return m_Ptr; };
+        constexpr reference   operator[](const difference_type index) const noexcept { return m_Ptr[index]; }
+        inline ConstIterator& operator++() noexcept
+        {
+            ++m_Ptr;
+            return *this;
+        }
+        inline ConstIterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+        inline ConstIterator& operator--() noexcept
+        {
+            --m_Ptr;
+            return *this;
+        }
+        inline ConstIterator operator--(const i32) noexcept
+        {
+            auto t = *this;
+            --(*this);
+            return t;
+        }
+        inline ConstIterator& operator+=(const difference_type disp) noexcept
+        {
+            m_Ptr += disp;
+            return *this;
+        }
+        inline ConstIterator& operator-=(const difference_type disp) noexcept
+        {
+            m_Ptr -= disp;
+            return *this;
+        }
+        constexpr difference_type operator-(const ConstIterator& other) const noexcept { return m_Ptr - other.m_Ptr; }
+        inline ConstIterator      operator+(const difference_type disp) const noexcept
+        {
+            ConstIterator temp = *this;
+            temp.m_Ptr += disp;
+            return temp;
+        };
+        inline ConstIterator operator-(const difference_type disp) const noexcept
+        {
+            ConstIterator temp = *this;
+            temp.m_Ptr -= disp;
+            return temp;
+        }
+
+    public:
+        friend ConstIterator operator+(const difference_type disp, const ConstIterator& it) noexcept
+        {
+            return it + disp;
+        }
+        friend bool operator==(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+        {
+            return lhv.m_Ptr == rhv.m_Ptr;
+        }
+        friend auto operator<=>(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+        {
+            return lhv.m_Ptr <=> rhv.m_Ptr;
+        }
+    };
+    // Kept for source compatibility, plain Iterator already models every iterator category.
+    using ForwardIterator      = Iterator;
+    using RandomAccessIterator = Iterator;
+
+public:
+    Vec() noexcept { AdoptInlineStorage(); }
+    explicit Vec(const TAlloc& alloc) noexcept : m_Alloc(alloc) {}
+    Vec(const usize size, const TAlloc& alloc = TAlloc()) : m_Alloc(alloc)
+    {
+        m_Buffer   = Allocate(GrowCapacity(size));
+        m_Capacity = GrowCapacity(size);
+        std::uninitialized_value_construct_n(m_Buffer, size);
+        m_Size = size;
+    }
+    Vec(const std::initializer_list<T> list, const TAlloc& alloc = TAlloc()) : m_Alloc(alloc)
+    {
+        m_Size     = list.size();
+        m_Capacity = GrowCapacity(m_Size);
+        m_Buffer   = Allocate(m_Capacity);
+        std::uninitialized_copy(list.begin(), list.end(), m_Buffer);
+    }
+    Vec(const Vec<T, TAlloc, TGrowth>& other) : m_Alloc(other.m_Alloc)
+    {
+        if (&other == this)
+            return;
+
+        m_Buffer   = Allocate(other.m_Capacity);
+        m_Capacity = other.m_Capacity;
+        std::uninitialized_copy(other.m_Buffer, other.m_Buffer + other.m_Size, m_Buffer);
+        m_Size = other.m_Size;
+    }
+    Vec(Vec<T, TAlloc, TGrowth>&& other) noexcept : m_Alloc(other.m_Alloc)
+    {
+        if (&other == this)
+            return;
+
+        TakeFrom(other);
+    }
+    ~Vec() { Drop(); }
+
+public:
+    constexpr usize Size() const noexcept { return m_Size; }
+    constexpr usize Capacity() const noexcept { return m_Capacity; }
+    constexpr bool  Empty() const noexcept { return m_Size == 0; }
+    constexpr T*    Data() const noexcept { return m_Buffer; }
+    constexpr usize MaxSize() const noexcept { return std::numeric_limits<usize>::max() / sizeof(T); }
+    constexpr const TAlloc& Allocator() const noexcept { return m_Alloc; }
+
+public:
+    // Number of buffers allocated by every Vec<T, TAlloc, TGrowth> so far, handy for spotting heap traffic in hot loops.
+    static usize AllocCount() noexcept { return s_AllocCount.load(std::memory_order_relaxed); }
+    static void  ResetAllocCount() noexcept { s_AllocCount.store(0, std::memory_order_relaxed); }
+
+public:
+    inline Iterator      begin() noexcept { return Iterator(m_Buffer); }
+    inline Iterator      end() noexcept { return Iterator(m_Buffer + m_Size); }
+    inline ConstIterator begin() const noexcept { return ConstIterator(m_Buffer); }
+    inline ConstIterator end() const noexcept { return ConstIterator(m_Buffer + m_Size); }
+    inline ConstIterator cbegin() const noexcept { return ConstIterator(m_Buffer); }
+    inline ConstIterator cend() const noexcept { return ConstIterator(m_Buffer + m_Size); }
+
+private:
+    void Realloc(const usize newSize)
+    {
+        if (newSize < m_Size)
+        {
+            std::destroy(m_Buffer + newSize, m_Buffer + m_Size);
+            m_Size = newSize;
+            ShrinkIfDrained();
+        }
+        else if (newSize > m_Size)
+        {
+            if (newSize > m_Capacity)
+                SetCapacity(ResizeCapacity(newSize));
+            std::uninitialized_value_construct(m_Buffer + m_Size, m_Buffer + newSize);
+            m_Size = newSize;
+        }
+    }
+    // Capacity the buffer should grow to so that at least requiredSize elements fit.
+    constexpr usize GrowCapacity(const usize requiredSize) const noexcept
+    {
+        return std::max(requiredSize, TGrowth::Grow(requiredSize, sizeof(T)));
+    }
+    // Capacity for resizing to newSize: growth is geometric in the current size, so a run of small resizes stays
+    // amortized, while a single large jump (e.g. sizing a fresh buffer) gets exactly what it asked for.
+    constexpr usize ResizeCapacity(const usize newSize) const noexcept
+    {
+        return std::max(newSize, GrowCapacity(m_Size));
+    }
+    inline void ShrinkIfDrained()
+    {
+        if constexpr (TGrowth::ShrinkDivisor > 0)
+        {
+            if (m_Size > 0 && m_Size < m_Capacity / TGrowth::ShrinkDivisor && !BufferIsPinned())
+                SetCapacity(GrowCapacity(m_Size));
+        }
+    }
+    // Allocators that can resize a buffer themselves (see MappedAllocator) skip the allocate-relocate-free round
+    // trip, which also keeps the old and the new buffer from being alive at the same time.
+    static constexpr bool CanReallocate =
+        TriviallyRelocatable<T> && requires(TAlloc& alloc, void* ptr, usize n) { alloc.Reallocate(ptr, n, n, n); };
+    void Reallocate(const usize newCapacity)
+        requires CanReallocate
+    {
+        if (newCapacity > MaxSize())
+            throw std::bad_array_new_length();
+
+        void* buffer = m_Alloc.Reallocate(m_Buffer, m_Capacity * sizeof(T), newCapacity * sizeof(T), alignof(T));
+        m_Buffer     = static_cast<T*>(buffer);
+        m_Capacity   = newCapacity;
+    }
+    void SetCapacity(usize newCapacity)
+    {
+        // Inline storage has a fixed size, no reason to advertise less room than it actually has.
+        if constexpr (requires { TAlloc::InlineBytes; })
+        {
+            if (newCapacity > 0 && newCapacity * sizeof(T) <= TAlloc::InlineBytes && !BufferIsPinned())
+                newCapacity = TAlloc::InlineBytes / sizeof(T);
+        }
+
+        if constexpr (CanReallocate)
+        {
+            if (m_Buffer && newCapacity > 0)
+                return Reallocate(newCapacity);
+        }
+
+        T* buffer = (newCapacity > 0) ? Allocate(newCapacity) : nullptr;
+        Relocate(buffer, m_Buffer, m_Size);
+        Deallocate(m_Buffer, m_Capacity);
+        m_Buffer   = buffer;
+        m_Capacity = newCapacity;
+    }
+    // Moves the live elements into a freshly allocated buffer, leaving count uninitialized slots at index for the
+    // caller. The caller constructs into the gap before this is called so arguments aliasing the old buffer stay valid.
+    void RelocateInto(T* buffer, const usize capacity, const usize index, const usize count) noexcept
+    {
+        Relocate(buffer, m_Buffer, index);
+        Relocate(buffer + index + count, m_Buffer + index, m_Size - index);
+        Deallocate(m_Buffer, m_Capacity);
+        m_Buffer   = buffer;
+        m_Capacity = capacity;
+    }
+    // Shifts [index, size) up by count within the current buffer, leaving count uninitialized slots at index.
+    inline void OpenGap(const usize index, const usize count) noexcept
+    {
+        Relocate(m_Buffer + index + count, m_Buffer + index, m_Size - index);
+    }
+    // Opens a gap of count slots at index and has construct(slot) fill it. If that throws, the gap is closed again
+    // and the vector is left as it was. construct must clean up after itself, as std::uninitialized_copy does.
+    template <typename TFn>
+    void FillGap(const usize index, const usize count, TFn&& construct)
+    {
+        OpenGap(index, count);
+        try
+        {
+            construct(m_Buffer + index);
+        }
+        catch (...)
+        {
+            Relocate(m_Buffer + index, m_Buffer + index + count, m_Size - index);
+            throw;
+        }
+    }
+    // FillGap() for a full buffer: construct(slot) fills the gap in a new buffer of the given capacity, and only then
+    // are the old elements moved over, so arguments aliasing the old buffer stay valid. A throw frees the new buffer.
+    template <typename TFn>
+    void GrowWithGap(const usize capacity, const usize index, const usize count, TFn&& construct)
+    {
+        if (count > MaxSize() - m_Size)
+            throw std::length_error("Tried growing a vector past MaxSize().");
+        T* buffer = Allocate(capacity);
+        try
+        {
+            construct(buffer + index);
+        }
+        catch (...)
+        {
+            Deallocate(buffer, capacity);
+            throw;
+        }
+        RelocateInto(buffer, capacity, index, count);
+    }
+    void AssignCopy(const T* first, const usize count)
+    {
+        if (first >= m_Buffer && first < m_Buffer + m_Size)
+        {
+            Vec<T, TAlloc, TGrowth> temp(m_Alloc);
+            temp.AssignCopy(first, count);
+            Swap(temp);
+            return;
+        }
+
+        Clear();
+        if (count > m_Capacity)
+            SetCapacity(GrowCapacity(count));
+        std::uninitialized_copy(first, first + count, m_Buffer);
+        m_Size = count;
+    }
+    inline T* Allocate(const usize count)
+    {
+        if (count == 0)
+            return nullptr;
+        if (count > MaxSize())
+            throw std::bad_array_new_length();
+
+        T* ptr = static_cast<T*>(m_Alloc.Allocate(count * sizeof(T), alignof(T)));
+        // Only heap allocations are counted, buffers served from the allocator's inline storage are free.
+        if constexpr (requires { m_Alloc.IsInline(ptr); })
+        {
+            if (m_Alloc.IsInline(ptr))
+                return ptr;
+        }
+        s_AllocCount.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+    inline void Deallocate(T* ptr, const usize count) noexcept
+    {
+        if (ptr)
+            m_Alloc.Deallocate(ptr, count * sizeof(T), alignof(T));
+    }
+    // Buffers that live inside the allocator object itself (see InlineAllocator) cannot change owners.
+    inline bool BufferIsPinned() const noexcept
+    {
+        if constexpr (requires { m_Alloc.IsInline(m_Buffer); })
+            return m_Alloc.IsInline(m_Buffer);
+        else
+            return false;
+    }
+    // Points a Vec without a buffer at the allocator's inline storage, if it has any. Never allocates.
+    inline void AdoptInlineStorage() noexcept
+    {
+        if constexpr (requires { m_Alloc.AllocateInline(); })
+        {
+            if constexpr (TAlloc::InlineBytes >= sizeof(T))
+            {
+                m_Buffer   = static_cast<T*>(m_Alloc.AllocateInline());
+                m_Capacity = TAlloc::InlineBytes / sizeof(T);
+            }
+        }
+    }
+    // Takes over other's elements, *this must not own a buffer. A pinned buffer is relocated into this allocator's own
+    // inline storage, which is free and of the same size, so this never allocates or throws.
+    void TakeFrom(Vec<T, TAlloc, TGrowth>& other) noexcept
+    {
+        if constexpr (requires { m_Alloc.AllocateInline(); })
+        {
+            if (other.BufferIsPinned())
+            {
+                m_Buffer   = static_cast<T*>(m_Alloc.AllocateInline());
+                m_Capacity = other.m_Capacity;
+                Relocate(m_Buffer, other.m_Buffer, other.m_Size);
+                m_Size       = other.m_Size;
+                other.m_Size = 0;
+                return;
+            }
+        }
+
+        m_Buffer         = other.m_Buffer;
+        m_Size           = other.m_Size;
+        m_Capacity       = other.m_Capacity;
+        other.m_Buffer   = nullptr;
+        other.m_Size     = 0;
+        other.m_Capacity = 0;
+        other.AdoptInlineStorage();
+    }
+    inline void Drop() noexcept
+    {
+        std::destroy(m_Buffer, m_Buffer + m_Size);
+        Deallocate(m_Buffer, m_Capacity);
+        m_Buffer   = nullptr;
+        m_Size     = 0;
+        m_Capacity = 0;
+    }
+
+private:
+    // Moves count live elements from src to dst, leaving the source slots uninitialized. The ranges may overlap.
+    static void Relocate(T* dst, T* src, const usize count) noexcept
+    {
+        if (count == 0 || dst == src)
+            return;
+
+        if constexpr (TriviallyRelocatable<T>)
+            std::memmove(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
+        else if (dst < src)
+        {
+            for (usize i = 0; i < count; ++i)
+            {
+                std::construct_at(dst + i, std::move(src[i]));
+                std::destroy_at(src + i);
+            }
+        }
+        else
+        {
+            for (usize i = count; i-- > 0;)
+            {
+                std::construct_at(dst + i, std::move(src[i]));
+                std::destroy_at(src + i);
+            }
+        }
+    }
+
+public:
+    inline void Push(const T& e) { EmplaceBack(e); }
+    inline void Push(T&& e) { EmplaceBack(std::move(e)); }
+    inline T    Pop()
+    {
+        if (m_Size > 0)
+        {
+            T value = std::move(m_Buffer[--m_Size]);
+            std::destroy_at(m_Buffer + m_Size);
+            ShrinkIfDrained();
+            return value;
+        }
+        else
+            throw std::out_of_range("Tried calling Pop() on an empty vector.");
+    }
+    inline T& Front()
+    {
+        if (m_Size > 0)
+            return m_Buffer[0];
+        else
+            throw std::out_of_range("Tried calling Front() on an empty vector.");
+    }
+    inline const T& Front() const
+    {
+        if (m_Size > 0)
+            return m_Buffer[0];
+        else
+            throw std::out_of_range("Tried calling Front() on an empty vector.");
+    }
+    inline T& Back()
+    {
+        if (m_Size > 0)
+            return m_Buffer[m_Size - 1];
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    inline const T& Back() const
+    {
+        if (m_Size > 0)
+            return m_Buffer[m_Size - 1];
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    inline T& At(const usize index)
+    {
+        if (index < m_Size)
+            return m_Buffer[index];
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    inline const T& At(const usize index) const
+    {
+        if (index < m_Size)
+            return m_Buffer[index];
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    void Assign(const usize count, const T& value)
+    {
+        if (&value >= m_Buffer && &value < m_Buffer + m_Size)
+        {
+            const T copy = value;
+            Assign(count, copy);
+            return;
+        }
+
+        Clear();
+        if (count > m_Capacity)
+            SetCapacity(GrowCapacity(count));
+        std::uninitialized_fill_n(m_Buffer, count, value);
+        m_Size = count;
+    }
+    inline void Assign(const ConstIterator begin, const ConstIterator end)
+    {
+        AssignCopy(begin.operator->(), end - begin);
+    }
+    inline void    Assign(const std::initializer_list<T> list) { AssignCopy(list.begin(), list.size()); }
+    constexpr void Swap(Vec<T, TAlloc, TGrowth>& other)
+    {
+        if (BufferIsPinned() || other.BufferIsPinned())
+        {
+            Vec<T, TAlloc, TGrowth> temp(std::move(other));
+            other = std::move(*this);
+            *this = std::move(temp);
+            return;
+        }
+
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Buffer, other.m_Buffer);
+        std::swap(m_Alloc, other.m_Alloc);
+    }
+    inline void Resize(const usize newSize) { Realloc(newSize); }
+    // Resize() for buffers that are about to be overwritten in bulk: new elements of trivial types are left
+    // uninitialized instead of being zeroed first. Other types are value-initialized as usual.
+    void ResizeForOverwrite(const usize newSize)
+    {
+        if constexpr (std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>)
+        {
+            if (newSize > m_Size)
+            {
+                if (newSize > m_Capacity)
+                    SetCapacity(ResizeCapacity(newSize));
+                m_Size = newSize;
+                return;
+            }
+        }
+        Realloc(newSize);
+    }
+    void Insert(const ConstIterator pos, const T& value)
+    {
+        const usize index = pos - cbegin();
+        if (m_Size < m_Capacity)
+        {
+            // value may be one of our own elements, in which case it is about to move up by one slot.
+            const T* src = &value;
+            if (src >= m_Buffer + index && src < m_Buffer + m_Size)
+                ++src;
+            FillGap(index, 1, [&](T* slot) { std::construct_at(slot, *src); });
+        }
+        else
+            GrowWithGap(GrowCapacity(m_Size + 1), index, 1, [&](T* slot) { std::construct_at(slot, value); });
+        ++m_Size;
+    }
+    void Insert(const ConstIterator pos, const ConstIterator first, const ConstIterator last)
+    {
+        const usize index       = pos - cbegin();
+        const usize insert_size = last - first;
+        if (insert_size == 0)
+            return;
+
+        const T*   src     = first.operator->();
+        const bool aliased = src >= m_Buffer && src < m_Buffer + m_Size;
+        const auto copy    = [&](T* slot) { std::uninitialized_copy(src, src + insert_size, slot); };
+        if (m_Size + insert_size <= m_Capacity && !aliased)
+            FillGap(index, insert_size, copy);
+        else
+        {
+            const usize capacity =
+                (m_Size + insert_size <= m_Capacity) ? m_Capacity : GrowCapacity(m_Size + insert_size);
+            GrowWithGap(capacity, index, insert_size, copy);
+        }
+        m_Size += insert_size;
+    }
+    void Erase(const ConstIterator pos)
+    {
+        if (!Empty())
+        {
+            const usize index = pos - cbegin();
+            std::destroy_at(m_Buffer + index);
+            Relocate(m_Buffer + index, m_Buffer + index + 1, m_Size - index - 1);
+            --m_Size;
+            ShrinkIfDrained();
+        }
+        else
+            throw std::out_of_range("Tried calling Erase() on an empty vector.");
+    }
+    void Reserve(const usize newCapacity)
+    {
+        if (newCapacity > m_Capacity)
+            SetCapacity(newCapacity);
+    }
+    void Erase(const ConstIterator first, const ConstIterator last)
+    {
+        if (!Empty())
+        {
+            const usize index = first - cbegin();
+            const usize count = last - first;
+            std::destroy(m_Buffer + index, m_Buffer + index + count);
+            Relocate(m_Buffer + index, m_Buffer + index + count, m_Size - index - count);
+            m_Size -= count;
+            ShrinkIfDrained();
+        }
+        else
+            throw std::out_of_range("Tried calling Erase() on an empty vector.");
+    }
+    inline void ShrinkToFit()
+    {
+        if (m_Capacity > m_Size && !BufferIsPinned())
+            SetCapacity(m_Size);
+    }
+    constexpr void Clear() noexcept
+    {
+        std::destroy(m_Buffer, m_Buffer + m_Size);
+        m_Size = 0;
+    }
+
+public:
+    template <typename... TArgs>
+    void Emplace(const ConstIterator pos, TArgs&&... args)
+    {
+        const usize index = pos - cbegin();
+        if (m_Size < m_Capacity)
+        {
+            if (index == m_Size)
+                std::construct_at(m_Buffer + index, std::forward<TArgs>(args)...);
+            else
+            {
+                // args may refer to elements that are about to be shifted, so build the value before opening the gap.
+                T temp(std::forward<TArgs>(args)...);
+                FillGap(index, 1, [&](T* slot) { std::construct_at(slot, std::move(temp)); });
+            }
+        }
+        else
+        {
+            GrowWithGap(GrowCapacity(m_Size + 1), index, 1,
+                        [&](T* slot) { std::construct_at(slot, std::forward<TArgs>(args)...); });
+        }
+        ++m_Size;
+    }
+    template <typename... TArgs>
+    void EmplaceBack(TArgs&&... args)
+    {
+        if (m_Size >= m_Capacity)
+        {
+            if constexpr (CanReallocate)
+            {
+                if (m_Buffer)
+                {
+                    // args may refer to our own elements, which the resize is free to move.
+                    T temp(std::forward<TArgs>(args)...);
+                    Reallocate(GrowCapacity(m_Size + 1));
+                    std::construct_at(m_Buffer + m_Size, std::move(temp));
+                    ++m_Size;
+                    return;
+                }
+            }
+            GrowWithGap(GrowCapacity(m_Size + 1), m_Size, 1,
+                        [&](T* slot) { std::construct_at(slot, std::forward<TArgs>(args)...); });
+        }
+        else
+            std::construct_at(m_Buffer + m_Size, std::forward<TArgs>(args)...);
+        ++m_Size;
+    }
+
+public:
+    // Bulk search and reductions, vectorized for arithmetic element types (see simd::).
+    inline Iterator Find(const T& value) noexcept
+        requires Arithmetic<T>
+    {
+        return begin() + simd::Find(m_Buffer, m_Size, value);
+    }
+    inline ConstIterator Find(const T& value) const noexcept
+        requires Arithmetic<T>
+    {
+        return cbegin() + simd::Find(m_Buffer, m_Size, value);
+    }
+    inline usize Count(const T& value) const noexcept
+        requires Arithmetic<T>
+    {
+        return simd::Count(m_Buffer, m_Size, value);
+    }
+    inline bool Contains(const T& value) const noexcept
+        requires Arithmetic<T>
+    {
+        return simd::Find(m_Buffer, m_Size, value) != m_Size;
+    }
+    inline std::pair<T, T> MinMax() const
+        requires Arithmetic<T>
+    {
+        if (m_Size > 0)
+            return simd::MinMax(m_Buffer, m_Size);
+        else
+            throw std::out_of_range("Tried calling MinMax() on an empty vector.");
+    }
+    inline simd::SumType<T> Sum() const noexcept
+        requires Arithmetic<T>
+    {
+        return simd::Sum(m_Buffer, m_Size);
+    }
+    template <typename TOtherAlloc, typename TOtherGrowth>
+    inline simd::SumType<T> Dot(const Vec<T, TOtherAlloc, TOtherGrowth>& other) const
+        requires Arithmetic<T>
+    {
+        if (m_Size == other.Size())
+            return simd::Dot(m_Buffer, other.Data(), m_Size);
+        else
+            throw std::invalid_argument("Tried calling Dot() on vectors of different sizes.");
+    }
+
+public:
+    // Integral elements are radix sorted, everything else goes through std::sort (introsort).
+    void Sort()
+    {
+        if constexpr (radix::Key<T>)
+            Sort([](const T& value) noexcept { return value; });
+        else
+            std::sort(begin(), end());
+    }
+    // Stable sort by an integral key, e.g. records.Sort([](const Record& r) { return r.id; }).
+    template <typename TKeyOf>
+        requires radix::Key<std::remove_cvref_t<std::invoke_result_t<TKeyOf&, const T&>>>
+    void Sort(TKeyOf keyOf)
+    {
+        if constexpr (TriviallyRelocatable<T>)
+        {
+            if (m_Size > radix::SmallSortThreshold)
+            {
+                T* scratch = Allocate(m_Size);
+                radix::Sort(m_Buffer, scratch, m_Size, keyOf);
+                Deallocate(scratch, m_Size);
+                return;
+            }
+        }
+        std::stable_sort(begin(), end(), [&](const T& lhv, const T& rhv) { return keyOf(lhv) < keyOf(rhv); });
+    }
+
+public:
+    // Parallel algorithms, run on pool (the shared DefaultThreadPool() unless one is passed in). Inputs too small to be
+    // worth splitting run serially on the calling thread.
+    template <typename TFn>
+    void ParallelForEach(TFn fn, ThreadPool& pool = DefaultThreadPool())
+    {
+        pool.ParallelFor(m_Size, ParallelGrain(), [&](const usize begin, const usize end)
+                         { std::for_each(m_Buffer + begin, m_Buffer + end, fn); });
+    }
+    // Returns a new vector holding fn(e) for every element e, the result type has to be default constructible.
+    template <typename TFn, typename U = std::remove_cvref_t<std::invoke_result_t<TFn&, const T&>>>
+    Vec<U> ParallelTransform(TFn fn, ThreadPool& pool = DefaultThreadPool()) const
+    {
+        // Trivial results are left uninitialized until the parallel pass writes them, with no serial zeroing first.
+        Vec<U> result;
+        result.ResizeForOverwrite(m_Size);
+        U* out = result.Data();
+        pool.ParallelFor(m_Size, ParallelGrain(), [&](const usize begin, const usize end)
+                         { std::transform(m_Buffer + begin, m_Buffer + end, out + begin, fn); });
+        return result;
+    }
+    // op has to be associative. Chunks are folded separately and the partial results combined in order, so op does
+    // not have to be commutative.
+    template <typename TOp>
+    T ParallelReduce(T init, TOp op, ThreadPool& pool = DefaultThreadPool()) const
+    {
+        const usize chunks = pool.ChunkCount(m_Size, ParallelGrain());
+        if (chunks <= 1)
+            return std::accumulate(m_Buffer, m_Buffer + m_Size, std::move(init), op);
+
+        // Slots are seeded from init rather than default constructed, so T needs no default constructor.
+        Vec<T> partials;
+        partials.Reserve(chunks);
+        for (usize chunk = 0; chunk < chunks; ++chunk)
+            partials.Push(init);
+        pool.ParallelChunks(chunks,
+                            [&](const usize chunk)
+                            {
+                                const T* first   = m_Buffer + m_Size * chunk / chunks;
+                                const T* last    = m_Buffer + m_Size * (chunk + 1) / chunks;
+                                partials[chunk] = std::accumulate(first + 1, last, *first, op);
+                            });
+        for (usize chunk = 0; chunk < chunks; ++chunk)
+            init = op(std::move(init), std::move(partials[chunk]));
+        return init;
+    }
+    // Sorts a power-of-two number of chunks in parallel, then merges neighbouring runs pairwise, halving the number of
+    // runs (and the available parallelism) every round.
+    template <typename TCompare = std::less<>>
+    void ParallelSort(TCompare comp = TCompare(), ThreadPool& pool = DefaultThreadPool())
+    {
+        const usize chunks = std::bit_floor(pool.ChunkCount(m_Size, ParallelGrain()) | 1);
+        const auto  bound  = [&](const usize chunk) { return m_Buffer + m_Size * chunk / chunks; };
+        pool.ParallelChunks(chunks, [&](const usize chunk) { std::sort(bound(chunk), bound(chunk + 1), comp); });
+        for (usize width = 1; width < chunks; width *= 2)
+        {
+            pool.ParallelChunks(chunks / (2 * width),
+                                [&](const usize pair)
+                                {
+                                    const usize first = pair * 2 * width;
+                                    std::inplace_merge(bound(first), bound(first + width), bound(first + 2 * width),
+                                                       comp);
+                                });
+        }
+    }
+    void ParallelFill(const T& value, ThreadPool& pool = DefaultThreadPool())
+    {
+        pool.ParallelFor(m_Size, ParallelGrain(), [&](const usize begin, const usize end)
+                         { std::fill(m_Buffer + begin, m_Buffer + end, value); });
+    }
+
+private:
+    static constexpr usize ParallelGrain() noexcept { return std::max<usize>(ThreadPool::MinChunkBytes / sizeof(T), 1); }
+
+public:
+    constexpr T&       operator[](const usize index) noexcept { return m_Buffer[index]; }
+    constexpr const T& operator[](const usize index) const noexcept { return m_Buffer[index]; }
+    inline Vec<T, TAlloc, TGrowth>&     operator=(const std::initializer_list<T> list)
+    {
+        AssignCopy(list.begin(), list.size());
+        return *this;
+    }
+    inline Vec<T, TAlloc, TGrowth>& operator=(const Vec<T, TAlloc, TGrowth>& other)
+    {
+        if (&other == this)
+            return *this;
+
+        AssignCopy(other.m_Buffer, other.m_Size);
+        return *this;
+    }
+    inline Vec<T, TAlloc, TGrowth>& operator=(Vec<T, TAlloc, TGrowth>&& other) noexcept
+    {
+        if (&other == this)
+            return *this;
+
+        Drop();
+        m_Alloc = other.m_Alloc;
+        TakeFrom(other);
+        return *this;
+    }
+    inline Vec<T, TAlloc, TGrowth>& operator<<(const Vec<T, TAlloc, TGrowth>& other)
+    {
+        if (&other == this)
+            return *this;
+
+        if (m_Size + other.m_Size > m_Capacity)
+            SetCapacity(GrowCapacity(m_Size + other.m_Size));
+        std::uninitialized_copy(other.m_Buffer, other.m_Buffer + other.m_Size, m_Buffer + m_Size);
+        m_Size += other.m_Size;
+        return *this;
+    }
+
+public:
+    friend std::ostream& operator<<(std::ostream& stream, const Vec<T, TAlloc, TGrowth>& other)
+    {
+        // Integers are formatted a block at a time by std::to_chars. Single byte integers print as characters and
+        // floats with the stream's precision, so they still go through the stream one by one.
+        if constexpr (Integral<T> && !std::is_same_v<T, bool> && sizeof(T) > 1)
+        {
+            constexpr usize Block = 256;
+            char            buffer[Block * (text::MaxChars<T> + 2)];
+            stream << "[ ";
+            for (usize i = 0; i < other.m_Size; i += Block)
+            {
+                const usize count = std::min(Block, other.m_Size - i);
+                char*       first = buffer;
+                if (i > 0)
+                {
+                    std::memcpy(first, ", ", 2);
+                    first += 2;
+                }
+                const char* last = text::Format(other.m_Buffer + i, count, ", ", first);
+                stream.write(buffer, last - buffer);
+            }
+            stream << " ]";
+            return stream;
+        }
+
+        stream << "[ ";
+        for (usize i = 0; i < other.m_Size; ++i)
+        {
+            if (i + 1 != other.m_Size)
+                stream << other.m_Buffer[i] << ", ";
+            else
+                stream << other.m_Buffer[i];
+        }
+        stream << " ]";
+        return stream;
+    }
+};
+
+template <typename T, typename TAlloc, typename TGrowth>
+struct IsTriviallyRelocatable<Vec<T, TAlloc, TGrowth>> : std::bool_constant<TriviallyRelocatable<TAlloc>>
+{
+};
+
+// Vec<T> with room for N elements stored inline, so small vectors never touch the heap. Once it outgrows the inline
+// storage it spills to the heap through the regular Vec growth path and behaves like any other Vec.
+template <typename T, usize N, typename TGrowth = GrowthDouble>
+class SmallVec : public Vec<T, InlineAllocator<sizeof(T) * N, alignof(T)>, TGrowth>
+{
+    using Base = Vec<T, InlineAllocator<sizeof(T) * N, alignof(T)>, TGrowth>;
+
+public:
+    SmallVec() = default;
+    SmallVec(const usize size) : SmallVec() { Base::Resize(size); }
+    SmallVec(const std::initializer_list<T> list)
+    {
+        Base::Reserve(std::max(N, list.size()));
+        Base::Assign(list);
+    }
+    SmallVec(const SmallVec<T, N, TGrowth>& other) : SmallVec() { Base::operator=(other); }
+    SmallVec(SmallVec<T, N, TGrowth>&& other) noexcept : Base(std::move(other)) {}
+
+public:
+    static constexpr usize InlineCapacity() noexcept { return N; }
+    inline bool            IsInline() const noexcept { return Base::Allocator().IsInline(Base::Data()); }
+
+public:
+    using Base::operator=;
+    inline SmallVec<T, N, TGrowth>& operator=(const SmallVec<T, N, TGrowth>& other)
+    {
+        Base::operator=(other);
+        return *this;
+    }
+    inline SmallVec<T, N, TGrowth>& operator=(SmallVec<T, N, TGrowth>&& other) noexcept
+    {
+        Base::operator=(std::move(other));
+        return *this;
+    }
+};
+
+#if defined(__linux__)
+// Vec<T> over MappedAllocator, for datasets large enough that growing by copy would double peak memory.
+template <typename T, typename TGrowth = GrowthDouble>
+using MappedVec = Vec<T, MappedAllocator, TGrowth>;
+#endif
+
+// What InlineVec does when an insertion would exceed its fixed capacity.
+enum class OverflowPolicy
+{
+    Throw,
+    Assert,
+    ReturnFalse
+};
+
+// Fixed-capacity sibling of Vec<T> that keeps its elements in place and never allocates. Everything is constexpr, so
+// it can be filled and queried at compile time as well as live on the stack in allocation-free hot paths. Slots past
+// Size() hold value-initialized T, so T has to be default constructible.
+template <typename T, usize N, OverflowPolicy Policy = OverflowPolicy::Throw>
+class InlineVec
+{
+    static_assert(N > 0, "InlineVec needs a capacity of at least one element.");
+
+private:
+    T     m_Buffer[N]{};
+    usize m_Size = 0;
+
+public:
+    constexpr InlineVec() = default;
+    constexpr InlineVec(const std::initializer_list<T> list)
+    {
+        for (const auto& e : list)
+            if (!Push(e))
+                break;
+    }
+
+public:
+    constexpr usize        Size() const noexcept { return m_Size; }
+    static constexpr usize Capacity() noexcept { return N; }
+    constexpr bool         Empty() const noexcept { return m_Size == 0; }
+    constexpr bool         Full() const noexcept { return m_Size == N; }
+    constexpr T*           Data() noexcept { return m_Buffer; }
+    constexpr const T*     Data() const noexcept { return m_Buffer; }
+
+public:
+    constexpr T*       begin() noexcept { return m_Buffer; }
+    constexpr T*       end() noexcept { return m_Buffer + m_Size; }
+    constexpr const T* begin() const noexcept { return m_Buffer; }
+    constexpr const T* end() const noexcept { return m_Buffer + m_Size; }
+
+private:
+    // Returns false for ReturnFalse (and for Assert with NDEBUG), otherwise does not return. A throw reached during
+    // constant evaluation turns an overflowing compile-time table into a compile error.
+    constexpr bool Overflow() const
+    {
+        if constexpr (Policy == OverflowPolicy::Throw)
+            throw std::length_error("InlineVec capacity exceeded.");
+        else if constexpr (Policy == OverflowPolicy::Assert)
+            assert(false && "InlineVec capacity exceeded.");
+        return false;
+    }
+
+public:
+    constexpr bool Push(const T& e)
+    {
+        if (m_Size >= N)
+            return Overflow();
+        m_Buffer[m_Size++] = e;
+        return true;
+    }
+    constexpr bool Push(T&& e)
+    {
+        if (m_Size >= N)
+            return Overflow();
+        m_Buffer[m_Size++] = std::move(e);
+        return true;
+    }
+    template <typename... TArgs>
+    constexpr bool EmplaceBack(TArgs&&... args)
+    {
+        if (m_Size >= N)
+            return Overflow();
+        m_Buffer[m_Size++] = T(std::forward<TArgs>(args)...);
+        return true;
+    }
+    constexpr T Pop()
+    {
+        if (m_Size > 0)
+        {
+            T value           = std::move(m_Buffer[--m_Size]);
+            m_Buffer[m_Size] = T();
+            return value;
+        }
+        else
+            throw std::out_of_range("Tried calling Pop() on an empty vector.");
+    }
+    constexpr T& Front()
+    {
+        if (m_Size > 0)
+            return m_Buffer[0];
+        else
+            throw std::out_of_range("Tried calling Front() on an empty vector.");
+    }
+    constexpr const T& Front() const
+    {
+        if (m_Size > 0)
+            return m_Buffer[0];
+        else
+            throw std::out_of_range("Tried calling Front() on an empty vector.");
+    }
+    constexpr T& Back()
+    {
+        if (m_Size > 0)
+            return m_Buffer[m_Size - 1];
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    constexpr const T& Back() const
+    {
+        if (m_Size > 0)
+            return m_Buffer[m_Size - 1];
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    constexpr T& At(const usize index)
+    {
+        if (index < m_Size)
+            return m_Buffer[index];
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    constexpr const T& At(const usize index) const
+    {
+        if (index < m_Size)
+            return m_Buffer[index];
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    constexpr bool Insert(const T* pos, const T& value)
+    {
+        if (m_Size >= N)
+            return Overflow();
+
+        // Appending first and rotating into place keeps this correct when value is one of our own elements.
+        const usize index = pos - m_Buffer;
+        m_Buffer[m_Size]  = value;
+        std::rotate(m_Buffer + index, m_Buffer + m_Size, m_Buffer + m_Size + 1);
+        ++m_Size;
+        return true;
+    }
+    constexpr bool Insert(const T* pos, const T* first, const T* last)
+    {
+        const usize count = last - first;
+        if (m_Size + count > N)
+            return Overflow();
+
+        const usize index = pos - m_Buffer;
+        std::copy(first, last, m_Buffer + m_Size);
+        std::rotate(m_Buffer + index, m_Buffer + m_Size, m_Buffer + m_Size + count);
+        m_Size += count;
+        return true;
+    }
+    constexpr void Erase(const T* pos)
+    {
+        if (!Empty())
+            Erase(pos, pos + 1);
+        else
+            throw std::out_of_range("Tried calling Erase() on an empty vector.");
+    }
+    constexpr void Erase(const T* first, const T* last)
+    {
+        const usize index = first - m_Buffer;
+        const usize count = last - first;
+        std::move(m_Buffer + index + count, m_Buffer + m_Size, m_Buffer + index);
+        std::fill(m_Buffer + m_Size - count, m_Buffer + m_Size, T());
+        m_Size -= count;
+    }
+    constexpr bool Resize(const usize newSize)
+    {
+        if (newSize > N)
+            return Overflow();
+        if (newSize < m_Size)
+            std::fill(m_Buffer + newSize, m_Buffer + m_Size, T());
+        m_Size = newSize;
+        return true;
+    }
+    constexpr void Clear() noexcept
+    {
+        std::fill(m_Buffer, m_Buffer + m_Size, T());
+        m_Size = 0;
+    }
+
+public:
+    constexpr T&       operator[](const usize index) noexcept { return m_Buffer[index]; }
+    constexpr const T& operator[](const usize index) const noexcept { return m_Buffer[index]; }
+
+public:
+    friend std::ostream& operator<<(std::ostream& stream, const InlineVec<T, N, Policy>& other)
+    {
+        stream << "[ ";
+        for (usize i = 0; i < other.m_Size; ++i)
+        {
+            if (i + 1 != other.m_Size)
+                stream << other.m_Buffer[i] << ", ";
+            else
+                stream << other.m_Buffer[i];
+        }
+        stream << " ]";
+        return stream;
+    }
+};
+
+template <typename TAlloc, typename TGrowth>
+class Vec<bool, TAlloc, TGrowth>
+{
+    // Based on std::bitset. Bits are packed LSB-first into 64-bit words: bit i lives in word i / 64 at position i % 64.
+    // Bits past Size() in the last word are always 0, so whole-word operations such as Count() need no tail masking.
+
+    using BufferType              = u64;
+    static constexpr auto BitSize = sizeof(BufferType) * 8;
+
+    static constexpr BufferType BitMask(const usize index) noexcept { return BufferType(1) << (index % BitSize); }
+    static constexpr bool TestBit(const BufferType* words, const usize index) noexcept
+    {
+        return (words[index / BitSize] & BitMask(index)) != 0;
+    }
+
+private:
+    BufferType*                  m_Buffer     = nullptr;
+    usize                        m_Size       = 0;
+    usize                        m_Capacity   = 0;
+    u64                          m_Generation = 0;
+    [[no_unique_address]] TAlloc m_Alloc;
+
+public:
+    class BitRef
+    {
+    private:
+        BufferType* m_Ptr        = nullptr;
+        usize       m_Index      = 0;
+        u64*        m_Generation = nullptr;
+
+    public:
+        BitRef(BufferType* ptr, const usize index, u64* generation = nullptr)
+            : m_Ptr(ptr), m_Index(index), m_Generation(generation)
+        {
+        }
+
+    public:
+        constexpr operator bool() const noexcept { return TestBit(m_Ptr, m_Index); }
+        inline BitRef& operator=(const bool value) noexcept
+        {
+            if (m_Generation)
+                ++*m_Generation;
+            if (value)
+                m_Ptr[m_Index / BitSize] |= BitMask(m_Index);
+            else
+                m_Ptr[m_Index / BitSize] &= ~BitMask(m_Index);
+            return *this;
+        }
+        inline BitRef& operator=(const BitRef& value) noexcept { return this->operator=(value.operator bool()); }
+        constexpr bool operator~() const noexcept
+        {
+            return !TestBit(m_Ptr, m_Index);
+        }
+        constexpr bool operator&(const bool value) const noexcept
+        {
+            return (bool)((u8)value & (u8)this->operator bool());
+        }
+        inline BitRef& operator&=(const bool value) noexcept
+        {
+            this->operator=(this->operator&(value));
+            return *this;
+        }
+        constexpr bool operator|(const bool value) const noexcept
+        {
+            return (bool)((u8)this->operator bool() | (u8)value);
+        }
+        inline BitRef& operator|=(const bool value) noexcept
+        {
+            this->operator=(this->operator|(value));
+            return *this;
+        }
+        constexpr bool operator^(const bool value) const noexcept
+        {
+            return (bool)((u8)this->operator bool() ^ (u8)value);
+        }
+        inline BitRef& operator^=(const bool value) noexcept
+        {
+            this->operator=(this->operator^(value));
+            return *this;
+        }
+        inline BitRef& Flip() noexcept
+        {
+            this->operator=(!*this);
+            return *this;
+        }
+
+    public:
+        friend void swap(BitRef lhv, BitRef rhv) noexcept
+        {
+            const bool temp = lhv;
+            lhv             = rhv.operator bool();
+            rhv             = temp;
+        }
+        friend std::ostream& operator<<(std::ostream& stream, const BitRef& ref)
+        {
+            stream << ref.operator bool();
+            return stream;
+        }
+    };
+    class ConstIterator;
+    class Iterator
+    {
+        friend class ConstIterator;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = bool;
+        using pointer           = void;
+        using reference         = BitRef;
+
+    private:
+        BufferType* m_Ptr        = nullptr;
+        usize       m_Index      = 0;
+        u64*        m_Generation = nullptr;
+
+    public:
+        Iterator() = default;
+        Iterator(BufferType* ptr, const usize index, u64* generation = nullptr) noexcept
+            : m_Ptr(ptr), m_Index(index), m_Generation(generation)
+        {
+        }
+
+    public:
+        inline reference operator*() const noexcept { return BitRef(m_Ptr, m_Index, m_Generation); }
+        inline reference operator[](const difference_type index) const noexcept
+        {
+            return BitRef(m_Ptr, m_Index + index, m_Generation);
+        }
+        inline Iterator& operator++() noexcept
+        {
+            ++m_Index;
+            return *this;
+        }
+        inline Iterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+        inline Iterator& operator--() noexcept
+        {
+            --m_Index;
+            return *this;
+        }
+        inline Iterator operator--(const i32) noexcept
+        {
+            auto t = *this;
+            --(*this);
+            return t;
+        }
+        inline Iterator& operator+=(const difference_type disp) noexcept
+        {
+            m_Index += disp;
+            return *this;
+        }
+        inline Iterator& operator-=(const difference_type disp) noexcept
+        {
+            m_Index -= disp;
+            return *this;
+        }
+        constexpr difference_type operator-(const Iterator& other) const noexcept
+        {
+            return static_cast<difference_type>(m_Index - other.m_Index);
+        }
+        inline Iterator operator+(const difference_type disp) const noexcept
+        {
+            Iterator temp = *this;
+            temp.m_Index += disp;
+            return temp;
+        };
+        inline Iterator operator-(const difference_type disp) const noexcept
+        {
+            Iterator temp = *this;
+            temp.m_Index -= disp;
+            return temp;
+        }
+
+    public:
+        friend Iterator operator+(const difference_type disp, const Iterator& it) noexcept { return it + disp; }
+        friend bool operator==(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Index == rhv.m_Index; }
+        friend auto operator<=>(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Index <=> rhv.m_Index; }
+    };
+    class ConstIterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = bool;
+        using pointer           = void;
+        using reference         = bool;
+
+    private:
+        const BufferType* m_Ptr   = nullptr;
+        usize             m_Index = 0;
+
+    public:
+        ConstIterator() = default;
+        ConstIterator(const BufferType* ptr, const usize index) noexcept : m_Ptr(ptr), m_Index(index) {}
+        ConstIterator(Iterator it) noexcept : m_Ptr(it.m_Ptr), m_Index(it.m_Index) {}
+
+    public:
+        constexpr reference operator*() const noexcept { return TestBit(m_Ptr, m_Index); }
+        constexpr reference operator[](const difference_type index) const noexcept
+        {
+            return TestBit(m_Ptr, m_Index + index);
+        }
+        inline ConstIterator& operator++() noexcept
+        {
+            ++m_Index;
+            return *this;
+        }
+        inline ConstIterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+        inline ConstIterator& operator--() noexcept
+        {
+            --m_Index;
+            return *this;
+        }
+        inline ConstIterator operator--(const i32) noexcept
+        {
+            auto t = *this;
+            --(*this);
+            return t;
+        }
+        inline ConstIterator& operator+=(const difference_type disp) noexcept
+        {
+            m_Index += disp;
+            return *this;
+        }
+        inline ConstIterator& operator-=(const difference_type disp) noexcept
+        {
+            m_Index -= disp;
+            return *this;
+        }
+        constexpr difference_type operator-(const ConstIterator& other) const noexcept
+        {
+            return static_cast<difference_type>(m_Index - other.m_Index);
+        }
+        inline ConstIterator operator+(const difference_type disp) const noexcept
+        {
+            auto temp = *this;
+            temp.m_Index += disp;
+            return temp;
+        };
+        inline ConstIterator operator-(const difference_type disp) const noexcept
+        {
+            auto temp = *this;
+            temp.m_Index -= disp;
+            return temp;
+        }
+
+    public:
+        friend ConstIterator operator+(const difference_type disp, const ConstIterator& it) noexcept
+        {
+            return it + disp;
+        }
+        friend bool operator==(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+        {
+            return lhv.m_Index == rhv.m_Index;
+        }
+        friend auto operator<=>(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+        {
+            return lhv.m_Index <=> rhv.m_Index;
+        }
+    };
+    // Visits the indices of the set bits in increasing order, one count-trailing-zeros per set bit.
+    class SetBitIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = usize;
+        using pointer           = void;
+        using reference         = usize;
+
+    private:
+        const BufferType* m_Words     = nullptr;
+        usize             m_WordCount = 0;
+        usize             m_Word      = 0;
+        BufferType        m_Bits      = 0;
+
+    public:
+        SetBitIterator() = default;
+        SetBitIterator(const BufferType* words, const usize wordCount, const usize word) noexcept
+            : m_Words(words), m_WordCount(wordCount), m_Word(word)
+        {
+            if (m_Word < m_WordCount)
+            {
+                m_Bits = m_Words[m_Word];
+                SkipEmptyWords();
+            }
+        }
+
+    public:
+        constexpr reference operator*() const noexcept
+        {
+            return m_Word * BitSize + static_cast<usize>(std::countr_zero(m_Bits));
+        }
+        inline SetBitIterator& operator++() noexcept
+        {
+            m_Bits &= m_Bits - 1;
+            SkipEmptyWords();
+            return *this;
+        }
+        inline SetBitIterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+
+    public:
+        friend bool operator==(const SetBitIterator& lhv, const SetBitIterator& rhv) noexcept
+        {
+            return lhv.m_Word == rhv.m_Word && lhv.m_Bits == rhv.m_Bits;
+        }
+
+    private:
+        constexpr void SkipEmptyWords() noexcept
+        {
+            while (m_Bits == 0 && ++m_Word < m_WordCount)
+                m_Bits = m_Words[m_Word];
+        }
+    };
+    class SetBitRange
+    {
+    private:
+        const BufferType* m_Words     = nullptr;
+        usize             m_WordCount = 0;
+
+    public:
+        SetBitRange(const BufferType* words, const usize wordCount) noexcept : m_Words(words), m_WordCount(wordCount) {}
+
+    public:
+        inline SetBitIterator begin() const noexcept { return SetBitIterator(m_Words, m_WordCount, 0); }
+        inline SetBitIterator end() const noexcept { return SetBitIterator(m_Words, m_WordCount, m_WordCount); }
+    };
+
+public:
+    // Returned by the Find* functions when there is no matching bit.
+    static constexpr usize NPos = std::numeric_limits<usize>::max();
+
+public:
+    Vec() = default;
+    explicit Vec(const TAlloc& alloc) noexcept : m_Alloc(alloc) {}
+    explicit Vec(const usize size, const TAlloc& alloc = TAlloc())
+        : m_Size(size), m_Capacity(GrowCapacity(WordCount(size))), m_Alloc(alloc)
+    {
+        m_Buffer = Allocate(m_Capacity);
+    }
+    Vec(const std::initializer_list<bool> list, const TAlloc& alloc = TAlloc()) : m_Alloc(alloc)
+    {
+        m_Size     = list.size();
+        m_Capacity = GrowCapacity(WordCount(m_Size));
+        m_Buffer   = Allocate(m_Capacity);
+
+        usize i = 0;
+        for (const auto& e : list)
+        {
+            BitInsert(e, i);
+            ++i;
+        }
+    }
+    Vec(const Vec<bool, TAlloc, TGrowth>& other) : m_Alloc(other.m_Alloc)
+    {
+        if (&other == this)
+            return;
+
+        if (other.m_Buffer)
+        {
+            m_Size     = other.m_Size;
+            m_Capacity = other.m_Capacity;
+            m_Buffer   = Allocate(m_Capacity);
+            std::memcpy(m_Buffer, other.m_Buffer, WordCount(m_Size) * sizeof(BufferType));
+        }
+    }
+    Vec(Vec<bool, TAlloc, TGrowth>&& other) noexcept : m_Alloc(other.m_Alloc)
+    {
+        if (&other == this)
+            return;
+
+        if (other.m_Buffer && other.m_Size)
+        {
+            std::swap(m_Size, other.m_Size);
+            std::swap(m_Capacity, other.m_Capacity);
+            std::swap(m_Buffer, other.m_Buffer);
+            ++other.m_Generation;
+        }
+    }
+    ~Vec() { Drop(); }
+
+public:
+    constexpr usize       Size() const noexcept { return m_Size; }
+    constexpr usize       Capacity() const noexcept { return m_Capacity * BitSize; }
+    constexpr bool        Empty() const noexcept { return m_Size == 0; }
+    // Writing through Data() has to be followed by MarkModified().
+    constexpr BufferType* Data() const noexcept { return m_Buffer; }
+    constexpr const TAlloc& Allocator() const noexcept { return m_Alloc; }
+    // Bumped by everything that changes the bits, including assignments through the BitRef proxies that non-const
+    // operator[] and iterators hand out; reading through them leaves it alone. Derived structures such as RankSelect
+    // compare it to decide whether they are stale. Writes through Data() go unnoticed: code that writes through it
+    // has to call MarkModified() itself.
+    constexpr u64  Generation() const noexcept { return m_Generation; }
+    constexpr void MarkModified() noexcept { ++m_Generation; }
+
+public:
+    inline Iterator begin() noexcept { return Iterator(m_Buffer, 0, &m_Generation); }
+    inline Iterator end() noexcept { return Iterator(m_Buffer, m_Size, &m_Generation); }
+    inline ConstIterator begin() const noexcept { return ConstIterator(m_Buffer, 0); }
+    inline ConstIterator end() const noexcept { return ConstIterator(m_Buffer, m_Size); }
+    inline ConstIterator cbegin() const noexcept { return ConstIterator(m_Buffer, 0); }
+    inline ConstIterator cend() const noexcept { return ConstIterator(m_Buffer, m_Size); }
+    // for (const usize i : vec.SetBits()) visits only the set bits.
+    inline SetBitRange SetBits() const noexcept { return SetBitRange(m_Buffer, WordCount(m_Size)); }
+
+private:
+    constexpr void BitInsert(const bool e, const usize index) noexcept
+    {
+        if (e)
+            m_Buffer[index / BitSize] |= BitMask(index);
+    }
+    constexpr bool BitAt(const usize index) const noexcept { return TestBit(m_Buffer, index); }
+    static constexpr usize WordCount(const usize bits) noexcept { return (bits + BitSize - 1) / BitSize; }
+    // Bits of the last word that are in use, all ones when the size is a multiple of the word size.
+    static constexpr BufferType TailMask(const usize bits) noexcept
+    {
+        return (bits % BitSize) ? BitMask(bits) - 1 : ~BufferType(0);
+    }
+    constexpr void ClearTail() noexcept
+    {
+        if (m_Size % BitSize)
+            m_Buffer[m_Size / BitSize] &= TailMask(m_Size);
+    }
+    constexpr usize        GrowCapacity(const usize requiredWords) const noexcept
+    {
+        return std::max(requiredWords, TGrowth::Grow(requiredWords, sizeof(BufferType)));
+    }
+    void Realloc(const usize newSize)
+    {
+        ++m_Generation;
+        const usize words = WordCount(newSize);
+        if (newSize < m_Size)
+        {
+            // Keep the bits past the end zeroed so that growing again reads them back as 0.
+            std::memset(m_Buffer + words, 0, (WordCount(m_Size) - words) * sizeof(BufferType));
+            m_Size = newSize;
+            ClearTail();
+            if constexpr (TGrowth::ShrinkDivisor > 0)
+            {
+                if (words > 0 && words < m_Capacity / TGrowth::ShrinkDivisor)
+                    SetCapacity(GrowCapacity(words));
+            }
+        }
+        else
+        {
+            if (words > m_Capacity)
+                SetCapacity(GrowCapacity(words));
+            m_Size = newSize;
+        }
+    }
+    void SetCapacity(const usize newCapacity)
+    {
+        BufferType* temp = m_Buffer;
+        m_Buffer         = Allocate(newCapacity);
+        if (temp)
+        {
+            std::memcpy(m_Buffer, temp, std::min(m_Capacity, newCapacity) * sizeof(BufferType));
+            Deallocate(temp, m_Capacity);
+        }
+        m_Capacity = newCapacity;
+    }
+    // Words handed out by Allocate() are always zeroed, the bit-level code relies on untouched bits reading as 0.
+    inline BufferType* Allocate(const usize count)
+    {
+        if (count == 0)
+            return nullptr;
+
+        BufferType* ptr = static_cast<BufferType*>(m_Alloc.Allocate(count * sizeof(BufferType), alignof(BufferType)));
+        std::memset(ptr, 0, count * sizeof(BufferType));
+        return ptr;
+    }
+    inline void Deallocate(BufferType* ptr, const usize count) noexcept
+    {
+        if (ptr)
+            m_Alloc.Deallocate(ptr, count * sizeof(BufferType), alignof(BufferType));
+    }
+    inline void Drop() noexcept
+    {
+        Deallocate(m_Buffer, m_Capacity);
+        m_Buffer   = nullptr;
+        m_Size     = 0;
+        m_Capacity = 0;
+    }
+
+public:
+    inline BitRef operator[](const usize index) noexcept { return BitRef(m_Buffer, index, &m_Generation); }
+    inline bool   operator[](const usize index) const noexcept { return TestBit(m_Buffer, index); }
+    inline Vec<bool, TAlloc, TGrowth>&   operator=(const Vec<bool, TAlloc, TGrowth>& other) noexcept
+    {
+        if (&other == this)
+            return *this;
+
+        if (m_Buffer)
+            Drop();
+
+        ++m_Generation;
+        m_Size     = other.m_Size;
+        m_Capacity = other.m_Capacity;
+        m_Buffer   = Allocate(m_Capacity);
+        if (other.m_Buffer)
+            std::memcpy(m_Buffer, other.m_Buffer, WordCount(m_Size) * sizeof(BufferType));
+
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth>& operator=(Vec<bool, TAlloc, TGrowth>&& other) noexcept
+    {
+        if (&other == this)
+            return *this;
+
+        if (m_Buffer)
+            Drop();
+
+        m_Alloc = other.m_Alloc;
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Buffer, other.m_Buffer);
+        ++m_Generation;
+        ++other.m_Generation;
+        return *this;
+    }
+    // Bitwise operators keep the left-hand side's size. Bits missing from a shorter right-hand side read as 0.
+    inline Vec<bool, TAlloc, TGrowth>& operator&=(const Vec<bool, TAlloc, TGrowth>& other) noexcept
+    {
+        ++m_Generation;
+        CombineInto<simd::BitOp::And>(other, m_Buffer);
+        ClearTail();
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth> operator&(const Vec<bool, TAlloc, TGrowth>& other) const
+    {
+        Vec<bool, TAlloc, TGrowth> result;
+        AndInto(other, result);
+        return result;
+    }
+    inline Vec<bool, TAlloc, TGrowth>& operator|=(const Vec<bool, TAlloc, TGrowth>& other) noexcept
+    {
+        ++m_Generation;
+        CombineInto<simd::BitOp::Or>(other, m_Buffer);
+        ClearTail();
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth> operator|(const Vec<bool, TAlloc, TGrowth>& other) const
+    {
+        Vec<bool, TAlloc, TGrowth> result;
+        OrInto(other, result);
+        return result;
+    }
+    inline Vec<bool, TAlloc, TGrowth>& operator^=(const Vec<bool, TAlloc, TGrowth>& other) noexcept
+    {
+        ++m_Generation;
+        CombineInto<simd::BitOp::Xor>(other, m_Buffer);
+        ClearTail();
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth> operator^(const Vec<bool, TAlloc, TGrowth>& other) const
+    {
+        Vec<bool, TAlloc, TGrowth> result;
+        XorInto(other, result);
+        return result;
+    }
+    // Shifts move bits toward index 0 (<<) or away from it (>>), in the order ToString() prints them. Vacated bits
+    // become 0 and bits shifted past either end are dropped; the size never changes.
+    inline Vec<bool, TAlloc, TGrowth>& operator<<=(const usize pos) noexcept
+    {
+        ShiftTowardFront(pos);
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth>& operator>>=(const usize pos) noexcept
+    {
+        ShiftTowardBack(pos);
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth> operator<<(const usize pos) const
+    {
+        auto copy = *this;
+        copy.ShiftTowardFront(pos);
+        return copy;
+    }
+    inline Vec<bool, TAlloc, TGrowth> operator>>(const usize pos) const
+    {
+        auto copy = *this;
+        copy.ShiftTowardBack(pos);
+        return copy;
+    }
+    inline Vec<bool, TAlloc, TGrowth>& operator<<(const Vec<bool, TAlloc, TGrowth>& other)
+    {
+        if (&other == this)
+            return *this;
+
+        Append(other);
+        return *this;
+    }
+    inline Vec<bool, TAlloc, TGrowth> operator~() const
+    {
+        Vec<bool, TAlloc, TGrowth> result(m_Size, m_Alloc);
+        simd::Bitwise<simd::BitOp::Not>(result.m_Buffer, m_Buffer, nullptr, WordCount(m_Size));
+        result.ClearTail();
+        return result;
+    }
+
+public:
+    // Fused forms: out = *this op other, reusing out's buffer. out may be *this or other.
+    inline void AndInto(const Vec<bool, TAlloc, TGrowth>& other, Vec<bool, TAlloc, TGrowth>& out) const
+    {
+        CombineIntoVec<simd::BitOp::And>(other, out);
+    }
+    inline void OrInto(const Vec<bool, TAlloc, TGrowth>& other, Vec<bool, TAlloc, TGrowth>& out) const
+    {
+        CombineIntoVec<simd::BitOp::Or>(other, out);
+    }
+    inline void XorInto(const Vec<bool, TAlloc, TGrowth>& other, Vec<bool, TAlloc, TGrowth>& out) const
+    {
+        CombineIntoVec<simd::BitOp::Xor>(other, out);
+    }
+    inline void AndNotInto(const Vec<bool, TAlloc, TGrowth>& other, Vec<bool, TAlloc, TGrowth>& out) const
+    {
+        CombineIntoVec<simd::BitOp::AndNot>(other, out);
+    }
+    // *this & ~other
+    inline Vec<bool, TAlloc, TGrowth> AndNot(const Vec<bool, TAlloc, TGrowth>& other) const
+    {
+        Vec<bool, TAlloc, TGrowth> result;
+        AndNotInto(other, result);
+        return result;
+    }
+    inline Vec<bool, TAlloc, TGrowth>& AndNotAssign(const Vec<bool, TAlloc, TGrowth>& other) noexcept
+    {
+        ++m_Generation;
+        CombineInto<simd::BitOp::AndNot>(other, m_Buffer);
+        return *this;
+    }
+    // (*this & other).Count() without building the intersection.
+    inline usize AndCount(const Vec<bool, TAlloc, TGrowth>& other) const noexcept
+    {
+        return simd::AndCount(m_Buffer, other.m_Buffer, std::min(WordCount(m_Size), WordCount(other.m_Size)));
+    }
+
+private:
+    // Writes the first WordCount(m_Size) words of *this op other to out, which may be m_Buffer. The bits of out past
+    // m_Size are left for the caller to clear.
+    template <simd::BitOp Op>
+    void CombineInto(const Vec<bool, TAlloc, TGrowth>& other, BufferType* out) const noexcept
+    {
+        const usize words  = WordCount(m_Size);
+        const usize common = std::min(words, WordCount(other.m_Size));
+        simd::Bitwise<Op>(out, m_Buffer, other.m_Buffer, common);
+        if (words == common)
+            return;
+
+        // Past the end of other: AND gives 0, OR/XOR/ANDNOT keep this vector's bits.
+        if constexpr (Op == simd::BitOp::And)
+            std::memset(out + common, 0, (words - common) * sizeof(BufferType));
+        else if (out != m_Buffer)
+            std::memcpy(out + common, m_Buffer + common, (words - common) * sizeof(BufferType));
+    }
+    template <simd::BitOp Op>
+    void CombineIntoVec(const Vec<bool, TAlloc, TGrowth>& other, Vec<bool, TAlloc, TGrowth>& out) const
+    {
+        // Resizing first is what makes out == other safe: words other gains read as 0, words it loses are not needed.
+        out.Resize(m_Size);
+        CombineInto<Op>(other, out.m_Buffer);
+        out.ClearTail();
+    }
+    // Bit i + pos moves to i. In LSB-first words that is a right shift: whole words move down with one memmove, then
+    // a single funnel-shift pass moves the remaining pos % 64 bits across word boundaries.
+    void ShiftTowardFront(const usize pos) noexcept
+    {
+        ++m_Generation;
+        if (pos >= m_Size)
+            return Reset();
+
+        const usize words     = WordCount(m_Size);
+        const usize wordShift = pos / BitSize;
+        const usize bitShift  = pos % BitSize;
+        if (wordShift > 0)
+        {
+            std::memmove(m_Buffer, m_Buffer + wordShift, (words - wordShift) * sizeof(BufferType));
+            std::memset(m_Buffer + words - wordShift, 0, wordShift * sizeof(BufferType));
+        }
+        if (bitShift > 0)
+        {
+            const usize live = words - wordShift;
+            for (usize i = 0; i + 1 < live; ++i)
+                m_Buffer[i] = (m_Buffer[i] >> bitShift) | (m_Buffer[i + 1] << (BitSize - bitShift));
+            m_Buffer[live - 1] >>= bitShift;
+        }
+    }
+    // Bit i moves to i + pos, the mirror image of ShiftTowardFront().
+    void ShiftTowardBack(const usize pos) noexcept
+    {
+        ++m_Generation;
+        if (pos >= m_Size)
+            return Reset();
+
+        const usize words     = WordCount(m_Size);
+        const usize wordShift = pos / BitSize;
+        const usize bitShift  = pos % BitSize;
+        if (wordShift > 0)
+        {
+            std::memmove(m_Buffer + wordShift, m_Buffer, (words - wordShift) * sizeof(BufferType));
+            std::memset(m_Buffer, 0, wordShift * sizeof(BufferType));
+        }
+        if (bitShift > 0)
+        {
+            for (usize i = words - 1; i > wordShift; --i)
+                m_Buffer[i] = (m_Buffer[i] << bitShift) | (m_Buffer[i - 1] >> (BitSize - bitShift));
+            m_Buffer[wordShift] <<= bitShift;
+        }
+        ClearTail();
+    }
+
+public:
+    void Push(const bool e)
+    {
+        ++m_Generation;
+        if (m_Size >= m_Capacity * BitSize)
+        {
+            Realloc(m_Size + 1);
+            BitInsert(e, m_Size - 1);
+        }
+        else
+            BitInsert(e, m_Size++);
+    }
+    inline bool Pop()
+    {
+        if (m_Size > 0)
+        {
+            const bool value = BitAt(m_Size - 1);
+            Realloc(m_Size - 1);
+            return value;
+        }
+        else
+            throw std::out_of_range("Tried calling Pop() on an empty vector.");
+    }
+    inline BitRef Front()
+    {
+        if (m_Size > 0)
+            return this->operator[](0);
+        else
+            throw std::out_of_range("Tried calling Front() on an empty vector.");
+    }
+    inline bool Front() const
+    {
+        if (m_Size > 0)
+            return this->operator[](0);
+        else
+            throw std::out_of_range("Tried calling Front() on an empty vector.");
+    }
+    inline BitRef Back()
+    {
+        if (m_Size > 0)
+            return this->operator[](m_Size - 1);
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    inline bool Back() const
+    {
+        if (m_Size > 0)
+            return this->operator[](m_Size - 1);
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    inline BitRef At(const usize index)
+    {
+        if (index < m_Size)
+            return this->operator[](index);
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    inline bool At(const usize index) const
+    {
+        if (index < m_Size)
+            return this->operator[](index);
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    constexpr void Swap(Vec<bool, TAlloc, TGrowth>& other)
+    {
+        ++m_Generation;
+        ++other.m_Generation;
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Buffer, other.m_Buffer);
+        std::swap(m_Alloc, other.m_Alloc);
+    }
+    inline void    Resize(const usize newSize) { Realloc(newSize); }
+    void Reserve(const usize newCapacity)
+    {
+        if (WordCount(newCapacity) > m_Capacity)
+            SetCapacity(WordCount(newCapacity));
+    }
+    // Bit i becomes character i, '0' or '1', a word at a time (see simd::BitsToChars).
+    inline std::string ToString() const noexcept
+    {
+        std::string str(m_Size, '0');
+        if (m_Size)
+            simd::BitsToChars(m_Buffer, m_Size, str.data());
+        return str;
+    }
+    // The inverse of ToString().
+    static Vec<bool, TAlloc, TGrowth> FromString(const std::string_view text, const TAlloc& alloc = TAlloc())
+    {
+        Vec<bool, TAlloc, TGrowth> vec(text.size(), alloc);
+        if (!simd::CharsToBits(text.data(), text.size(), vec.m_Buffer))
+            throw std::invalid_argument("Tried calling FromString() on text with characters other than '0' and '1'.");
+        return vec;
+    }
+    // Rotations move bits the same way as the shifts, but bits leaving one end come back in at the other. They run in
+    // place: while both sides of the split are longer than a small stack buffer, block swaps (Gries-Mills) put one
+    // side into its final position, then the shorter side goes through the buffer while the rest moves a word at a
+    // time.
+    void RotateLeft(usize pos)
+    {
+        if (m_Size == 0 || (pos %= m_Size) == 0)
+            return;
+
+        ++m_Generation;
+        usize first = 0, size = m_Size;
+        while (pos > RotateBufferBits && size - pos > RotateBufferBits)
+        {
+            const usize rest = size - pos;
+            if (pos <= rest)
+            {
+                SwapBits(first, first + rest, pos);
+                size = rest;
+            }
+            else
+            {
+                SwapBits(first, first + pos, rest);
+                first += rest;
+                size -= rest;
+                pos -= rest;
+            }
+        }
+        if (pos == 0 || pos == size)
+            return;
+
+        BufferType saved[RotateBufferBits / BitSize];
+        if (pos <= size - pos)
+        {
+            SaveBits(first, pos, saved);
+            MoveBits(first + pos, first, size - pos);
+            RestoreBits(first + size - pos, pos, saved);
+        }
+        else
+        {
+            SaveBits(first + pos, size - pos, saved);
+            MoveBits(first, first + size - pos, pos);
+            RestoreBits(first, size - pos, saved);
+        }
+    }
+    void RotateRight(const usize pos)
+    {
+        if (m_Size > 0)
+            RotateLeft(m_Size - pos % m_Size);
+    }
+    inline void Flip() noexcept { ModifyRange<RangeOp::Flip>(0, m_Size); }
+
+public:
+    // Range operations work on [first, last) a word at a time: the partial words at either edge are masked, the whole
+    // words in between are memset, memcpy'd or run through the word kernels.
+    void SetRange(const usize first, const usize last)
+    {
+        CheckRange(first, last, m_Size);
+        ModifyRange<RangeOp::Set>(first, last);
+    }
+    void ResetRange(const usize first, const usize last)
+    {
+        CheckRange(first, last, m_Size);
+        ModifyRange<RangeOp::Reset>(first, last);
+    }
+    void FlipRange(const usize first, const usize last)
+    {
+        CheckRange(first, last, m_Size);
+        ModifyRange<RangeOp::Flip>(first, last);
+    }
+    // Overwrites [dstFirst, dstFirst + count) with src[srcFirst, srcFirst + count). src may be this vector, also with
+    // overlapping ranges.
+    void CopyRange(const Vec<bool, TAlloc, TGrowth>& src, usize srcFirst, const usize count, usize dstFirst)
+    {
+        CheckRange(srcFirst, srcFirst + count, src.m_Size);
+        CheckRange(dstFirst, dstFirst + count, m_Size);
+        if (count == 0)
+            return;
+
+        if (&src == this && srcFirst < dstFirst + count && dstFirst < srcFirst + count)
+        {
+            Vec<bool, TAlloc, TGrowth> temp(count, m_Alloc);
+            temp.CopyRange(src, srcFirst, count, 0);
+            return CopyRange(temp, 0, count, dstFirst);
+        }
+
+        ++m_Generation;
+        for (usize remaining = count; remaining > 0;)
+        {
+            // Whole words once both sides are word aligned, which only happens if they started at the same offset.
+            if (dstFirst % BitSize == 0 && srcFirst % BitSize == 0 && remaining >= BitSize)
+            {
+                const usize words = remaining / BitSize;
+                std::memcpy(m_Buffer + dstFirst / BitSize, src.m_Buffer + srcFirst / BitSize,
+                            words * sizeof(BufferType));
+                dstFirst += words * BitSize;
+                srcFirst += words * BitSize;
+                remaining -= words * BitSize;
+                continue;
+            }
+
+            const usize      offset = dstFirst % BitSize;
+            const usize      take   = std::min(BitSize - offset, remaining);
+            const BufferType mask   = ((take == BitSize) ? ~BufferType(0) : BitMask(take) - 1) << offset;
+            BufferType&      word   = m_Buffer[dstFirst / BitSize];
+            word                    = (word & ~mask) | ((src.ReadWord(srcFirst) << offset) & mask);
+            dstFirst += take;
+            srcFirst += take;
+            remaining -= take;
+        }
+    }
+    void Append(const Vec<bool, TAlloc, TGrowth>& other)
+    {
+        const usize size  = m_Size;
+        const usize count = other.m_Size;
+        Realloc(size + count);
+        CopyRange(other, 0, count, size);
+    }
+
+private:
+    enum class RangeOp
+    {
+        Set,
+        Reset,
+        Flip
+    };
+
+    static void CheckRange(const usize first, const usize last, const usize size)
+    {
+        if (first > last || last > size)
+            throw std::out_of_range("Index out of bounds.");
+    }
+    template <RangeOp Op>
+    static constexpr void ApplyMasked(BufferType& word, const BufferType mask) noexcept
+    {
+        if constexpr (Op == RangeOp::Set)
+            word |= mask;
+        else if constexpr (Op == RangeOp::Reset)
+            word &= ~mask;
+        else
+            word ^= mask;
+    }
+    template <RangeOp Op>
+    void ModifyRange(const usize first, const usize last) noexcept
+    {
+        ++m_Generation;
+        if (first == last)
+            return;
+
+        const usize      firstWord = first / BitSize;
+        const usize      lastWord  = (last - 1) / BitSize;
+        const BufferType headMask  = ~(BitMask(first) - 1);
+        const BufferType tailMask  = TailMask(last);
+        if (firstWord == lastWord)
+            return ApplyMasked<Op>(m_Buffer[firstWord], headMask & tailMask);
+
+        ApplyMasked<Op>(m_Buffer[firstWord], headMask);
+        BufferType* middle = m_Buffer + firstWord + 1;
+        const usize words  = lastWord - firstWord - 1;
+        if constexpr (Op == RangeOp::Set)
+            std::memset(middle, 0xFF, words * sizeof(BufferType));
+        else if constexpr (Op == RangeOp::Reset)
+            std::memset(middle, 0, words * sizeof(BufferType));
+        else
+            simd::Bitwise<simd::BitOp::Not>(middle, middle, nullptr, words);
+        ApplyMasked<Op>(m_Buffer[lastWord], tailMask);
+    }
+    static constexpr usize RotateBufferBits = 4096;
+
+    // Overwrites [pos, pos + count) with the low count bits of bits, count <= 64.
+    constexpr void WriteBits(const usize pos, BufferType bits, const usize count) noexcept
+    {
+        const usize      word   = pos / BitSize;
+        const usize      offset = pos % BitSize;
+        const BufferType mask   = (count == BitSize) ? ~BufferType(0) : BitMask(count) - 1;
+        bits &= mask;
+        m_Buffer[word] = (m_Buffer[word] & ~(mask << offset)) | (bits << offset);
+        if (offset + count > BitSize)
+        {
+            const BufferType spill = BitMask(offset + count - BitSize) - 1;
+            m_Buffer[word + 1]     = (m_Buffer[word + 1] & ~spill) | (bits >> (BitSize - offset));
+        }
+    }
+    // Moves count bits from src to dst, the ranges may overlap. The partial words at either end of the destination
+    // are masked, the words in between are written whole from one funnel-shifted read each.
+    constexpr void MoveBits(const usize src, const usize dst, const usize count) noexcept
+    {
+        const usize head = std::min(count, (BitSize - dst % BitSize) % BitSize);
+        const usize body = head + (count - head) / BitSize * BitSize;
+        if (dst < src)
+        {
+            WriteBits(dst, ReadWord(src), head);
+            for (usize done = head; done < body; done += BitSize)
+                m_Buffer[(dst + done) / BitSize] = ReadWord(src + done);
+            WriteBits(dst + body, ReadWord(src + body), count - body);
+        }
+        else
+        {
+            WriteBits(dst + body, ReadWord(src + body), count - body);
+            for (usize done = body; done > head; done -= BitSize)
+                m_Buffer[(dst + done) / BitSize - 1] = ReadWord(src + done - BitSize);
+            WriteBits(dst, ReadWord(src), head);
+        }
+    }
+    // Exchanges the disjoint ranges [lhv, lhv + count) and [rhv, rhv + count), with whole words on the lhv side.
+    constexpr void SwapBits(const usize lhv, const usize rhv, const usize count) noexcept
+    {
+        const usize head = std::min(count, (BitSize - lhv % BitSize) % BitSize);
+        const usize body = head + (count - head) / BitSize * BitSize;
+        const auto  swap = [&](const usize done, const usize take)
+        {
+            const BufferType bits = ReadWord(lhv + done);
+            WriteBits(lhv + done, ReadWord(rhv + done), take);
+            WriteBits(rhv + done, bits, take);
+        };
+        swap(0, head);
+        for (usize done = head; done < body; done += BitSize)
+        {
+            BufferType&      word = m_Buffer[(lhv + done) / BitSize];
+            const BufferType bits = word;
+            word                  = ReadWord(rhv + done);
+            WriteBits(rhv + done, bits, BitSize);
+        }
+        swap(body, count - body);
+    }
+    constexpr void SaveBits(const usize pos, const usize count, BufferType* out) const noexcept
+    {
+        for (usize done = 0; done < count; done += BitSize)
+            out[done / BitSize] = ReadWord(pos + done);
+    }
+    constexpr void RestoreBits(const usize pos, const usize count, const BufferType* bits) noexcept
+    {
+        for (usize done = 0; done < count; done += BitSize)
+            WriteBits(pos + done, bits[done / BitSize], std::min(BitSize, count - done));
+    }
+    // The 64 bits starting at pos, bits past the end of the buffer read as 0.
+    constexpr BufferType ReadWord(const usize pos) const noexcept
+    {
+        const usize word  = pos / BitSize;
+        const usize shift = pos % BitSize;
+        BufferType  bits  = m_Buffer[word] >> shift;
+        if (shift && word + 1 < WordCount(m_Size))
+            bits |= m_Buffer[word + 1] << (BitSize - shift);
+        return bits;
+    }
+
+public:
+    inline bool Any() const noexcept
+    {
+        // OR blocks of words together before branching so the scan vectorizes.
+        const usize words = WordCount(m_Size);
+        usize       i     = 0;
+        for (; i + 8 <= words; i += 8)
+        {
+            BufferType block = 0;
+            for (usize j = 0; j < 8; ++j)
+                block |= m_Buffer[i + j];
+            if (block)
+                return true;
+        }
+        for (; i < words; ++i)
+            if (m_Buffer[i])
+                return true;
+        return false;
+    }
+    inline bool All() const noexcept
+    {
+        const usize full = m_Size / BitSize;
+        for (usize i = 0; i < full; ++i)
+            if (m_Buffer[i] != ~BufferType(0))
+                return false;
+        return full == WordCount(m_Size) || m_Buffer[full] == TailMask(m_Size);
+    }
+    inline bool  None() const noexcept { return !Any(); }
+
+public:
+    // Bit searches scan whole words and use count-leading/trailing-zeros inside the word that matches. They return
+    // NPos when there is no such bit.
+    inline usize FindFirst() const noexcept { return FindFrom(0); }
+    // First set bit after pos.
+    inline usize FindNext(const usize pos) const noexcept { return (pos + 1 < m_Size) ? FindFrom(pos + 1) : NPos; }
+    inline usize FindLast() const noexcept
+    {
+        for (usize i = WordCount(m_Size); i-- > 0;)
+            if (m_Buffer[i])
+                return i * BitSize + (BitSize - 1) - static_cast<usize>(std::countl_zero(m_Buffer[i]));
+        return NPos;
+    }
+    inline usize FindFirstZero() const noexcept
+    {
+        const usize words = WordCount(m_Size);
+        for (usize i = 0; i < words; ++i)
+        {
+            if (m_Buffer[i] != ~BufferType(0))
+            {
+                // The tail bits of the last word are 0 as well, those do not count.
+                const usize index = i * BitSize + static_cast<usize>(std::countr_one(m_Buffer[i]));
+                return (index < m_Size) ? index : NPos;
+            }
+        }
+        return NPos;
+    }
+    // Calls fn(index) for every set bit, in increasing order.
+    template <typename TFn>
+    void ForEachSetBit(TFn&& fn) const
+    {
+        const usize words = WordCount(m_Size);
+        for (usize i = 0; i < words; ++i)
+        {
+            for (BufferType bits = m_Buffer[i]; bits; bits &= bits - 1)
+                fn(i * BitSize + static_cast<usize>(std::countr_zero(bits)));
+        }
+    }
+
+private:
+    // First set bit at or after pos, pos < m_Size.
+    inline usize FindFrom(const usize pos) const noexcept
+    {
+        const usize words = WordCount(m_Size);
+        usize       i     = pos / BitSize;
+        if (i >= words)
+            return NPos;
+
+        BufferType bits = m_Buffer[i] & ~(BitMask(pos) - 1);
+        while (!bits && ++i < words)
+            bits = m_Buffer[i];
+        return bits ? i * BitSize + static_cast<usize>(std::countr_zero(bits)) : NPos;
+    }
+
+public:
+    inline usize Count() const noexcept { return simd::PopCount(m_Buffer, WordCount(m_Size)); }
+    inline void  Clear() noexcept
+    {
+        Reset();
+        m_Size = 0;
+    }
+    inline void Reset() noexcept
+    {
+        ++m_Generation;
+        if (m_Buffer)
+            std::memset(m_Buffer, 0, WordCount(m_Size) * sizeof(BufferType));
+    }
+
+public:
+    friend std::ostream& operator<<(std::ostream& stream, const Vec<bool, TAlloc, TGrowth>& other) noexcept
+    {
+        // A word of bits is turned into characters at once, then spread out with separators.
+        char bits[BitSize];
+        char buffer[BitSize * 3];
+        stream << "[ ";
+        for (usize i = 0; i < other.m_Size; i += BitSize)
+        {
+            const usize count = std::min(BitSize, other.m_Size - i);
+            simd::BitsToChars(other.m_Buffer + i / BitSize, count, bits);
+            char* out = buffer;
+            for (usize j = 0; j < count; ++j, out += 3)
+            {
+                out[0] = bits[j];
+                out[1] = ',';
+                out[2] = ' ';
+            }
+            // No separator after the last bit.
+            stream.write(buffer, (out - buffer) - (i + count == other.m_Size ? 2 : 0));
+        }
+        stream << " ]";
+        return stream;
+    }
+};
+
+// Succinct rank/select directory over a Vec<bool>. Ones are counted per 4096-bit superblock (absolute, u64) and per
+// 512-bit block (relative to the superblock, u16), which is about 4.7% of the bitvector. Select keeps the superblock of
+// every 8192nd one and zero as a search hint, adding at most another 0.8%.
+//
+// Rank1(i) is a superblock and a block lookup plus at most eight word popcounts. Select1(k) binary searches the
+// superblocks between two hints, then scans at most eight blocks and eight words.
+//
+// The directory is built on first use and rebuilt lazily whenever the bitvector's Generation() has moved on, so it can
+// stay alongside a vector that is still being edited. Queries on a stale directory rebuild it, which allocates and may
+// throw, and is not safe to run concurrently with other queries. Call Build() after the last write before sharing the
+// directory between threads; queries on an up-to-date directory only read.
+template <typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+class RankSelect
+{
+private:
+    using BitVec = Vec<bool, TAlloc, TGrowth>;
+
+    static constexpr usize WordBits        = 64;
+    static constexpr usize BlockWords      = 8;
+    static constexpr usize SuperBlocks     = 8;
+    static constexpr usize BlockBits       = BlockWords * WordBits;
+    static constexpr usize SuperBits       = SuperBlocks * BlockBits;
+    static constexpr usize SelectSampleGap = 8192;
+
+private:
+    const BitVec* m_Bits = nullptr;
+    mutable u64   m_Generation = 0;
+    mutable bool  m_Built      = false;
+    // m_Super has a trailing entry holding the total number of ones.
+    mutable Vec<u64> m_Super;
+    mutable Vec<u16> m_Blocks;
+    mutable Vec<u32> m_Select1;
+    mutable Vec<u32> m_Select0;
+
+public:
+    static constexpr usize NPos = BitVec::NPos;
+
+public:
+    explicit RankSelect(const BitVec& bits) noexcept : m_Bits(&bits) {}
+
+public:
+    // Brings the directory up to date now instead of on the next query.
+    void Build() const { Refresh(); }
+
+    // Ones in [0, pos), pos <= Size().
+    usize Rank1(const usize pos) const
+    {
+        Refresh();
+        const u64*  words = m_Bits->Data();
+        const usize block = pos / BlockBits;
+        usize       rank  = m_Super[pos / SuperBits] + m_Blocks.Data()[block];
+        for (usize w = block * BlockWords; w < pos / WordBits; ++w)
+            rank += static_cast<usize>(std::popcount(words[w]));
+        if (pos % WordBits)
+            rank += static_cast<usize>(std::popcount(words[pos / WordBits] & ((u64(1) << (pos % WordBits)) - 1)));
+        return rank;
+    }
+    usize Rank0(const usize pos) const { return pos - Rank1(pos); }
+
+    // Index of the k-th one (counting from 0), or NPos if there are not that many.
+    usize Select1(const usize k) const
+    {
+        Refresh();
+        if (k >= m_Super[m_Super.Size() - 1])
+            return NPos;
+        return SelectImpl<true>(k);
+    }
+    usize Select0(const usize k) const
+    {
+        Refresh();
+        if (k >= m_Bits->Size() - m_Super[m_Super.Size() - 1])
+            return NPos;
+        return SelectImpl<false>(k);
+    }
+
+    // Bytes used by the directory itself, for judging its overhead against the bitvector.
+    usize MemoryBytes() const
+    {
+        Refresh();
+        return m_Super.Size() * sizeof(u64) + m_Blocks.Size() * sizeof(u16) +
+               (m_Select1.Size() + m_Select0.Size()) * sizeof(u32);
+    }
+
+private:
+    void Refresh() const
+    {
+        if (!m_Built || m_Generation != m_Bits->Generation())
+            Rebuild();
+    }
+    void Rebuild() const
+    {
+        const u64*  words      = m_Bits->Data();
+        const usize size       = m_Bits->Size();
+        const usize wordCount  = (size + WordBits - 1) / WordBits;
+        const usize blockCount = size / BlockBits + 1;
+        const usize superCount = size / SuperBits + 1;
+
+        m_Super.Clear();
+        m_Blocks.Clear();
+        m_Select1.Clear();
+        m_Select0.Clear();
+        m_Super.Reserve(superCount + 1);
+        m_Blocks.Reserve(blockCount);
+
+        usize total = 0, superStart = 0;
+        for (usize block = 0; block < blockCount; ++block)
+        {
+            if (block % SuperBlocks == 0)
+            {
+                m_Super.Push(total);
+                superStart = total;
+            }
+            m_Blocks.Push(static_cast<u16>(total - superStart));
+            const usize end = std::min((block + 1) * BlockWords, wordCount);
+            for (usize w = block * BlockWords; w < end; ++w)
+                total += static_cast<usize>(std::popcount(words[w]));
+        }
+        m_Super.Push(total);
+
+        // Hint j is the superblock holding the (j * SelectSampleGap)-th one, resp. zero.
+        for (usize sb = 0, nextOne = 0, nextZero = 0; sb < superCount; ++sb)
+        {
+            const usize onesAfter  = m_Super[sb + 1];
+            const usize zerosAfter = std::min((sb + 1) * SuperBits, size) - onesAfter;
+            for (; nextOne < onesAfter; nextOne += SelectSampleGap)
+                m_Select1.Push(static_cast<u32>(sb));
+            for (; nextZero < zerosAfter; nextZero += SelectSampleGap)
+                m_Select0.Push(static_cast<u32>(sb));
+        }
+
+        m_Generation = m_Bits->Generation();
+        m_Built      = true;
+    }
+
+    template <bool One>
+    usize CountBefore(const usize superBlock) const noexcept
+    {
+        return One ? m_Super[superBlock] : superBlock * SuperBits - m_Super[superBlock];
+    }
+    template <bool One>
+    usize SelectImpl(usize k) const noexcept
+    {
+        const Vec<u32>& hints = One ? m_Select1 : m_Select0;
+        const usize     hint  = k / SelectSampleGap;
+        // The answer lies in the last superblock in [lo, hi] that starts before the k-th match.
+        usize lo = hints[hint];
+        usize hi = (hint + 1 < hints.Size()) ? hints[hint + 1] : m_Super.Size() - 2;
+        while (lo < hi)
+        {
+            const usize mid = lo + (hi - lo + 1) / 2;
+            if (CountBefore<One>(mid) <= k)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        k -= CountBefore<One>(lo);
+
+        const u16*  blocks     = m_Blocks.Data();
+        const usize firstBlock = lo * SuperBlocks;
+        usize       block      = firstBlock;
+        const usize lastBlock  = std::min(firstBlock + SuperBlocks, m_Blocks.Size());
+        const auto  before     = [&](const usize b)
+        { return One ? usize{ blocks[b] } : (b - firstBlock) * BlockBits - blocks[b]; };
+        while (block + 1 < lastBlock && before(block + 1) <= k)
+            ++block;
+        k -= before(block);
+
+        const u64* words = m_Bits->Data();
+        for (usize w = block * BlockWords;; ++w)
+        {
+            const u64   word  = One ? words[w] : ~words[w];
+            const usize count = static_cast<usize>(std::popcount(word));
+            if (k < count)
+                return w * WordBits + SelectInWord(word, k);
+            k -= count;
+        }
+    }
+    // Position of the k-th set bit of word, k < popcount(word).
+    static usize SelectInWord(u64 word, usize k) noexcept
+    {
+        usize offset = 0;
+        for (usize bits = static_cast<usize>(std::popcount(word & 0xFF)); k >= bits;
+             bits       = static_cast<usize>(std::popcount(word & 0xFF)))
+        {
+            k -= bits;
+            word >>= 8;
+            offset += 8;
+        }
+        for (; k > 0; --k)
+            word &= word - 1;
+        return offset + static_cast<usize>(std::countr_zero(word));
+    }
+};
+
+// Fixed-size bitvector whose bits can be set, cleared and tested from many threads at once. Bits live in
+// std::atomic<u64> words with the same LSB-first layout as Vec<bool>, and every single-bit update is one atomic
+// read-modify-write on its word, so concurrent writers of neighbouring bits never lose each other's updates. The size
+// is fixed at construction; bulk operations are atomic per word, not as a whole.
+template <typename TAlloc = HeapAllocator>
+class AtomicBitVec
+{
+private:
+    using Word                    = std::atomic<u64>;
+    static constexpr usize BitSize = 64;
+
+private:
+    Word*                        m_Words = nullptr;
+    usize                        m_Size  = 0;
+    [[no_unique_address]] TAlloc m_Alloc;
+
+public:
+    explicit AtomicBitVec(const usize size, const TAlloc& alloc = TAlloc()) : m_Size(size), m_Alloc(alloc)
+    {
+        if (WordCount() > 0)
+        {
+            m_Words = static_cast<Word*>(m_Alloc.Allocate(WordCount() * sizeof(Word), alignof(Word)));
+            for (usize i = 0; i < WordCount(); ++i)
+                std::construct_at(m_Words + i, u64{ 0 });
+        }
+    }
+    AtomicBitVec(const AtomicBitVec&)            = delete;
+    AtomicBitVec& operator=(const AtomicBitVec&) = delete;
+    ~AtomicBitVec()
+    {
+        if (m_Words)
+        {
+            std::destroy_n(m_Words, WordCount());
+            m_Alloc.Deallocate(m_Words, WordCount() * sizeof(Word), alignof(Word));
+        }
+    }
+
+public:
+    constexpr usize Size() const noexcept { return m_Size; }
+    constexpr usize WordCount() const noexcept { return (m_Size + BitSize - 1) / BitSize; }
+
+public:
+    inline bool Test(const usize index, const std::memory_order order = std::memory_order_acquire) const noexcept
+    {
+        return (m_Words[index / BitSize].load(order) & Mask(index)) != 0;
+    }
+    // Both return the previous value of the bit, so exactly one of several racing TestAndSet() calls sees false.
+    inline bool TestAndSet(const usize index, const std::memory_order order = std::memory_order_acq_rel) noexcept
+    {
+        const u64 mask = Mask(index);
+        Word&     word = m_Words[index / BitSize];
+        // A plain load first skips the read-modify-write, and the cache line ping-pong, when the bit is already set.
+        // That load still has to give the ordering the caller asked for, since its result is what gets returned.
+        if (word.load(LoadOrder(order)) & mask)
+            return true;
+        return (word.fetch_or(mask, order) & mask) != 0;
+    }
+    inline bool TestAndReset(const usize index, const std::memory_order order = std::memory_order_acq_rel) noexcept
+    {
+        const u64 mask = Mask(index);
+        return (m_Words[index / BitSize].fetch_and(~mask, order) & mask) != 0;
+    }
+    inline void Set(const usize index, const std::memory_order order = std::memory_order_release) noexcept
+    {
+        m_Words[index / BitSize].fetch_or(Mask(index), order);
+    }
+    inline void Reset(const usize index, const std::memory_order order = std::memory_order_release) noexcept
+    {
+        m_Words[index / BitSize].fetch_and(~Mask(index), order);
+    }
+
+public:
+    // Sets [first, last) with one fetch_or per touched word. Returns how many of those bits were newly set.
+    usize SetRange(const usize first, const usize last, const std::memory_order order = std::memory_order_acq_rel)
+    {
+        if (first > last || last > m_Size)
+            throw std::out_of_range("Index out of bounds.");
+
+        usize newlySet = 0;
+        for (usize pos = first; pos < last;)
+        {
+            const usize offset = pos % BitSize;
+            const usize take   = std::min(BitSize - offset, last - pos);
+            const u64   mask   = ((take == BitSize) ? ~u64(0) : (u64(1) << take) - 1) << offset;
+            const u64   before = m_Words[pos / BitSize].fetch_or(mask, order);
+            newlySet += static_cast<usize>(std::popcount(~before & mask));
+            pos += take;
+        }
+        return newlySet;
+    }
+    // ORs every set bit of bits into this vector, one fetch_or per word. Bits past Size() are ignored.
+    template <typename TOtherAlloc, typename TGrowth>
+    usize SetBits(const Vec<bool, TOtherAlloc, TGrowth>& bits, const std::memory_order order = std::memory_order_acq_rel)
+    {
+        const usize words    = std::min(WordCount(), (bits.Size() + BitSize - 1) / BitSize);
+        const u64*  source   = bits.Data();
+        usize       newlySet = 0;
+        for (usize i = 0; i < words; ++i)
+        {
+            u64 mask = source[i];
+            if (i + 1 == WordCount() && m_Size % BitSize)
+                mask &= (u64(1) << (m_Size % BitSize)) - 1;
+            if (mask)
+                newlySet += static_cast<usize>(std::popcount(~m_Words[i].fetch_or(mask, order) & mask));
+        }
+        return newlySet;
+    }
+    usize Count(const std::memory_order order = std::memory_order_acquire) const noexcept
+    {
+        usize count = 0;
+        for (usize i = 0; i < WordCount(); ++i)
+            count += static_cast<usize>(std::popcount(m_Words[i].load(order)));
+        return count;
+    }
+    void Clear(const std::memory_order order = std::memory_order_release) noexcept
+    {
+        for (usize i = 0; i < WordCount(); ++i)
+            m_Words[i].store(0, order);
+    }
+    // Copies the current bits into a plain Vec<bool>. Each word is read atomically, the whole copy is not a snapshot.
+    Vec<bool> ToVec(const std::memory_order order = std::memory_order_acquire) const
+    {
+        Vec<bool> result(m_Size);
+        u64*      words = result.Data();
+        for (usize i = 0; i < WordCount(); ++i)
+            words[i] = m_Words[i].load(order);
+        result.MarkModified();
+        return result;
+    }
+
+private:
+    static constexpr u64 Mask(const usize index) noexcept { return u64(1) << (index % BitSize); }
+    // A load cannot take release or acq_rel, acquire covers the reading half of both.
+    static constexpr std::memory_order LoadOrder(const std::memory_order order) noexcept
+    {
+        if (order == std::memory_order_relaxed || order == std::memory_order_seq_cst)
+            return order;
+        return std::memory_order_acquire;
+    }
+};
+
+// Append-only vector that many threads can push into at once, while others read what has been committed so far.
+// Elements live in segments of 64, 128, 256, ... slots that are allocated on demand and never moved, so growing
+// never stalls the other producers and references to elements stay valid. A push reserves its slot with one
+// fetch_add, constructs the element in place and sets the slot's bit in the segment's published words.
+//
+// Size() is the committed prefix: the leading run of published slots, which is all readers may look at. Whichever
+// producer publishes the first unpublished slot moves the prefix forward over every slot published behind it. A push
+// that throws (from the element's constructor or the segment allocation) leaves its slot unpublished, and the prefix
+// stops there for good.
+// Clear() and destruction must not race with anything else.
+template <typename T, typename TAlloc = HeapAllocator>
+class ConcurrentVec
+{
+private:
+    static constexpr usize FirstShift   = 6;
+    static constexpr usize FirstSize    = usize(1) << FirstShift;
+    static constexpr usize MaxSegments  = 64 - FirstShift;
+    static constexpr usize BitSize      = 64;
+    static constexpr usize SegmentAlign = std::max(alignof(T), alignof(std::atomic<u64>));
+
+    struct Slot
+    {
+        usize m_Segment = 0;
+        usize m_Offset  = 0;
+    };
+
+private:
+    std::atomic<std::byte*>      m_Segments[MaxSegments] = {};
+    alignas(64) std::atomic<usize> m_Reserved  = 0;
+    alignas(64) std::atomic<usize> m_Committed = 0;
+    [[no_unique_address]] TAlloc m_Alloc;
+
+public:
+    ConcurrentVec() = default;
+    explicit ConcurrentVec(const TAlloc& alloc) noexcept : m_Alloc(alloc) {}
+    ConcurrentVec(const ConcurrentVec&)            = delete;
+    ConcurrentVec& operator=(const ConcurrentVec&) = delete;
+    ~ConcurrentVec()
+    {
+        Clear();
+        for (usize k = 0; k < MaxSegments; ++k)
+        {
+            if (std::byte* segment = m_Segments[k].load(std::memory_order_relaxed))
+                m_Alloc.Deallocate(segment, SegmentBytes(k), SegmentAlign);
+        }
+    }
+
+public:
+    // Committed elements, [0, Size()) may be read while other threads push.
+    inline usize Size() const noexcept { return m_Committed.load(std::memory_order_acquire); }
+    inline bool  Empty() const noexcept { return Size() == 0; }
+    // Slots handed out so far, including those still being constructed.
+    inline usize ReservedSize() const noexcept { return m_Reserved.load(std::memory_order_relaxed); }
+
+public:
+    // Element access is only valid below Size().
+    inline const T& operator[](const usize index) const noexcept
+    {
+        const Slot slot = Locate(index);
+        return Elements(m_Segments[slot.m_Segment].load(std::memory_order_relaxed), slot.m_Segment)[slot.m_Offset];
+    }
+    inline T& operator[](const usize index) noexcept
+    {
+        const Slot slot = Locate(index);
+        return Elements(m_Segments[slot.m_Segment].load(std::memory_order_relaxed), slot.m_Segment)[slot.m_Offset];
+    }
+    inline const T& At(const usize index) const
+    {
+        if (index >= Size())
+            throw std::out_of_range("Index out of bounds.");
+        return (*this)[index];
+    }
+
+public:
+    // Both return the index of the new element, which becomes visible once everything before it is committed too.
+    inline usize PushBack(const T& value) { return EmplaceBack(value); }
+    inline usize PushBack(T&& value) { return EmplaceBack(std::move(value)); }
+    template <typename... TArgs>
+    usize EmplaceBack(TArgs&&... args)
+    {
+        const usize index = m_Reserved.fetch_add(1, std::memory_order_relaxed);
+        const Slot  slot  = Locate(index);
+        std::byte*  block = SegmentFor(slot);
+        std::construct_at(Elements(block, slot.m_Segment) + slot.m_Offset, std::forward<TArgs>(args)...);
+        Published(block)[slot.m_Offset / BitSize].fetch_or(u64(1) << (slot.m_Offset % BitSize));
+        Commit(index, 1);
+        return index;
+    }
+    // Copies count elements into consecutive slots with a single reservation and one publishing fetch_or per word,
+    // which is much cheaper per element than PushBack() when producers work in batches. Returns the first index.
+    usize PushBatch(const T* data, const usize count)
+    {
+        const usize first = m_Reserved.fetch_add(count, std::memory_order_relaxed);
+        for (usize done = 0; done < count;)
+        {
+            const Slot  slot  = Locate(first + done);
+            std::byte*  block = SegmentFor(slot);
+            const usize take  = std::min(count - done, SegmentSize(slot.m_Segment) - slot.m_Offset);
+            std::uninitialized_copy_n(data + done, take, Elements(block, slot.m_Segment) + slot.m_Offset);
+            for (usize pos = slot.m_Offset; pos < slot.m_Offset + take;)
+            {
+                const usize bit  = pos % BitSize;
+                const usize bits = std::min(BitSize - bit, slot.m_Offset + take - pos);
+                const u64   mask = ((bits == BitSize) ? ~u64(0) : (u64(1) << bits) - 1) << bit;
+                Published(block)[pos / BitSize].fetch_or(mask);
+                pos += bits;
+            }
+            done += take;
+        }
+        Commit(first, count);
+        return first;
+    }
+    // Allocates the segments up to capacity slots ahead of time, so that no producer allocates below it.
+    void Reserve(const usize capacity)
+    {
+        if (capacity > 0)
+        {
+            for (usize k = 0; k <= Locate(capacity - 1).m_Segment; ++k)
+                SegmentFor(Slot{ k, 0 });
+        }
+    }
+    // Calls fn(element) for the elements committed when the call starts and returns how many that was.
+    template <typename TFn>
+    usize ForEach(TFn&& fn) const
+    {
+        const usize size = Size();
+        for (usize k = 0, start = 0; start < size; start += SegmentSize(k), ++k)
+        {
+            const T*    elements = Elements(m_Segments[k].load(std::memory_order_relaxed), k);
+            const usize count    = std::min(SegmentSize(k), size - start);
+            for (usize i = 0; i < count; ++i)
+                fn(elements[i]);
+        }
+        return size;
+    }
+    // Copies the committed prefix into a plain Vec.
+    template <typename TVecAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+    Vec<T, TVecAlloc, TGrowth> ToVec() const
+    {
+        Vec<T, TVecAlloc, TGrowth> result;
+        result.Reserve(Size());
+        ForEach([&result](const T& e) { result.Push(e); });
+        return result;
+    }
+    // Destroys every element but keeps the segments for reuse.
+    void Clear() noexcept
+    {
+        const usize reserved = m_Reserved.load(std::memory_order_acquire);
+        for (usize k = 0, start = 0; start < reserved; start += SegmentSize(k), ++k)
+        {
+            std::byte* block = m_Segments[k].load(std::memory_order_acquire);
+            if (!block)
+                continue;
+            if constexpr (!std::is_trivially_destructible_v<T>)
+            {
+                for (usize i = 0; i < SegmentSize(k); ++i)
+                    if (Published(block)[i / BitSize].load(std::memory_order_relaxed) & (u64(1) << (i % BitSize)))
+                        std::destroy_at(Elements(block, k) + i);
+            }
+            for (usize w = 0; w < SegmentSize(k) / BitSize; ++w)
+                Published(block)[w].store(0, std::memory_order_relaxed);
+        }
+        m_Reserved.store(0, std::memory_order_relaxed);
+        m_Committed.store(0, std::memory_order_release);
+    }
+
+private:
+    static constexpr usize SegmentSize(const usize k) noexcept { return FirstSize << k; }
+    static constexpr Slot  Locate(const usize index) noexcept
+    {
+        // Segment k holds indices [FirstSize * (2^k - 1), FirstSize * (2^(k + 1) - 1)).
+        const usize pos = index + FirstSize;
+        const usize k   = static_cast<usize>(std::bit_width(pos)) - 1 - FirstShift;
+        return Slot{ k, pos - SegmentSize(k) };
+    }
+    // A segment is its published words followed by its elements.
+    static constexpr usize ElementsOffset(const usize k) noexcept
+    {
+        const usize flags = SegmentSize(k) / BitSize * sizeof(std::atomic<u64>);
+        return (flags + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+    static constexpr usize SegmentBytes(const usize k) noexcept { return ElementsOffset(k) + SegmentSize(k) * sizeof(T); }
+    static inline std::atomic<u64>* Published(std::byte* block) noexcept
+    {
+        return reinterpret_cast<std::atomic<u64>*>(block);
+    }
+    static inline const std::atomic<u64>* Published(const std::byte* block) noexcept
+    {
+        return reinterpret_cast<const std::atomic<u64>*>(block);
+    }
+    static inline T* Elements(std::byte* block, const usize k) noexcept
+    {
+        return reinterpret_cast<T*>(block + ElementsOffset(k));
+    }
+    static inline const T* Elements(const std::byte* block, const usize k) noexcept
+    {
+        return reinterpret_cast<const T*>(block + ElementsOffset(k));
+    }
+    // Returns the segment of slot, allocating it if nobody has yet. The producer that takes the first slot of a
+    // segment also allocates the next one, so the other producers rarely find a segment missing. Racing allocators
+    // agree by compare-exchange, and the losers free theirs.
+    std::byte* SegmentFor(const Slot slot)
+    {
+        std::byte* block = EnsureSegment(slot.m_Segment);
+        if (slot.m_Offset == 0 && slot.m_Segment + 1 < MaxSegments)
+            EnsureSegment(slot.m_Segment + 1);
+        return block;
+    }
+    std::byte* EnsureSegment(const usize k)
+    {
+        std::byte* block = m_Segments[k].load(std::memory_order_acquire);
+        if (block)
+            return block;
+
+        std::byte* fresh = static_cast<std::byte*>(m_Alloc.Allocate(SegmentBytes(k), SegmentAlign));
+        for (usize w = 0; w < SegmentSize(k) / BitSize; ++w)
+            std::construct_at(Published(fresh) + w, u64{ 0 });
+        if (m_Segments[k].compare_exchange_strong(block, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+            return fresh;
+        m_Alloc.Deallocate(fresh, SegmentBytes(k), SegmentAlign);
+        return block;
+    }
+    // Called after publishing [first, first + count). If the prefix currently ends inside that range, this producer
+    // is the one holding it back and moves it forward; otherwise an earlier producer will, or already has.
+    //
+    // The publishing fetch_or, the load below, and the prefix's compare-exchange and bit loads in Advance() are all
+    // sequentially consistent. So either this load sees the prefix reach the range, or the producer that moved it
+    // there sees this range published when it looks again.
+    inline void Commit(const usize first, const usize count) noexcept
+    {
+        const usize committed = m_Committed.load();
+        if (committed >= first && committed < first + count)
+            Advance(committed);
+    }
+    void Advance(usize committed) noexcept
+    {
+        while (true)
+        {
+            const Slot       slot  = Locate(committed);
+            const std::byte* block = m_Segments[slot.m_Segment].load(std::memory_order_acquire);
+            if (!block)
+                return;
+            const u64   word = Published(block)[slot.m_Offset / BitSize].load() >> (slot.m_Offset % BitSize);
+            const usize run  = static_cast<usize>(std::countr_one(word));
+            if (run == 0)
+                return;
+            // Losing the race means another producer moved the prefix, continue from wherever it is now.
+            if (m_Committed.compare_exchange_weak(committed, committed + run))
+                committed += run;
+        }
+    }
+};
+
+// Roaring-style compressed bitmap over u32 values. The value space is cut into 65536-bit chunks keyed by the high
+// 16 bits, and every non-empty chunk stores its low 16 bits in whichever container is smallest: a sorted array (at
+// most 4096 values), a 1024-word bitmap, or a list of runs. Binary operations work chunk by chunk: array/array pairs
+// are merged directly, AND/ANDNOT of an array probe the other side, and everything else goes through an 8 KiB word
+// image that is then re-encoded in the best container for the result.
+class CompressedBitmap
+{
+private:
+    static constexpr usize ChunkBits  = usize{ 1 } << 16;
+    static constexpr usize ChunkWords = ChunkBits / 64;
+    static constexpr usize ArrayMax   = 4096;
+
+    enum class Kind : u8
+    {
+        Array,
+        Bitmap,
+        Runs
+    };
+    // Inclusive range of low bits.
+    struct Run
+    {
+        u16 m_First = 0;
+        u16 m_Last  = 0;
+    };
+    struct Container
+    {
+        Kind     m_Kind        = Kind::Array;
+        u32      m_Cardinality = 0;
+        Vec<u16> m_Array;
+        Vec<u64> m_Words;
+        Vec<Run> m_Runs;
+    };
+
+private:
+    Vec<u16>       m_Keys;
+    Vec<Container> m_Containers;
+
+public:
+    CompressedBitmap() = default;
+
+    template <typename TAlloc, typename TGrowth>
+    static CompressedBitmap FromVec(const Vec<bool, TAlloc, TGrowth>& bits)
+    {
+        if (bits.Size() > std::numeric_limits<u32>::max() + usize{ 1 })
+            throw std::length_error("Tried converting a bitvector with more than 2^32 bits.");
+
+        CompressedBitmap result;
+        const u64*       words     = bits.Data();
+        const usize      wordCount = (bits.Size() + 63) / 64;
+        u64              image[ChunkWords];
+        for (usize first = 0; first < wordCount; first += ChunkWords)
+        {
+            const usize count = std::min(ChunkWords, wordCount - first);
+            if (simd::PopCount(words + first, count) == 0)
+                continue;
+
+            std::memcpy(image, words + first, count * sizeof(u64));
+            std::memset(image + count, 0, (ChunkWords - count) * sizeof(u64));
+            result.m_Keys.Push(static_cast<u16>(first / ChunkWords));
+            result.m_Containers.Push(FromWords(image));
+        }
+        return result;
+    }
+    // Values >= size are dropped.
+    Vec<bool> ToVec(const usize size) const
+    {
+        Vec<bool> result(size);
+        u64*      words = result.Data();
+        ForEachSetBit(
+            [&](const u32 value)
+            {
+                if (value < size)
+                    words[value / 64] |= u64(1) << (value % 64);
+            });
+        result.MarkModified();
+        return result;
+    }
+    Vec<bool> ToVec() const { return ToVec(Empty() ? 0 : usize{ Max() } + 1); }
+
+public:
+    inline bool Empty() const noexcept { return m_Keys.Empty(); }
+    usize       Cardinality() const noexcept
+    {
+        usize count = 0;
+        for (const auto& container : m_Containers)
+            count += container.m_Cardinality;
+        return count;
+    }
+    // Largest value in the set, the set must not be empty.
+    u32 Max() const noexcept
+    {
+        const Container& last = m_Containers.Back();
+        u32              low  = 0;
+        switch (last.m_Kind)
+        {
+            case Kind::Array: low = last.m_Array.Back(); break;
+            case Kind::Runs: low = last.m_Runs.Back().m_Last; break;
+            case Kind::Bitmap:
+                for (usize i = ChunkWords; i-- > 0;)
+                    if (last.m_Words[i])
+                    {
+                        low = static_cast<u32>(i * 64 + 63 - std::countl_zero(last.m_Words[i]));
+                        break;
+                    }
+                break;
+        }
+        return (u32{ m_Keys.Back() } << 16) | low;
+    }
+    // Heap bytes held by the bitmap, container headers included.
+    usize MemoryBytes() const noexcept
+    {
+        usize bytes = m_Keys.Capacity() * sizeof(u16) + m_Containers.Capacity() * sizeof(Container);
+        for (const auto& container : m_Containers)
+            bytes += container.m_Array.Capacity() * sizeof(u16) + container.m_Words.Capacity() * sizeof(u64) +
+                     container.m_Runs.Capacity() * sizeof(Run);
+        return bytes;
+    }
+
+public:
+    bool Contains(const u32 value) const noexcept
+    {
+        const usize index = FindKey(static_cast<u16>(value >> 16));
+        return index < m_Keys.Size() && m_Keys[index] == (value >> 16) &&
+               ContainerContains(m_Containers[index], static_cast<u16>(value));
+    }
+    void Add(const u32 value)
+    {
+        Container&  container = ChunkFor(static_cast<u16>(value >> 16));
+        const u16   low       = static_cast<u16>(value);
+        if (container.m_Kind == Kind::Bitmap)
+        {
+            u64&      word = container.m_Words[low / 64];
+            const u64 mask = u64(1) << (low % 64);
+            container.m_Cardinality += (word & mask) == 0;
+            word |= mask;
+            return;
+        }
+        if (container.m_Kind == Kind::Array && container.m_Cardinality < ArrayMax)
+        {
+            const auto pos = std::lower_bound(container.m_Array.begin(), container.m_Array.end(), low);
+            if (pos == container.m_Array.end() || *pos != low)
+            {
+                container.m_Array.Insert(pos, low);
+                ++container.m_Cardinality;
+            }
+            return;
+        }
+        if (container.m_Kind == Kind::Runs)
+            return AddToRuns(container, low);
+        if (ContainerContains(container, low))
+            return;
+
+        // A full array is re-encoded once, it comes back as a bitmap or a run list and stays one from then on.
+        u64 image[ChunkWords];
+        ToWords(container, image);
+        image[low / 64] |= u64(1) << (low % 64);
+        container = FromWords(image);
+    }
+    // Adds every value in [first, last).
+    void AddRange(const u64 first, const u64 last)
+    {
+        if (first > last || last > std::numeric_limits<u32>::max() + u64{ 1 })
+            throw std::out_of_range("Index out of bounds.");
+
+        u64 image[ChunkWords];
+        for (u64 pos = first; pos < last;)
+        {
+            const u64  chunkEnd  = std::min(last, (pos / ChunkBits + 1) * ChunkBits);
+            Container& container = ChunkFor(static_cast<u16>(pos / ChunkBits));
+            ToWords(container, image);
+            SetWordRange(image, pos % ChunkBits, (chunkEnd - 1) % ChunkBits + 1);
+            container = FromWords(image);
+            pos       = chunkEnd;
+        }
+    }
+    // Re-encodes every chunk in its smallest container, e.g. after many Add() calls built long runs out of arrays.
+    void Optimize()
+    {
+        u64 image[ChunkWords];
+        for (auto& container : m_Containers)
+        {
+            ToWords(container, image);
+            container = FromWords(image);
+        }
+    }
+    // Calls fn(value) for every value in increasing order.
+    template <typename TFn>
+    void ForEachSetBit(TFn&& fn) const
+    {
+        for (usize i = 0; i < m_Keys.Size(); ++i)
+        {
+            const u32        high      = u32{ m_Keys[i] } << 16;
+            const Container& container = m_Containers[i];
+            switch (container.m_Kind)
+            {
+                case Kind::Array:
+                    for (const u16 low : container.m_Array)
+                        fn(high | low);
+                    break;
+                case Kind::Bitmap:
+                    for (usize w = 0; w < ChunkWords; ++w)
+                        for (u64 bits = container.m_Words[w]; bits; bits &= bits - 1)
+                            fn(high | static_cast<u32>(w * 64 + std::countr_zero(bits)));
+                    break;
+                case Kind::Runs:
+                    for (const Run& run : container.m_Runs)
+                        for (u32 low = run.m_First; low <= run.m_Last; ++low)
+                            fn(high | low);
+                    break;
+            }
+        }
+    }
+
+public:
+    inline CompressedBitmap operator&(const CompressedBitmap& other) const { return Combine<simd::BitOp::And>(other); }
+    inline CompressedBitmap operator|(const CompressedBitmap& other) const { return Combine<simd::BitOp::Or>(other); }
+    inline CompressedBitmap operator^(const CompressedBitmap& other) const { return Combine<simd::BitOp::Xor>(other); }
+    inline CompressedBitmap AndNot(const CompressedBitmap& other) const
+    {
+        return Combine<simd::BitOp::AndNot>(other);
+    }
+    inline CompressedBitmap& operator&=(const CompressedBitmap& other) { return *this = *this & other; }
+    inline CompressedBitmap& operator|=(const CompressedBitmap& other) { return *this = *this | other; }
+    inline CompressedBitmap& operator^=(const CompressedBitmap& other) { return *this = *this ^ other; }
+
+private:
+    inline usize FindKey(const u16 key) const noexcept
+    {
+        return static_cast<usize>(std::lower_bound(m_Keys.begin(), m_Keys.end(), key) - m_Keys.begin());
+    }
+    Container& ChunkFor(const u16 key)
+    {
+        const usize index = FindKey(key);
+        if (index == m_Keys.Size() || m_Keys[index] != key)
+        {
+            m_Keys.Insert(m_Keys.cbegin() + index, key);
+            m_Containers.Emplace(m_Containers.cbegin() + index);
+        }
+        return m_Containers[index];
+    }
+
+    static bool ContainerContains(const Container& container, const u16 low) noexcept
+    {
+        switch (container.m_Kind)
+        {
+            case Kind::Array: return std::binary_search(container.m_Array.begin(), container.m_Array.end(), low);
+            case Kind::Bitmap: return (container.m_Words[low / 64] >> (low % 64)) & 1;
+            case Kind::Runs:
+            {
+                const auto next = std::upper_bound(container.m_Runs.begin(), container.m_Runs.end(), low,
+                                                   [](const u16 value, const Run& run) { return value < run.m_First; });
+                return next != container.m_Runs.begin() && low <= (next - 1)->m_Last;
+            }
+        }
+        return false;
+    }
+    // Extends a neighbouring run, merges the two runs around low, or starts a new one. A run list that outgrows the
+    // bitmap is converted to one.
+    static void AddToRuns(Container& container, const u16 low)
+    {
+        Vec<Run>&  runs = container.m_Runs;
+        const auto next = std::upper_bound(runs.begin(), runs.end(), low,
+                                           [](const u16 value, const Run& run) { return value < run.m_First; });
+        const bool hasPrev = next != runs.begin();
+        if (hasPrev && low <= (next - 1)->m_Last)
+            return;
+
+        const bool joinsPrev = hasPrev && (next - 1)->m_Last + 1 == low;
+        const bool joinsNext = next != runs.end() && next->m_First == low + 1;
+        ++container.m_Cardinality;
+        if (joinsPrev && joinsNext)
+        {
+            (next - 1)->m_Last = next->m_Last;
+            runs.Erase(next);
+        }
+        else if (joinsPrev)
+            (next - 1)->m_Last = low;
+        else if (joinsNext)
+            next->m_First = low;
+        else
+            runs.Insert(next, { low, low });
+
+        if (runs.Size() * sizeof(Run) > ChunkWords * sizeof(u64))
+        {
+            container.m_Words.Resize(ChunkWords);
+            ToWords(container, container.m_Words.Data());
+            container.m_Kind = Kind::Bitmap;
+            runs.Clear();
+            runs.ShrinkToFit();
+        }
+    }
+    // Sets [first, last) in a chunk image.
+    static void SetWordRange(u64* words, usize first, const usize last) noexcept
+    {
+        while (first < last)
+        {
+            const usize offset = first % 64;
+            const usize take   = std::min(64 - offset, last - first);
+            words[first / 64] |= ((take == 64) ? ~u64(0) : (u64(1) << take) - 1) << offset;
+            first += take;
+        }
+    }
+    static void ToWords(const Container& container, u64* words) noexcept
+    {
+        if (container.m_Kind == Kind::Bitmap)
+            return (void)std::memcpy(words, container.m_Words.Data(), ChunkWords * sizeof(u64));
+
+        std::memset(words, 0, ChunkWords * sizeof(u64));
+        if (container.m_Kind == Kind::Array)
+        {
+            for (const u16 low : container.m_Array)
+                words[low / 64] |= u64(1) << (low % 64);
+        }
+        else
+        {
+            for (const Run& run : container.m_Runs)
+                SetWordRange(words, run.m_First, usize{ run.m_Last } + 1);
+        }
+    }
+    // First set (or clear, with Set = false) bit at or after pos, ChunkBits if there is none.
+    template <bool Set>
+    static usize NextBit(const u64* words, const usize pos) noexcept
+    {
+        usize i    = pos / 64;
+        u64   bits = (Set ? words[i] : ~words[i]) & (~u64(0) << (pos % 64));
+        while (!bits && ++i < ChunkWords)
+            bits = Set ? words[i] : ~words[i];
+        return bits ? i * 64 + static_cast<usize>(std::countr_zero(bits)) : ChunkBits;
+    }
+    // Encodes a chunk image in the smallest of the three containers.
+    static Container FromWords(const u64* words)
+    {
+        usize cardinality = 0, runs = 0;
+        u64   carry       = 0;
+        for (usize i = 0; i < ChunkWords; ++i)
+        {
+            cardinality += static_cast<usize>(std::popcount(words[i]));
+            runs += static_cast<usize>(std::popcount(words[i] & ~((words[i] << 1) | carry)));
+            carry = words[i] >> 63;
+        }
+
+        Container container;
+        container.m_Cardinality = static_cast<u32>(cardinality);
+        if (runs * sizeof(Run) < std::min(cardinality * sizeof(u16), ChunkWords * sizeof(u64)))
+        {
+            container.m_Kind = Kind::Runs;
+            container.m_Runs.Reserve(runs);
+            for (usize first = NextBit<true>(words, 0); first < ChunkBits;)
+            {
+                const usize end = NextBit<false>(words, first);
+                container.m_Runs.Push({ static_cast<u16>(first), static_cast<u16>(end - 1) });
+                first = (end < ChunkBits) ? NextBit<true>(words, end) : ChunkBits;
+            }
+        }
+        else if (cardinality <= ArrayMax)
+        {
+            container.m_Kind = Kind::Array;
+            container.m_Array.Reserve(cardinality);
+            for (usize i = 0; i < ChunkWords; ++i)
+                for (u64 bits = words[i]; bits; bits &= bits - 1)
+                    container.m_Array.Push(static_cast<u16>(i * 64 + std::countr_zero(bits)));
+        }
+        else
+        {
+            container.m_Kind = Kind::Bitmap;
+            container.m_Words.ResizeForOverwrite(ChunkWords);
+            std::memcpy(container.m_Words.Data(), words, ChunkWords * sizeof(u64));
+        }
+        return container;
+    }
+
+    template <simd::BitOp Op>
+    static Container CombineContainers(const Container& lhv, const Container& rhv)
+    {
+        const bool lhvArray = lhv.m_Kind == Kind::Array;
+        const bool rhvArray = rhv.m_Kind == Kind::Array;
+        if (lhvArray && rhvArray)
+        {
+            u16        merged[2 * ArrayMax];
+            const u16* a   = lhv.m_Array.Data();
+            const u16* b   = rhv.m_Array.Data();
+            const u16* ae  = a + lhv.m_Array.Size();
+            const u16* be  = b + rhv.m_Array.Size();
+            u16*       end = merged;
+            if constexpr (Op == simd::BitOp::And)
+                end = std::set_intersection(a, ae, b, be, merged);
+            else if constexpr (Op == simd::BitOp::Or)
+                end = std::set_union(a, ae, b, be, merged);
+            else if constexpr (Op == simd::BitOp::Xor)
+                end = std::set_symmetric_difference(a, ae, b, be, merged);
+            else
+                end = std::set_difference(a, ae, b, be, merged);
+            return FromSorted(merged, static_cast<usize>(end - merged));
+        }
+        // Intersections and differences of an array never get bigger than the array, probe the other side instead.
+        if constexpr (Op == simd::BitOp::And || Op == simd::BitOp::AndNot)
+        {
+            if (lhvArray || (Op == simd::BitOp::And && rhvArray))
+            {
+                const Container& array = lhvArray ? lhv : rhv;
+                const Container& other = lhvArray ? rhv : lhv;
+                u16              kept[ArrayMax];
+                usize            count = 0;
+                for (const u16 low : array.m_Array)
+                    if (ContainerContains(other, low) == (Op == simd::BitOp::And))
+                        kept[count++] = low;
+                return FromSorted(kept, count);
+            }
+        }
+
+        if constexpr (Op == simd::BitOp::And || Op == simd::BitOp::Or)
+        {
+            if (lhv.m_Kind == Kind::Runs && rhv.m_Kind == Kind::Runs)
+                return MergeRuns<Op>(lhv.m_Runs, rhv.m_Runs);
+        }
+
+        // Bitmap operands are read in place; a result that stays above ArrayMax is kept as a bitmap without
+        // looking for runs, Optimize() catches those.
+        u64 lhvImage[ChunkWords], rhvImage[ChunkWords];
+        const u64* lhvWords = lhv.m_Kind == Kind::Bitmap ? lhv.m_Words.Data() : (ToWords(lhv, lhvImage), lhvImage);
+        const u64* rhvWords = rhv.m_Kind == Kind::Bitmap ? rhv.m_Words.Data() : (ToWords(rhv, rhvImage), rhvImage);
+
+        Container container;
+        container.m_Kind = Kind::Bitmap;
+        container.m_Words.ResizeForOverwrite(ChunkWords);
+        simd::Bitwise<Op>(container.m_Words.Data(), lhvWords, rhvWords, ChunkWords);
+        container.m_Cardinality = static_cast<u32>(simd::PopCount(container.m_Words.Data(), ChunkWords));
+        return container.m_Cardinality > ArrayMax ? container : FromWords(container.m_Words.Data());
+    }
+    template <simd::BitOp Op>
+    static Container MergeRuns(const Vec<Run>& lhv, const Vec<Run>& rhv)
+    {
+        Vec<Run> runs;
+        runs.Reserve(lhv.Size() + rhv.Size());
+        for (usize i = 0, j = 0; i < lhv.Size() || j < rhv.Size();)
+        {
+            if constexpr (Op == simd::BitOp::And)
+            {
+                if (i == lhv.Size() || j == rhv.Size())
+                    break;
+                const u16 first = std::max(lhv[i].m_First, rhv[j].m_First);
+                const u16 last  = std::min(lhv[i].m_Last, rhv[j].m_Last);
+                if (first <= last)
+                    runs.Push({ first, last });
+                (lhv[i].m_Last < rhv[j].m_Last) ? ++i : ++j;
+            }
+            else
+            {
+                const bool takeLhv = j == rhv.Size() || (i < lhv.Size() && lhv[i].m_First < rhv[j].m_First);
+                const Run& next    = takeLhv ? lhv[i++] : rhv[j++];
+                if (!runs.Empty() && usize{ next.m_First } <= usize{ runs.Back().m_Last } + 1)
+                    runs.Back().m_Last = std::max(runs.Back().m_Last, next.m_Last);
+                else
+                    runs.Push(next);
+            }
+        }
+
+        usize cardinality = 0;
+        for (const Run& run : runs)
+            cardinality += usize{ run.m_Last } - run.m_First + 1;
+        Container container;
+        container.m_Cardinality = static_cast<u32>(cardinality);
+        if (runs.Size() * sizeof(Run) < std::min(cardinality * sizeof(u16), ChunkWords * sizeof(u64)))
+        {
+            container.m_Kind = Kind::Runs;
+            container.m_Runs.Reserve(runs.Size());
+            for (const Run& run : runs)
+                container.m_Runs.Push(run);
+        }
+        else if (cardinality <= ArrayMax)
+        {
+            container.m_Array.Reserve(cardinality);
+            for (const Run& run : runs)
+                for (u32 low = run.m_First; low <= run.m_Last; ++low)
+                    container.m_Array.Push(static_cast<u16>(low));
+        }
+        else
+        {
+            u64 image[ChunkWords]{};
+            for (const Run& run : runs)
+                SetWordRange(image, run.m_First, usize{ run.m_Last } + 1);
+            return FromWords(image);
+        }
+        return container;
+    }
+    static Container FromSorted(const u16* values, const usize count)
+    {
+        if (count > ArrayMax)
+        {
+            u64 image[ChunkWords]{};
+            for (usize i = 0; i < count; ++i)
+                image[values[i] / 64] |= u64(1) << (values[i] % 64);
+            return FromWords(image);
+        }
+
+        Container container;
+        container.m_Cardinality = static_cast<u32>(count);
+        container.m_Array.ResizeForOverwrite(count);
+        std::copy(values, values + count, container.m_Array.Data());
+        return container;
+    }
+
+    template <simd::BitOp Op>
+    CompressedBitmap Combine(const CompressedBitmap& other) const
+    {
+        constexpr bool keepLhv = Op != simd::BitOp::And;
+        constexpr bool keepRhv = Op == simd::BitOp::Or || Op == simd::BitOp::Xor;
+
+        CompressedBitmap result;
+        const usize      lhvSize = m_Keys.Size(), rhvSize = other.m_Keys.Size();
+        for (usize i = 0, j = 0; i < lhvSize || j < rhvSize;)
+        {
+            if (j == rhvSize || (i < lhvSize && m_Keys[i] < other.m_Keys[j]))
+            {
+                if (keepLhv)
+                    result.AppendChunk(m_Keys[i], m_Containers[i]);
+                ++i;
+            }
+            else if (i == lhvSize || other.m_Keys[j] < m_Keys[i])
+            {
+                if (keepRhv)
+                    result.AppendChunk(other.m_Keys[j], other.m_Containers[j]);
+                ++j;
+            }
+            else
+            {
+                Container container = CombineContainers<Op>(m_Containers[i], other.m_Containers[j]);
+                if (container.m_Cardinality > 0)
+                    result.AppendChunk(m_Keys[i], std::move(container));
+                ++i;
+                ++j;
+            }
+        }
+        return result;
+    }
+    template <typename TContainer>
+    void AppendChunk(const u16 key, TContainer&& container)
+    {
+        m_Keys.Push(key);
+        m_Containers.Push(std::forward<TContainer>(container));
+    }
+};
+
+// Vec<bool> generalized to unsigned integers of any width from 1 to 64 bits. Element i occupies bits
+// [i * Bits, (i + 1) * Bits) of an LSB-first u64 buffer, so reading or writing one element touches at most two
+// adjacent words and costs the same at every width. A zero word is kept past the last element so that the two-word
+// access never needs a branch, and as in Vec<bool> all bits past Size() * Bits stay 0.
+template <usize Bits, typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+    requires(Bits >= 1 && Bits <= 64)
+class PackedVec
+{
+public:
+    using ValueType = std::conditional_t<(Bits <= 8), u8,
+                                         std::conditional_t<(Bits <= 16), u16, std::conditional_t<(Bits <= 32), u32, u64>>>;
+    static constexpr ValueType MaxValue = static_cast<ValueType>(simd::PackMask<Bits>);
+
+private:
+    using BufferType              = u64;
+    static constexpr auto BitSize = sizeof(BufferType) * 8;
+    static constexpr u64  Mask    = simd::PackMask<Bits>;
+
+    static constexpr ValueType Load(const BufferType* words, const usize index) noexcept
+    {
+        const usize bit   = index * Bits;
+        const usize shift = bit % BitSize;
+        // (x << 1) << (63 - shift) is x << (64 - shift) without the undefined shift by 64 when shift is 0.
+        const u64 lo = words[bit / BitSize] >> shift;
+        const u64 hi = (words[bit / BitSize + 1] << 1) << (BitSize - 1 - shift);
+        return static_cast<ValueType>((lo | hi) & Mask);
+    }
+    static constexpr void Store(BufferType* words, const usize index, const u64 value) noexcept
+    {
+        const usize bit    = index * Bits;
+        const usize shift  = bit % BitSize;
+        const u64   masked = value & Mask;
+        const u64   hiMask = (Mask >> 1) >> (BitSize - 1 - shift);
+        BufferType& lo     = words[bit / BitSize];
+        BufferType& hi     = words[bit / BitSize + 1];
+        lo                 = (lo & ~(Mask << shift)) | (masked << shift);
+        hi                 = (hi & ~hiMask) | ((masked >> 1) >> (BitSize - 1 - shift));
+    }
+
+private:
+    BufferType*                  m_Buffer   = nullptr;
+    usize                        m_Size     = 0;
+    usize                        m_Capacity = 0;
+    [[no_unique_address]] TAlloc m_Alloc;
+
+public:
+    class Ref
+    {
+    private:
+        BufferType* m_Ptr   = nullptr;
+        usize       m_Index = 0;
+
+    public:
+        Ref(BufferType* ptr, const usize index) : m_Ptr(ptr), m_Index(index) {}
+
+    public:
+        constexpr operator ValueType() const noexcept { return Load(m_Ptr, m_Index); }
+        // Values are truncated to their low Bits bits, like assigning to a bit-field.
+        inline const Ref& operator=(const u64 value) const noexcept
+        {
+            Store(m_Ptr, m_Index, value);
+            return *this;
+        }
+        inline const Ref& operator=(const Ref& value) const noexcept
+        {
+            return this->operator=(value.operator ValueType());
+        }
+        inline const Ref& operator+=(const u64 value) const noexcept { return *this = Load(m_Ptr, m_Index) + value; }
+        inline const Ref& operator-=(const u64 value) const noexcept { return *this = Load(m_Ptr, m_Index) - value; }
+        inline const Ref& operator&=(const u64 value) const noexcept { return *this = Load(m_Ptr, m_Index) & value; }
+        inline const Ref& operator|=(const u64 value) const noexcept { return *this = Load(m_Ptr, m_Index) | value; }
+        inline const Ref& operator^=(const u64 value) const noexcept { return *this = Load(m_Ptr, m_Index) ^ value; }
+        inline const Ref& operator++() const noexcept { return *this += 1; }
+        inline const Ref& operator--() const noexcept { return *this -= 1; }
+
+    public:
+        friend void swap(const Ref lhv, const Ref rhv) noexcept
+        {
+            const ValueType temp = lhv;
+            lhv                  = rhv.operator ValueType();
+            rhv                  = temp;
+        }
+        friend std::ostream& operator<<(std::ostream& stream, const Ref& ref)
+        {
+            stream << u64{ ref.operator ValueType() };
+            return stream;
+        }
+    };
+    class ConstIterator;
+    class Iterator
+    {
+        friend class ConstIterator;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = ValueType;
+        using pointer           = void;
+        using reference         = Ref;
+
+    private:
+        BufferType* m_Ptr   = nullptr;
+        usize       m_Index = 0;
+
+    public:
+        Iterator() = default;
+        Iterator(BufferType* ptr, const usize index) noexcept : m_Ptr(ptr), m_Index(index) {}
+
+    public:
+        inline reference operator*() const noexcept { return Ref(m_Ptr, m_Index); }
+        inline reference operator[](const difference_type index) const noexcept { return Ref(m_Ptr, m_Index + index); }
+        inline Iterator& operator++() noexcept
+        {
+            ++m_Index;
+            return *this;
+        }
+        inline Iterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+        inline Iterator& operator--() noexcept
+        {
+            --m_Index;
+            return *this;
+        }
+        inline Iterator operator--(const i32) noexcept
+        {
+            auto t = *this;
+            --(*this);
+            return t;
+        }
+        inline Iterator& operator+=(const difference_type disp) noexcept
+        {
+            m_Index += disp;
+            return *this;
+        }
+        inline Iterator& operator-=(const difference_type disp) noexcept
+        {
+            m_Index -= disp;
+            return *this;
+        }
+        constexpr difference_type operator-(const Iterator& other) const noexcept
+        {
+            return static_cast<difference_type>(m_Index - other.m_Index);
+        }
+        inline Iterator operator+(const difference_type disp) const noexcept
+        {
+            Iterator temp = *this;
+            temp.m_Index += disp;
+            return temp;
+        }
+        inline Iterator operator-(const difference_type disp) const noexcept
+        {
+            Iterator temp = *this;
+            temp.m_Index -= disp;
+            return temp;
+        }
+
+    public:
+        friend Iterator operator+(const difference_type disp, const Iterator& it) noexcept { return it + disp; }
+        friend bool operator==(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Index == rhv.m_Index; }
+        friend auto operator<=>(const Iterator& lhv, const Iterator& rhv) noexcept { return lhv.m_Index <=> rhv.m_Index; }
+    };
+    class ConstIterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff;
+        using value_type        = ValueType;
+        using pointer           = void;
+        using reference         = ValueType;
+
+    private:
+        const BufferType* m_Ptr   = nullptr;
+        usize             m_Index = 0;
+
+    public:
+        ConstIterator() = default;
+        ConstIterator(const BufferType* ptr, const usize index) noexcept : m_Ptr(ptr), m_Index(index) {}
+        ConstIterator(Iterator it) noexcept : m_Ptr(it.m_Ptr), m_Index(it.m_Index) {}
+
+    public:
+        constexpr reference operator*() const noexcept { return Load(m_Ptr, m_Index); }
+        constexpr reference operator[](const difference_type index) const noexcept { return Load(m_Ptr, m_Index + index); }
+        inline ConstIterator& operator++() noexcept
+        {
+            ++m_Index;
+            return *this;
+        }
+        inline ConstIterator operator++(const i32) noexcept
+        {
+            auto t = *this;
+            ++(*this);
+            return t;
+        }
+        inline ConstIterator& operator--() noexcept
+        {
+            --m_Index;
+            return *this;
+        }
+        inline ConstIterator operator--(const i32) noexcept
+        {
+            auto t = *this;
+            --(*this);
+            return t;
+        }
+        inline ConstIterator& operator+=(const difference_type disp) noexcept
+        {
+            m_Index += disp;
+            return *this;
+        }
+        inline ConstIterator& operator-=(const difference_type disp) noexcept
+        {
+            m_Index -= disp;
+            return *this;
+        }
+        constexpr difference_type operator-(const ConstIterator& other) const noexcept
+        {
+            return static_cast<difference_type>(m_Index - other.m_Index);
+        }
+        inline ConstIterator operator+(const difference_type disp) const noexcept
+        {
+            auto temp = *this;
+            temp.m_Index += disp;
+            return temp;
+        }
+        inline ConstIterator operator-(const difference_type disp) const noexcept
+        {
+            auto temp = *this;
+            temp.m_Index -= disp;
+            return temp;
+        }
+
+    public:
+        friend ConstIterator operator+(const difference_type disp, const ConstIterator& it) noexcept
+        {
+            return it + disp;
+        }
+        friend bool operator==(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+        {
+            return lhv.m_Index == rhv.m_Index;
+        }
+        friend auto operator<=>(const ConstIterator& lhv, const ConstIterator& rhv) noexcept
+        {
+            return lhv.m_Index <=> rhv.m_Index;
+        }
+    };
+
+public:
+    PackedVec() = default;
+    explicit PackedVec(const TAlloc& alloc) noexcept : m_Alloc(alloc) {}
+    explicit PackedVec(const usize size, const TAlloc& alloc = TAlloc()) : m_Alloc(alloc) { Realloc(size); }
+    PackedVec(const std::initializer_list<u64> list, const TAlloc& alloc = TAlloc()) : m_Alloc(alloc)
+    {
+        Realloc(list.size());
+        usize i = 0;
+        for (const u64 e : list)
+            Store(m_Buffer, i++, e);
+    }
+    PackedVec(const PackedVec& other) : m_Alloc(other.m_Alloc)
+    {
+        if (other.m_Buffer)
+        {
+            m_Size     = other.m_Size;
+            m_Capacity = other.m_Capacity;
+            m_Buffer   = Allocate(m_Capacity);
+            std::memcpy(m_Buffer, other.m_Buffer, WordCount(m_Size) * sizeof(BufferType));
+        }
+    }
+    PackedVec(PackedVec&& other) noexcept : m_Alloc(other.m_Alloc)
+    {
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Buffer, other.m_Buffer);
+    }
+    ~PackedVec() { Drop(); }
+
+    // Packs a whole Vec<T> at once, 64 values per block through simd::Pack.
+    template <Integral T, typename TOtherAlloc, typename TOtherGrowth>
+    static PackedVec FromVec(const Vec<T, TOtherAlloc, TOtherGrowth>& values, const TAlloc& alloc = TAlloc())
+    {
+        PackedVec result(alloc);
+        result.Assign(values.Data(), values.Size());
+        return result;
+    }
+
+public:
+    constexpr usize       Size() const noexcept { return m_Size; }
+    constexpr usize       Capacity() const noexcept { return m_Capacity ? (m_Capacity - 1) * BitSize / Bits : 0; }
+    constexpr bool        Empty() const noexcept { return m_Size == 0; }
+    constexpr BufferType* Data() const noexcept { return m_Buffer; }
+    constexpr usize       MemoryBytes() const noexcept { return m_Capacity * sizeof(BufferType); }
+    constexpr const TAlloc& Allocator() const noexcept { return m_Alloc; }
+
+public:
+    inline Iterator      begin() noexcept { return Iterator(m_Buffer, 0); }
+    inline Iterator      end() noexcept { return Iterator(m_Buffer, m_Size); }
+    inline ConstIterator begin() const noexcept { return ConstIterator(m_Buffer, 0); }
+    inline ConstIterator end() const noexcept { return ConstIterator(m_Buffer, m_Size); }
+    inline ConstIterator cbegin() const noexcept { return ConstIterator(m_Buffer, 0); }
+    inline ConstIterator cend() const noexcept { return ConstIterator(m_Buffer, m_Size); }
+
+public:
+    inline Ref       operator[](const usize index) noexcept { return Ref(m_Buffer, index); }
+    inline ValueType operator[](const usize index) const noexcept { return Load(m_Buffer, index); }
+    inline Ref       At(const usize index)
+    {
+        if (index < m_Size)
+            return this->operator[](index);
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    inline ValueType At(const usize index) const
+    {
+        if (index < m_Size)
+            return this->operator[](index);
+        else
+            throw std::out_of_range("Index out of bounds.");
+    }
+    inline ValueType Back() const
+    {
+        if (m_Size > 0)
+            return Load(m_Buffer, m_Size - 1);
+        else
+            throw std::out_of_range("Tried calling Back() on an empty vector.");
+    }
+    void Push(const u64 value)
+    {
+        Realloc(m_Size + 1);
+        Store(m_Buffer, m_Size - 1, value);
+    }
+    inline ValueType Pop()
+    {
+        if (m_Size > 0)
+        {
+            const ValueType value = Load(m_Buffer, m_Size - 1);
+            Realloc(m_Size - 1);
+            return value;
+        }
+        else
+            throw std::out_of_range("Tried calling Pop() on an empty vector.");
+    }
+    inline void Resize(const usize newSize) { Realloc(newSize); }
+    void        Reserve(const usize newCapacity)
+    {
+        if (newCapacity > 0 && WordsFor(newCapacity) > m_Capacity)
+            SetCapacity(WordsFor(newCapacity));
+    }
+    inline void Clear() noexcept { Realloc(0); }
+    constexpr void Swap(PackedVec& other)
+    {
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Buffer, other.m_Buffer);
+        std::swap(m_Alloc, other.m_Alloc);
+    }
+    void Fill(const u64 value) noexcept
+    {
+        for (usize i = 0; i < m_Size; ++i)
+            Store(m_Buffer, i, value);
+    }
+
+public:
+    // Replaces the contents with values[0, count), whole 64-value blocks go through simd::Pack.
+    template <Integral T>
+    void Assign(const T* values, const usize count)
+    {
+        if (count < m_Size)
+            Realloc(count);
+        Reserve(count);
+        m_Size = count;
+
+        const usize blocks = count / 64;
+        simd::Pack<Bits>(values, m_Buffer, blocks);
+        for (usize i = blocks * 64; i < count; ++i)
+            Store(m_Buffer, i, static_cast<u64>(values[i]));
+    }
+    // Writes all elements to out[0, Size()), whole 64-value blocks go through simd::Unpack.
+    template <Integral T>
+    void CopyTo(T* out) const noexcept
+    {
+        const usize blocks = m_Size / 64;
+        simd::Unpack<Bits>(m_Buffer, out, blocks);
+        for (usize i = blocks * 64; i < m_Size; ++i)
+            out[i] = static_cast<T>(Load(m_Buffer, i));
+    }
+    template <Integral T = ValueType>
+    Vec<T> ToVec() const
+    {
+        Vec<T> result;
+        result.ResizeForOverwrite(m_Size);
+        CopyTo(result.Data());
+        return result;
+    }
+
+public:
+    inline PackedVec& operator=(const PackedVec& other)
+    {
+        if (&other == this)
+            return *this;
+
+        PackedVec copy(other);
+        Swap(copy);
+        return *this;
+    }
+    inline PackedVec& operator=(PackedVec&& other) noexcept
+    {
+        if (&other == this)
+            return *this;
+
+        Drop();
+        m_Alloc = other.m_Alloc;
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Buffer, other.m_Buffer);
+        return *this;
+    }
+    // Unused bits are always 0, so equal contents mean equal words.
+    friend bool operator==(const PackedVec& lhv, const PackedVec& rhv) noexcept
+    {
+        return lhv.m_Size == rhv.m_Size &&
+               (lhv.m_Size == 0 || std::memcmp(lhv.m_Buffer, rhv.m_Buffer, WordCount(lhv.m_Size) * sizeof(BufferType)) == 0);
+    }
+
+private:
+    static constexpr usize WordCount(const usize size) noexcept { return (size * Bits + BitSize - 1) / BitSize; }
+    // Words needed for size elements, the padding word included.
+    static constexpr usize WordsFor(const usize size) noexcept { return WordCount(size) + 1; }
+    constexpr usize        GrowCapacity(const usize requiredWords) const noexcept
+    {
+        return std::max(requiredWords, TGrowth::Grow(requiredWords, sizeof(BufferType)));
+    }
+    void Realloc(const usize newSize)
+    {
+        if (newSize < m_Size)
+        {
+            // Zero the dropped elements so that growing again reads them back as 0.
+            const usize words = WordCount(newSize);
+            if ((newSize * Bits) % BitSize)
+                m_Buffer[words - 1] &= (u64(1) << ((newSize * Bits) % BitSize)) - 1;
+            std::memset(m_Buffer + words, 0, (WordCount(m_Size) - words) * sizeof(BufferType));
+            m_Size = newSize;
+            if constexpr (TGrowth::ShrinkDivisor > 0)
+            {
+                if (newSize > 0 && WordsFor(newSize) < m_Capacity / TGrowth::ShrinkDivisor)
+                    SetCapacity(GrowCapacity(WordsFor(newSize)));
+            }
+        }
+        else
+        {
+            if (newSize > 0 && WordsFor(newSize) > m_Capacity)
+                SetCapacity(GrowCapacity(WordsFor(newSize)));
+            m_Size = newSize;
+        }
+    }
+    void SetCapacity(const usize newCapacity)
+    {
+        BufferType* temp = m_Buffer;
+        m_Buffer         = Allocate(newCapacity);
+        if (temp)
+        {
+            std::memcpy(m_Buffer, temp, std::min(m_Capacity, newCapacity) * sizeof(BufferType));
+            Deallocate(temp, m_Capacity);
+        }
+        m_Capacity = newCapacity;
+    }
+    // Words handed out by Allocate() are always zeroed, Store() and the tail handling rely on it.
+    inline BufferType* Allocate(const usize count)
+    {
+        if (count == 0)
+            return nullptr;
+
+        BufferType* ptr = static_cast<BufferType*>(m_Alloc.Allocate(count * sizeof(BufferType), alignof(BufferType)));
+        std::memset(ptr, 0, count * sizeof(BufferType));
+        return ptr;
+    }
+    inline void Deallocate(BufferType* ptr, const usize count) noexcept
+    {
+        if (ptr)
+            m_Alloc.Deallocate(ptr, count * sizeof(BufferType), alignof(BufferType));
+    }
+    inline void Drop() noexcept
+    {
+        Deallocate(m_Buffer, m_Capacity);
+        m_Buffer   = nullptr;
+        m_Size     = 0;
+        m_Capacity = 0;
+    }
+};
+
+// Filter building blocks: a predicate over a column becomes a Vec<bool> selection mask, and Compact() gathers the
+// elements a mask selects. Both run on the simd:: kernels and never branch on the data. The *Into forms reuse the
+// output's buffer, so a filter stage that runs every batch stops allocating once its buffers are warm.
+template <simd::CmpOp Op, Arithmetic T, typename TAlloc, typename TGrowth, typename TMaskAlloc, typename TMaskGrowth>
+void CompareInto(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value,
+                 Vec<bool, TMaskAlloc, TMaskGrowth>& mask)
+{
+    mask.Resize(vec.Size());
+    simd::Compare<Op>(vec.Data(), vec.Size(), value, mask.Data());
+    mask.MarkModified();
+}
+template <simd::CmpOp Op, Arithmetic T, typename TAlloc, typename TGrowth>
+Vec<bool> Compare(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    Vec<bool> mask;
+    CompareInto<Op>(vec, value, mask);
+    return mask;
+}
+template <Arithmetic T, typename TAlloc, typename TGrowth>
+inline Vec<bool> CompareEqual(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    return Compare<simd::CmpOp::Equal>(vec, value);
+}
+template <Arithmetic T, typename TAlloc, typename TGrowth>
+inline Vec<bool> CompareNotEqual(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    return Compare<simd::CmpOp::NotEqual>(vec, value);
+}
+template <Arithmetic T, typename TAlloc, typename TGrowth>
+inline Vec<bool> CompareLess(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    return Compare<simd::CmpOp::Less>(vec, value);
+}
+template <Arithmetic T, typename TAlloc, typename TGrowth>
+inline Vec<bool> CompareLessEqual(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    return Compare<simd::CmpOp::LessEqual>(vec, value);
+}
+template <Arithmetic T, typename TAlloc, typename TGrowth>
+inline Vec<bool> CompareGreater(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    return Compare<simd::CmpOp::Greater>(vec, value);
+}
+template <Arithmetic T, typename TAlloc, typename TGrowth>
+inline Vec<bool> CompareGreaterEqual(const Vec<T, TAlloc, TGrowth>& vec, const std::type_identity_t<T> value)
+{
+    return Compare<simd::CmpOp::GreaterEqual>(vec, value);
+}
+
+// out = the elements of vec whose mask bit is set, in order. out must not be vec.
+template <typename T, typename TAlloc, typename TGrowth, typename TMaskAlloc, typename TMaskGrowth, typename TOutAlloc,
+          typename TOutGrowth>
+void CompactInto(const Vec<T, TAlloc, TGrowth>& vec, const Vec<bool, TMaskAlloc, TMaskGrowth>& mask,
+                 Vec<T, TOutAlloc, TOutGrowth>& out)
+{
+    if (mask.Size() != vec.Size())
+        throw std::invalid_argument("Tried calling Compact() with a mask of a different size.");
+
+    // The kernels may store up to CompactSlack elements past the last selected one, into spare capacity.
+    const usize selected = mask.Count();
+    out.Clear();
+    out.Reserve(selected + simd::CompactSlack);
+    out.ResizeForOverwrite(selected);
+    simd::Compact(vec.Data(), mask.Data(), vec.Size(), out.Data());
+}
+template <typename T, typename TAlloc, typename TGrowth, typename TMaskAlloc, typename TMaskGrowth>
+Vec<T, TAlloc, TGrowth> Compact(const Vec<T, TAlloc, TGrowth>& vec, const Vec<bool, TMaskAlloc, TMaskGrowth>& mask)
+{
+    Vec<T, TAlloc, TGrowth> out(vec.Allocator());
+    CompactInto(vec, mask, out);
+    return out;
+}
+
+// Text interop for numeric vectors. ToChars() formats with std::to_chars, elements separated by delimiter and nothing
+// else, and FromChars() parses that back with std::from_chars, allowing whitespace around each number. The *Into
+// forms reuse the output's buffer.
+template <text::Number T, typename TAlloc, typename TGrowth, typename TOutAlloc, typename TOutGrowth>
+void ToCharsInto(const Vec<T, TAlloc, TGrowth>& vec, Vec<char, TOutAlloc, TOutGrowth>& out, const char delimiter = ',')
+{
+    // Blocks are formatted straight into spare capacity, then the characters actually written are committed.
+    constexpr usize Block = 1024;
+    out.Clear();
+    for (usize i = 0; i < vec.Size(); i += Block)
+    {
+        const usize count  = std::min(Block, vec.Size() - i);
+        const usize needed = out.Size() + count * (text::MaxChars<T> + 1);
+        if (needed > out.Capacity())
+            out.Reserve(std::max(needed, out.Capacity() * 2));
+
+        char* const first = out.Data() + out.Size();
+        char*       next  = first;
+        if (i > 0)
+            *next++ = delimiter;
+        next = text::Format(vec.Data() + i, count, std::string_view(&delimiter, 1), next);
+        out.ResizeForOverwrite(out.Size() + (next - first));
+    }
+}
+template <text::Number T, typename TAlloc, typename TGrowth>
+Vec<char> ToChars(const Vec<T, TAlloc, TGrowth>& vec, const char delimiter = ',')
+{
+    Vec<char> out;
+    ToCharsInto(vec, out, delimiter);
+    return out;
+}
+
+// Throws std::invalid_argument on anything but delimited numbers, including empty fields, and std::out_of_range on
+// numbers the element type cannot hold. Text with nothing but whitespace parses to an empty vector.
+template <text::Number T, typename TAlloc, typename TGrowth>
+void FromCharsInto(const char* first, const char* last, Vec<T, TAlloc, TGrowth>& out, const char delimiter = ',')
+{
+    const auto parse = [&out](const char* begin, const char* end)
+    {
+        while (begin < end && text::IsSpace(*begin))
+            ++begin;
+        while (end > begin && text::IsSpace(end[-1]))
+            --end;
+
+        T    value;
+        auto result = std::from_chars(begin, end, value);
+        if (result.ec == std::errc::result_out_of_range)
+            throw std::out_of_range("Tried calling FromChars() on a number out of range for the element type.");
+        if (result.ec != std::errc() || result.ptr != end)
+            throw std::invalid_argument("Tried calling FromChars() on text that is not a list of numbers.");
+        out.Push(value);
+    };
+
+    // Delimiters are found a block at a time as a bit mask from simd::Compare, whose set bits are then visited in
+    // order.
+    constexpr usize BlockWords = 256;
+    u64             words[BlockWords];
+    const usize     size  = last - first;
+    const char*     field = first;
+    out.Clear();
+    for (usize block = 0; block < size; block += BlockWords * 64)
+    {
+        const usize count = std::min(BlockWords * 64, size - block);
+        simd::Compare<simd::CmpOp::Equal>(reinterpret_cast<const u8*>(first + block), count,
+                                          static_cast<u8>(delimiter), words);
+        for (usize w = 0; w * 64 < count; ++w)
+        {
+            for (u64 bits = words[w]; bits; bits &= bits - 1)
+            {
+                const char* end = first + block + w * 64 + static_cast<usize>(std::countr_zero(bits));
+                parse(field, end);
+                field = end + 1;
+            }
+        }
+    }
+    if (field == first && std::all_of(first, last, text::IsSpace))
+        return;
+    parse(field, last);
+}
+template <text::Number T, typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+Vec<T, TAlloc, TGrowth> FromChars(const char* first, const char* last, const char delimiter = ',')
+{
+    Vec<T, TAlloc, TGrowth> out;
+    FromCharsInto(first, last, out, delimiter);
+    return out;
+}
+
+// 64-bit checksum for catching torn writes and corrupted files, not an integrity check against tampering. Four
+// independent lanes in the style of xxHash64 keep the multipliers busy, so large buffers hash at memory bandwidth.
+inline u64 Checksum64(const void* data, const usize size, const u64 seed = 0) noexcept
+{
+    constexpr u64 Prime1 = 0x9E3779B185EBCA87;
+    constexpr u64 Prime2 = 0xC2B2AE3D27D4EB4F;
+    constexpr u64 Prime3 = 0x165667B19E3779F9;
+
+    const auto  round = [](const u64 acc, const u64 word) { return std::rotl(acc + word * Prime2, 31) * Prime1; };
+    const auto  load  = [](const u8* ptr)
+    {
+        u64 word;
+        std::memcpy(&word, ptr, sizeof(word));
+        return word;
+    };
+    const auto* bytes = static_cast<const u8*>(data);
+
+    u64   lanes[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+    usize i        = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (usize lane = 0; lane < 4; ++lane)
+            lanes[lane] = round(lanes[lane], load(bytes + i + lane * 8));
+    }
+
+    u64 hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+    hash += size;
+    for (; i + 8 <= size; i += 8)
+        hash = std::rotl(hash ^ round(0, load(bytes + i)), 27) * Prime1 + Prime3;
+    for (; i < size; ++i)
+        hash = std::rotl(hash ^ (bytes[i] * Prime3), 11) * Prime1;
+
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Saved vectors start with a FileHeader, padded with zeros to DataOffset so that the elements behind it are page
+// aligned and a mapping of the whole file can be used in place, without parsing or copying. Fields are stored in
+// native byte order, so files move between machines of the same endianness only. A Vec<bool> is stored as its
+// words, with an element size of Bits and the size counted in bits.
+struct FileHeader
+{
+    static constexpr char  Magic[8]   = { 'V', 'E', 'C', 'F', 'I', 'L', 'E', '\0' };
+    static constexpr u32   Version    = 1;
+    static constexpr u32   Bits       = 0;
+    static constexpr usize DataOffset = 4096;
+
+    char m_Magic[8]    = {};
+    u32  m_Version     = 0;
+    u32  m_ElementSize = 0;
+    u64  m_Size        = 0;
+    u64  m_Bytes       = 0;
+    u64  m_Checksum    = 0;
+
+    template <typename T>
+    static constexpr u32 ElementSize() noexcept
+    {
+        return std::is_same_v<T, bool> ? Bits : static_cast<u32>(sizeof(T));
+    }
+    static FileHeader Make(const u32 elementSize, const usize size, const void* data, const usize bytes) noexcept
+    {
+        FileHeader header;
+        std::memcpy(header.m_Magic, Magic, sizeof(Magic));
+        header.m_Version     = Version;
+        header.m_ElementSize = elementSize;
+        header.m_Size        = size;
+        header.m_Bytes       = bytes;
+        header.m_Checksum    = Checksum64(data, bytes);
+        return header;
+    }
+    // Throws unless this header describes elements of elementSize and fits in a file of fileSize bytes.
+    void Check(const u32 elementSize, const usize fileSize) const
+    {
+        if (std::memcmp(m_Magic, Magic, sizeof(Magic)) != 0 || m_Version != Version)
+            throw std::runtime_error("Tried opening a file that is not a saved vector.");
+        if (m_ElementSize != elementSize)
+            throw std::runtime_error("Tried opening a file saved with a different element type.");
+
+        const bool overflows = elementSize != Bits && m_Size > std::numeric_limits<u64>::max() / elementSize;
+        const u64  expected  = (elementSize == Bits) ? (m_Size / 64 + (m_Size % 64 != 0)) * sizeof(u64)
+                                                     : m_Size * elementSize;
+        if (overflows || m_Bytes != expected || fileSize < DataOffset || fileSize - DataOffset < m_Bytes)
+            throw std::runtime_error("Tried opening a truncated or inconsistent file.");
+    }
+};
+static_assert(sizeof(FileHeader) <= FileHeader::DataOffset);
+
+// The file is written next to path and renamed over it once complete. Truncating path in place would pull the pages
+// out from under every FileView still mapping it (their next read faults with SIGBUS), and a failed write would leave
+// neither the old nor the new contents behind.
+inline void WriteVecFile(const char* path, const FileHeader& header, const void* data)
+{
+    static constexpr char padding[FileHeader::DataOffset - sizeof(FileHeader)] = {};
+
+    const std::string temp = std::string(path) + ".tmp";
+    bool              written;
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding, sizeof(padding));
+        if (header.m_Bytes)
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(header.m_Bytes));
+        file.close();
+        written = !file.fail();
+    }
+    if (!written || std::rename(temp.c_str(), path) != 0)
+    {
+        std::remove(temp.c_str());
+        throw std::runtime_error("Could not write the file.");
+    }
+}
+
+// Writes vec to path in the FileHeader format, replacing the file if it exists. FileViews of the old file keep seeing
+// the old contents.
+template <typename T, typename TAlloc, typename TGrowth>
+    requires std::is_trivially_copyable_v<T>
+void SaveVec(const Vec<T, TAlloc, TGrowth>& vec, const char* path)
+{
+    const usize bytes = vec.Size() * sizeof(T);
+    WriteVecFile(path, FileHeader::Make(FileHeader::ElementSize<T>(), vec.Size(), vec.Data(), bytes), vec.Data());
+}
+template <typename TAlloc, typename TGrowth>
+void SaveVec(const Vec<bool, TAlloc, TGrowth>& vec, const char* path)
+{
+    const usize bytes = (vec.Size() + 63) / 64 * sizeof(u64);
+    WriteVecFile(path, FileHeader::Make(FileHeader::Bits, vec.Size(), vec.Data(), bytes), vec.Data());
+}
+
+// Reads a file written by SaveVec() into a new vector, verifying its checksum. This is the classic load path: every
+// byte is read and copied up front. FileView maps the same file instead.
+template <typename T, typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+    requires std::is_trivially_copyable_v<T>
+Vec<T, TAlloc, TGrowth> LoadVec(const char* path, const TAlloc& alloc = TAlloc())
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        throw std::runtime_error("Could not open the file.");
+    const usize fileSize = static_cast<usize>(file.tellg());
+
+    FileHeader header;
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        throw std::runtime_error("Tried opening a file that is not a saved vector.");
+    header.Check(FileHeader::ElementSize<T>(), fileSize);
+
+    Vec<T, TAlloc, TGrowth> vec(alloc);
+    if constexpr (std::is_same_v<T, bool>)
+        vec.Resize(header.m_Size);
+    else
+        vec.ResizeForOverwrite(header.m_Size);
+    file.seekg(FileHeader::DataOffset);
+    if (header.m_Bytes && !file.read(reinterpret_cast<char*>(vec.Data()), static_cast<std::streamsize>(header.m_Bytes)))
+        throw std::runtime_error("Tried opening a truncated or inconsistent file.");
+    if (Checksum64(vec.Data(), header.m_Bytes) != header.m_Checksum)
+        throw std::runtime_error("File checksum mismatch, the file is corrupted.");
+    if constexpr (std::is_same_v<T, bool>)
+        vec.MarkModified();
+    return vec;
+}
+
+#if defined(__linux__)
+// Read-only, zero-copy view of a file written by SaveVec(). Opening checks the header and maps the file; the elements
+// are read straight out of the page cache and pages are only faulted in when touched, so opening costs the same for
+// a kilobyte and for a gigabyte. Nothing scans the data on open: call Verify() to compare it against the checksum
+// when the file may have been damaged. ToVec() promotes the view to a mutable vector by copying it out, touching
+// every page once.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class FileView
+{
+private:
+    using ElementType = std::conditional_t<std::is_same_v<T, bool>, u64, T>;
+
+private:
+    void*              m_Map      = nullptr;
+    usize              m_MapSize  = 0;
+    const ElementType* m_Data     = nullptr;
+    usize              m_Size     = 0;
+    usize              m_Bytes    = 0;
+    u64                m_Checksum = 0;
+
+public:
+    FileView() = default;
+    explicit FileView(const char* path)
+    {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Could not open the file.");
+
+        struct stat status;
+        FileHeader  header;
+        if (::fstat(fd, &status) != 0 || ::pread(fd, &header, sizeof(header), 0) != sizeof(header))
+        {
+            ::close(fd);
+            throw std::runtime_error("Tried opening a file that is not a saved vector.");
+        }
+        try
+        {
+            header.Check(FileHeader::ElementSize<T>(), static_cast<usize>(status.st_size));
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+
+        // The mapping keeps the file alive on its own, the descriptor is not needed past this point.
+        m_MapSize = FileHeader::DataOffset + header.m_Bytes;
+        m_Map     = ::mmap(nullptr, m_MapSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (m_Map == MAP_FAILED)
+        {
+            m_Map = nullptr;
+            throw std::runtime_error("Could not map the file.");
+        }
+        m_Data     = reinterpret_cast<const ElementType*>(static_cast<const u8*>(m_Map) + FileHeader::DataOffset);
+        m_Size     = header.m_Size;
+        m_Bytes    = header.m_Bytes;
+        m_Checksum = header.m_Checksum;
+    }
+    FileView(const FileView&) = delete;
+    FileView(FileView&& other) noexcept { Swap(other); }
+    ~FileView()
+    {
+        if (m_Map)
+            ::munmap(m_Map, m_MapSize);
+    }
+
+public:
+    FileView& operator=(const FileView&) = delete;
+    FileView& operator=(FileView&& other) noexcept
+    {
+        FileView temp(std::move(other));
+        Swap(temp);
+        return *this;
+    }
+
+public:
+    constexpr usize              Size() const noexcept { return m_Size; }
+    constexpr bool               Empty() const noexcept { return m_Size == 0; }
+    // The elements, or the words of the bits for FileView<bool>.
+    constexpr const ElementType* Data() const noexcept { return m_Data; }
+    constexpr usize              Bytes() const noexcept { return m_Bytes; }
+
+public:
+    inline const T* begin() const noexcept
+        requires(!std::is_same_v<T, bool>)
+    {
+        return m_Data;
+    }
+    inline const T* end() const noexcept
+        requires(!std::is_same_v<T, bool>)
+    {
+        return m_Data + m_Size;
+    }
+
+public:
+    inline T operator[](const usize index) const noexcept
+    {
+        if constexpr (std::is_same_v<T, bool>)
+            return (m_Data[index / 64] >> (index % 64)) & 1;
+        else
+            return m_Data[index];
+    }
+    inline T At(const usize index) const
+    {
+        if (index >= m_Size)
+            throw std::out_of_range("Index out of bounds.");
+        return (*this)[index];
+    }
+    // Hashes the mapped data and compares it against the checksum saved in the header, reading the whole file.
+    inline bool Verify() const noexcept { return Checksum64(m_Data, m_Bytes) == m_Checksum; }
+    // Hints the kernel to start reading the whole file in the background.
+    inline void WillNeed() const noexcept
+    {
+        if (m_Map)
+            ::madvise(m_Map, m_MapSize, MADV_WILLNEED);
+    }
+    template <typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+    Vec<T, TAlloc, TGrowth> ToVec(const TAlloc& alloc = TAlloc()) const
+    {
+        Vec<T, TAlloc, TGrowth> vec(alloc);
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            vec.Resize(m_Size);
+            vec.MarkModified();
+        }
+        else
+            vec.ResizeForOverwrite(m_Size);
+        if (m_Bytes)
+            std::memcpy(vec.Data(), m_Data, m_Bytes);
+        return vec;
+    }
+    inline void Swap(FileView& other) noexcept
+    {
+        std::swap(m_Map, other.m_Map);
+        std::swap(m_MapSize, other.m_MapSize);
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Bytes, other.m_Bytes);
+        std::swap(m_Checksum, other.m_Checksum);
+    }
+};
+#endif
+
+// Streamed vectors start with a StreamHeader, followed by chunks that each carry a ChunkHeader and then their data.
+// A chunk whose count is 0 ends the stream, so a stream cut short anywhere fails to read instead of coming back
+// shorter. Each chunk's checksum is seeded with the chunk's index, which also catches chunks that were dropped or
+// reordered. Like FileHeader, the format uses native byte order and stores a Vec<bool> as words.
+struct StreamHeader
+{
+    static constexpr char Magic[8] = { 'V', 'E', 'C', 'S', 'T', 'R', 'M', '\0' };
+    static constexpr u32  Version  = 1;
+
+    char m_Magic[8]    = {};
+    u32  m_Version     = 0;
+    u32  m_ElementSize = 0;
+};
+struct ChunkHeader
+{
+    u64 m_Count    = 0;
+    u64 m_Bytes    = 0;
+    u64 m_Checksum = 0;
+};
+
+// Writes a stream of T (or of bits, for bool) in chunks of about chunkBytes. A background thread does all the writing:
+// while it writes one chunk buffer out, the producer fills and checksums the other, so a producer that keeps up with
+// the disk runs at disk speed. Memory stays at two chunk buffers however long the stream gets. The producer blocks
+// when both buffers are full. A failed write is rethrown by the producer's next Append(), Push() or Finish().
+// Finish() ends the stream; a writer destroyed without it stops without writing the end marker, so readers reject
+// the partial stream.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class ChunkWriter
+{
+private:
+    static constexpr bool IsBits = std::is_same_v<T, bool>;
+    using ElementType            = std::conditional_t<IsBits, u64, T>;
+
+public:
+    static constexpr usize DefaultChunkBytes = 4 << 20;
+
+private:
+    std::ostream&           m_Stream;
+    usize                   m_ChunkSize = 0;
+    Vec<ElementType>        m_Buffers[2];
+    usize                   m_Current = 0;
+    usize                   m_Filled  = 0;
+    u64                     m_Chunks  = 0;
+    ChunkHeader             m_Headers[2];
+    bool                    m_InFlight[2] = {};
+    std::deque<usize>       m_Queue;
+    bool                    m_Done = false;
+    std::exception_ptr      m_Error;
+    std::mutex              m_Mutex;
+    std::condition_variable m_Changed;
+    std::thread             m_Thread;
+
+public:
+    explicit ChunkWriter(std::ostream& stream, const usize chunkBytes = DefaultChunkBytes)
+        : m_Stream(stream), m_ChunkSize(std::max<usize>(chunkBytes / sizeof(ElementType), 1) * (IsBits ? 64 : 1))
+    {
+        StreamHeader header;
+        std::memcpy(header.m_Magic, StreamHeader::Magic, sizeof(StreamHeader::Magic));
+        header.m_Version     = StreamHeader::Version;
+        header.m_ElementSize = FileHeader::ElementSize<T>();
+        if (!m_Stream.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+            throw std::runtime_error("Could not write the stream.");
+
+        for (auto& buffer : m_Buffers)
+            buffer.Resize(Units(m_ChunkSize));
+        m_Thread = std::thread([this] { WriterLoop(); });
+    }
+    ChunkWriter(const ChunkWriter&)            = delete;
+    ChunkWriter& operator=(const ChunkWriter&) = delete;
+    ~ChunkWriter() { Stop(); }
+
+public:
+    // Elements (or bits) per chunk.
+    constexpr usize ChunkSize() const noexcept { return m_ChunkSize; }
+
+public:
+    void Push(const T value)
+    {
+        if constexpr (IsBits)
+            m_Buffers[m_Current][m_Filled / 64] |= u64(value) << (m_Filled % 64);
+        else
+            m_Buffers[m_Current][m_Filled] = value;
+        if (++m_Filled == m_ChunkSize)
+            Submit();
+    }
+    void Append(const T* data, usize count)
+        requires(!IsBits)
+    {
+        while (count > 0)
+        {
+            const usize take = std::min(count, m_ChunkSize - m_Filled);
+            std::memcpy(m_Buffers[m_Current].Data() + m_Filled, data, take * sizeof(T));
+            data += take;
+            count -= take;
+            if ((m_Filled += take) == m_ChunkSize)
+                Submit();
+        }
+    }
+    // Appends the first bits bits of words, LSB-first like Vec<bool>. Whole words are copied while the stream is at
+    // a word boundary, which it stays at unless bits are pushed one by one.
+    void AppendBits(const u64* words, const usize bits)
+        requires IsBits
+    {
+        usize done = 0;
+        while (m_Filled % 64 == 0 && bits - done >= 64)
+        {
+            const usize take = std::min(bits - done, m_ChunkSize - m_Filled) / 64;
+            std::memcpy(m_Buffers[m_Current].Data() + m_Filled / 64, words + done / 64, take * sizeof(u64));
+            done += take * 64;
+            if ((m_Filled += take * 64) == m_ChunkSize)
+                Submit();
+        }
+        for (; done < bits; ++done)
+            Push((words[done / 64] >> (done % 64)) & 1);
+    }
+    template <typename TAlloc, typename TGrowth>
+    void Append(const Vec<T, TAlloc, TGrowth>& vec)
+    {
+        if constexpr (IsBits)
+            AppendBits(vec.Data(), vec.Size());
+        else
+            Append(vec.Data(), vec.Size());
+    }
+    // Writes out what is buffered and the end marker, waiting for the background thread to finish.
+    void Finish()
+    {
+        if (m_Filled > 0)
+            Submit();
+        Stop();
+
+        const ChunkHeader end;
+        if (m_Error || !m_Stream.write(reinterpret_cast<const char*>(&end), sizeof(end)) || !m_Stream.flush())
+            throw std::runtime_error("Could not write the stream.");
+    }
+
+private:
+    static constexpr usize Units(const usize count) noexcept { return IsBits ? (count + 63) / 64 : count; }
+    // Hands the current buffer to the background thread and waits for the other one to come back.
+    void Submit()
+    {
+        ChunkHeader& header = m_Headers[m_Current];
+        header.m_Count      = m_Filled;
+        header.m_Bytes      = Units(m_Filled) * sizeof(ElementType);
+        header.m_Checksum   = Checksum64(m_Buffers[m_Current].Data(), header.m_Bytes, m_Chunks++);
+
+        std::unique_lock lock(m_Mutex);
+        if (m_Error)
+            std::rethrow_exception(m_Error);
+        m_InFlight[m_Current] = true;
+        m_Queue.push_back(m_Current);
+        m_Changed.notify_all();
+
+        m_Current = 1 - m_Current;
+        m_Filled  = 0;
+        m_Changed.wait(lock, [this] { return !m_InFlight[m_Current] || m_Error; });
+        if (m_Error)
+            std::rethrow_exception(m_Error);
+        if constexpr (IsBits)
+            std::memset(m_Buffers[m_Current].Data(), 0, m_Buffers[m_Current].Size() * sizeof(u64));
+    }
+    void Stop() noexcept
+    {
+        if (!m_Thread.joinable())
+            return;
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Done = true;
+        }
+        m_Changed.notify_all();
+        m_Thread.join();
+    }
+    void WriterLoop() noexcept
+    {
+        std::unique_lock lock(m_Mutex);
+        while (true)
+        {
+            m_Changed.wait(lock, [this] { return !m_Queue.empty() || m_Done; });
+            if (m_Queue.empty())
+                return;
+
+            const usize index = m_Queue.front();
+            m_Queue.pop_front();
+            lock.unlock();
+            const ChunkHeader& header = m_Headers[index];
+            const bool         failed =
+                !m_Stream.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+                !m_Stream.write(reinterpret_cast<const char*>(m_Buffers[index].Data()), header.m_Bytes);
+            lock.lock();
+
+            if (failed && !m_Error)
+                m_Error = std::make_exception_ptr(std::runtime_error("Could not write the stream."));
+            m_InFlight[index] = false;
+            m_Changed.notify_all();
+        }
+    }
+};
+
+// Writes vec to stream in chunks through a ChunkWriter, overlapping checksumming with the writes.
+template <typename T, typename TAlloc, typename TGrowth>
+    requires std::is_trivially_copyable_v<T>
+void WriteVec(const Vec<T, TAlloc, TGrowth>& vec, std::ostream& stream,
+              const usize chunkBytes = ChunkWriter<T>::DefaultChunkBytes)
+{
+    ChunkWriter<T> writer(stream, chunkBytes);
+    writer.Append(vec);
+    writer.Finish();
+}
+
+// Reads a stream written by a ChunkWriter, verifying every chunk as it arrives. Chunks are read straight into the
+// vector's buffer. A chunk's count is only trusted as far as its data actually arrives: the buffer grows by at most
+// one default chunk ahead of what has been read, so a corrupted count fails at the read instead of allocating
+// whatever it claims.
+template <typename T, typename TAlloc = HeapAllocator, typename TGrowth = GrowthDouble>
+    requires std::is_trivially_copyable_v<T>
+Vec<T, TAlloc, TGrowth> ReadVec(std::istream& stream, const TAlloc& alloc = TAlloc())
+{
+    constexpr bool IsBits    = std::is_same_v<T, bool>;
+    constexpr u64  StepCount = IsBits ? ChunkWriter<T>::DefaultChunkBytes * 8
+                                      : std::max<u64>(1, ChunkWriter<T>::DefaultChunkBytes / sizeof(T));
+
+    StreamHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.m_Magic, StreamHeader::Magic, sizeof(StreamHeader::Magic)) != 0 ||
+        header.m_Version != StreamHeader::Version)
+        throw std::runtime_error("Tried reading a stream that is not a written vector.");
+    if (header.m_ElementSize != FileHeader::ElementSize<T>())
+        throw std::runtime_error("Tried reading a stream written with a different element type.");
+
+    Vec<T, TAlloc, TGrowth> vec(alloc);
+    for (u64 index = 0;; ++index)
+    {
+        ChunkHeader chunk;
+        if (!stream.read(reinterpret_cast<char*>(&chunk), sizeof(chunk)))
+            throw std::runtime_error("Tried reading a truncated or inconsistent stream.");
+        if (chunk.m_Count == 0)
+            break;
+
+        // Only the last chunk of bits may end inside a word, the next one would have to start there.
+        const usize offset = vec.Size();
+        const u64   limit  = std::numeric_limits<u64>::max() / (IsBits ? 1 : sizeof(T));
+        if (chunk.m_Count > limit - offset || (IsBits && offset % 64 != 0))
+            throw std::runtime_error("Tried reading a truncated or inconsistent stream.");
+        const u64 bytes = IsBits ? (chunk.m_Count / 64 + (chunk.m_Count % 64 != 0)) * sizeof(u64)
+                                 : chunk.m_Count * sizeof(T);
+        if (chunk.m_Bytes != bytes)
+            throw std::runtime_error("Tried reading a truncated or inconsistent stream.");
+
+        for (u64 done = 0; done < chunk.m_Count;)
+        {
+            const u64 take = std::min(StepCount, chunk.m_Count - done);
+            char*     data;
+            u64       stepBytes;
+            if constexpr (IsBits)
+            {
+                vec.Resize(offset + done + take);
+                data      = reinterpret_cast<char*>(vec.Data() + (offset + done) / 64);
+                stepBytes = (take / 64 + (take % 64 != 0)) * sizeof(u64);
+            }
+            else
+            {
+                vec.ResizeForOverwrite(offset + done + take);
+                data      = reinterpret_cast<char*>(vec.Data() + offset + done);
+                stepBytes = take * sizeof(T);
+            }
+            if (!stream.read(data, static_cast<std::streamsize>(stepBytes)))
+                throw std::runtime_error("Tried reading a truncated or inconsistent stream.");
+            done += take;
+        }
+
+        const void* data = IsBits ? static_cast<const void*>(vec.Data() + offset / 64)
+                                  : static_cast<const void*>(vec.Data() + offset);
+        if (Checksum64(data, bytes, index) != chunk.m_Checksum)
+            throw std::runtime_error("Stream checksum mismatch, the stream is corrupted.");
+    }
+    if constexpr (IsBits)
+    {
+        // Keep the bits past Size() zero even if the writer did not.
+        if (vec.Size() % 64)
+            vec.Data()[vec.Size() / 64] &= (u64(1) << (vec.Size() % 64)) - 1;
+        vec.MarkModified();
+    }
+    return vec;
+}
+
+void TestVec()
+{
+    Vec<int> vec;
+    Vec<int> vec2 = { 5, 3, 1 };
+    for (usize i = 0; i < 9; ++i)
+        vec.Push(std::rand() % 256);
+
+    std::cout << "Initial vec: " << vec << std::endl;
+    std::cout << "Initial vec2: " << vec2 << std::endl;
+
+    vec.Swap(vec2);
+
+    std::cout << "\nAfter swap vec: " << vec << std::endl;
+    std::cout << "InAfter swap vec2: " << vec2 << std::endl;
+
+    std::cout << "\nvec ptr: " << vec.Data() << std::endl;
+
+    vec.Clear();
+    std::cout << "\nAfter vec clear: " << vec << std::endl;
+
+    vec = { 1, 5, 10, 9 };
+    std::cout << "\nInit cap: " << vec.Capacity() << std::endl;
+    vec.ShrinkToFit();
+    std::cout << "After cap: " << vec.Capacity() << std::endl;
+
+    std::cout << "\nBefore list assign: " << vec << std::endl;
+    vec.Assign({ 9, 10, 5, 1 });
+    std::cout << "After list assign: " << vec << std::endl;
+
+    std::cout << "\nBefore vec assign: " << vec << std::endl;
+    vec2 = { 5, 1, 6, 10, 8 };
+    std::cout << "vec2: " << vec2 << std::endl;
+    vec.Assign(vec2.begin() + 2, vec2.end() - 1);
+    std::cout << "After vec assign: " << vec << std::endl;
+
+    vec.Insert(vec.end(), 88);
+    std::cout << "\nAfter insert: ";
+    std::cout << vec << std::endl;
+    vec.Clear();
+    vec.ShrinkToFit();
+    vec.Assign({ 1, 5, 10, 99, 199 });
+    std::cout << "\nAfter total reset: " << vec << std::endl;
+
+    vec.Resize(vec.Size() / 2);
+    std::cout << "\nAfter resize: " << vec << std::endl;
+
+    std::cout << "\nvec2: " << vec2 << std::endl;
+    vec << vec2;
+    std::cout << "After merge: " << vec << std::endl;
+
+    vec.Erase(vec.begin() + 3);
+    std::cout << "\nAfter erasing the third element: " << vec << std::endl;
+    vec.Erase(vec.begin() + 1, vec.begin() + 4);
+    std::cout << "After first elements: " << vec << std::endl;
+
+    std::cout << "\nMax is: " << vec.MinMax().second << std::endl;
+
+    std::cout << "\nvec: " << vec << std::endl;
+    std::cout << "vec2: " << vec2 << std::endl;
+    vec2 = vec;
+    vec  = { 1, 1, 1, 1 };
+    std::cout << "vec2 after copy assigning to: " << vec2 << std::endl;
+    std::cout << "vec: " << vec << std::endl;
+    vec = std::move(vec2);
+    std::cout << "vec2 after move assign: " << vec2 << std::endl;
+    std::cout << "vec: " << vec << std::endl;
+
+    vec2 = { 5, 5, 1, 6, 7 };
+    std::cout << "\nvec: " << vec << std::endl;
+    std::cout << "vec2: " << vec2 << std::endl;
+    vec.Insert(vec.begin() + 1, vec2.begin() + 1, vec2.begin() + 3);
+    std::cout << "vec after inserting vec2's range (at 1 range: 2..5): " << vec << std::endl;
+}
+
+void TestBitset()
+{
+    Vec<bool> vec  = { 1, 0, 1, 0, 0, 1, 1, 0, 0 };
+    Vec<bool> vec1 = { 1, 1, 1, 0, 0, 1, 1, 0, 1 };
+    vec << vec1;
+    std::cout << vec.ToString() << std::endl;
+    vec <<= 3;
+    std::cout << vec.ToString() << std::endl;
+    vec >>= 1;
+    std::cout << vec.ToString() << std::endl;
+}
+
+template <typename TException, typename TFn>
+bool Throws(TFn&& fn)
+{
+    try
+    {
+        fn();
+    }
+    catch (const TException&)
+    {
+        return true;
+    }
+    return false;
+}
+
+void TestInsertErase()
+{
+    Vec<int> vec;
+    vec.Insert(vec.end(), 3);
+    vec.Insert(vec.begin(), 1);
+    vec.Insert(vec.begin() + 1, 2);
+    const Vec<int> tail = { 4, 5 };
+    vec.Insert(vec.end(), tail.begin(), tail.end());
+    assert(vec.Size() == 5);
+    for (usize i = 0; i < vec.Size(); ++i)
+        assert(vec[i] == static_cast<int>(i) + 1);
+    vec.Erase(vec.begin());
+    vec.Erase(vec.end() - 1);
+    assert(vec.Size() == 3 && vec.Front() == 2 && vec.Back() == 4);
+    vec.Erase(vec.begin(), vec.end());
+    assert(vec.Empty());
+    assert(Throws<std::out_of_range>([&] { vec.Erase(vec.begin()); }));
+
+    // Inserting an element of the vector itself has to see the value from before the shift.
+    Vec<std::string> strings = { "a", "b", "c" };
+    for (usize i = 0; i < 64; ++i)
+        strings.Insert(strings.begin(), strings[strings.Size() - 1]);
+    assert(strings.Size() == 67 && strings.Front() == "c" && strings.Back() == "c");
+    strings.Insert(strings.begin() + 1, strings.begin() + 60, strings.end());
+    assert(strings.Size() == 74 && strings[5] == "a" && strings[6] == "b" && strings[7] == "c");
+    strings.Emplace(strings.begin() + 2, 3, 'x');
+    assert(strings[2] == "xxx" && strings.Size() == 75);
+    strings.Erase(strings.begin() + 1, strings.end() - 1);
+    assert(strings.Size() == 2 && strings[0] == "c" && strings[1] == "c");
+}
+
+void TestEmptyVec()
+{
+    Vec<int> empty;
+    assert(empty.Empty() && empty.Size() == 0 && empty.Capacity() == 0 && empty.Data() == nullptr);
+    assert(empty.begin() == empty.end());
+    assert(Throws<std::out_of_range>([&] { (void)empty.At(0); }));
+    assert(Throws<std::out_of_range>([&] { (void)empty.Back(); }));
+    assert(Throws<std::out_of_range>([&] { (void)empty.Front(); }));
+    assert(Throws<std::out_of_range>([&] { (void)empty.Pop(); }));
+
+    Vec<int> zero(0);
+    zero.Reserve(0);
+    zero.Resize(0);
+    zero.ShrinkToFit();
+    assert(zero.Empty() && zero.Data() == nullptr);
+    Vec<int> copy = zero;
+    Vec<int> moved(std::move(copy));
+    assert(copy.Empty() && moved.Empty() && moved.Data() == nullptr);
+    moved = empty;
+    moved = std::move(zero);
+    assert(moved.Empty());
+
+    Vec<std::string> strings(3);
+    assert(strings.At(2).empty() && Throws<std::out_of_range>([&] { (void)strings.At(3); }));
+    strings.Clear();
+    assert(strings.Empty() && strings.Capacity() >= 3);
+}
+
+// Copies throw once the budget runs out, to check that a failed insert leaves the vector as it was.
+struct ThrowingCopy
+{
+    static inline int s_CopyBudget = 0;
+    static inline int s_Live       = 0;
+    int               m_Value      = 0;
+
+    ThrowingCopy(const int value) : m_Value(value) { ++s_Live; }
+    ThrowingCopy(const ThrowingCopy& other) : m_Value(other.m_Value)
+    {
+        if (s_CopyBudget-- <= 0)
+            throw std::bad_alloc();
+        ++s_Live;
+    }
+    ThrowingCopy(ThrowingCopy&& other) noexcept : m_Value(other.m_Value) { ++s_Live; }
+    ~ThrowingCopy() { --s_Live; }
+};
+
+void TestInsertExceptionSafety()
+{
+    {
+        Vec<ThrowingCopy> vec;
+        vec.Reserve(16);
+        for (int i = 0; i < 8; ++i)
+            vec.EmplaceBack(i);
+        const ThrowingCopy value(100);
+        const auto         unchanged = [&]
+        {
+            if (vec.Size() != 8)
+                return false;
+            for (int i = 0; i < 8; ++i)
+                if (vec[i].m_Value != i)
+                    return false;
+            return true;
+        };
+
+        // In place, then through a reallocation.
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            if (pass == 1)
+                vec.ShrinkToFit();
+            ThrowingCopy::s_CopyBudget = 0;
+            assert(Throws<std::bad_alloc>([&] { vec.Insert(vec.begin() + 3, value); }));
+            assert(unchanged());
+            ThrowingCopy::s_CopyBudget = 2;
+            assert(Throws<std::bad_alloc>([&] { vec.Insert(vec.begin() + 1, vec.begin() + 2, vec.begin() + 6); }));
+            assert(unchanged());
+            ThrowingCopy::s_CopyBudget = 0;
+            assert(Throws<std::bad_alloc>([&] { vec.Emplace(vec.begin() + 5, value); }));
+            assert(Throws<std::bad_alloc>([&] { vec.EmplaceBack(value); }));
+            assert(unchanged());
+        }
+    }
+    assert(ThrowingCopy::s_Live == 0);
+}
+
+void TestAllocators()
+{
+    MonotonicArena            arena(4096);
+    Vec<u32, ArenaAllocator>  arenaVec{ ArenaAllocator(arena) };
+    FixedPool                 pool(64);
+    Vec<u32, PoolAllocator>   poolVec{ PoolAllocator(pool) };
+    Vec<bool, ArenaAllocator> arenaBits{ ArenaAllocator(arena) };
+    for (u32 i = 0; i < 1000; ++i)
+    {
+        arenaVec.Push(i);
+        poolVec.Push(i);
+        arenaBits.Push(i % 3 == 0);
+    }
+    for (u32 i = 0; i < 1000; ++i)
+        assert(arenaVec[i] == i && poolVec[i] == i && arenaBits[i] == (i % 3 == 0));
+    assert(arenaBits.Count() == 334 && arena.HeapAllocCount() > 0);
+
+    // Copies allocate from the same arena, and small vectors come out of the pool's blocks.
+    const Vec<u32, ArenaAllocator> copy = arenaVec;
+    assert(copy.Size() == 1000 && copy.Back() == 999);
+    for (usize round = 0; round < 100; ++round)
+    {
+        Vec<u32, PoolAllocator> small{ PoolAllocator(pool) };
+        small.Push(static_cast<u32>(round));
+        assert(small.Back() == round);
+    }
+    assert(pool.HeapAllocCount() == 1);
+}
+
+void TestGrowthPolicies()
+{
+    Vec<u32, HeapAllocator, GrowthPowerOfTwo<>> pow2;
+    Vec<u32, HeapAllocator, GrowthSizeClass<>>  sized;
+    for (u32 i = 0; i < 1000; ++i)
+    {
+        pow2.Push(i);
+        sized.Push(i);
+        assert(std::has_single_bit(pow2.Capacity()));
+        assert(sized.Capacity() >= sized.Size());
+    }
+
+    // Shrinking only kicks in below a quarter of the capacity, and then keeps room to grow again.
+    Vec<u32> vec;
+    vec.Resize(1000);
+    assert(vec.Capacity() == 1000);
+    vec.Resize(251);
+    assert(vec.Capacity() == 1000);
+    vec.Resize(249);
+    assert(vec.Capacity() < 1000 && vec.Capacity() >= 249);
+
+    // A run of one-element resizes is amortized like Push().
+    Vec<u32>::ResetAllocCount();
+    Vec<u32> grown;
+    for (usize i = 1; i <= 100000; ++i)
+        grown.Resize(i);
+    assert(Vec<u32>::AllocCount() < 40);
+
+    Vec<u32, HeapAllocator, GrowthFactor<1, 1, 0>> noShrink(100);
+    noShrink.Resize(1);
+    assert(noShrink.Capacity() >= 100);
+}
+
+void TestSmallVec()
+{
+    using Small = SmallVec<std::string, 4>;
+    static_assert(std::is_nothrow_move_constructible_v<Small> && std::is_nothrow_move_assignable_v<Small>);
+
+    Small::ResetAllocCount();
+    Small small = { "x", "y" };
+    Small moved(std::move(small));
+    assert(moved.IsInline() && moved.Size() == 2 && moved[1] == "y");
+    assert(small.IsInline() && small.Empty() && small.Capacity() == Small::InlineCapacity());
+    Small copy(moved);
+    assert(copy.IsInline() && copy[0] == "x");
+    assert(Small::AllocCount() == 0);
+
+    for (usize i = 0; i < 8; ++i)
+        moved.Push("z");
+    assert(!moved.IsInline() && moved.Size() == 10 && Small::AllocCount() > 0);
+    small = std::move(moved);
+    assert(small.Size() == 10 && small.Back() == "z" && moved.IsInline() && moved.Empty());
+    moved = std::move(copy);
+    assert(moved.IsInline() && moved.Size() == 2 && copy.IsInline() && copy.Empty());
+    small.Resize(1);
+    small.ShrinkToFit();
+    assert(small.Size() == 1 && small[0] == "x");
+}
+
+// Squares below 16, built entirely at compile time.
+constexpr InlineVec<u32, 16> SquaresTable()
+{
+    InlineVec<u32, 16> table;
+    for (u32 i = 1; i < 16; ++i)
+        table.Push(i * i);
+    table.Insert(table.begin(), 0);
+    return table;
+}
+
+void TestInlineVec()
+{
+    constexpr InlineVec<u32, 16> squares = SquaresTable();
+    static_assert(squares.Size() == 16 && squares.Full());
+    static_assert(squares[0] == 0 && squares[15] == 225 && squares.Back() == 225);
+    static_assert(
+        []
+        {
+            InlineVec<int, 8, OverflowPolicy::ReturnFalse> vec = { 3, 1, 2 };
+            vec.Resize(5);
+            vec.Pop();
+            return vec.Size() == 4 && vec[0] == 3 && vec[3] == 0;
+        }());
+
+    InlineVec<int, 2> throwing;
+    throwing.Push(1);
+    throwing.Push(2);
+    assert(Throws<std::length_error>([&] { throwing.Push(3); }));
+    assert(throwing.Size() == 2);
+
+    InlineVec<int, 3, OverflowPolicy::ReturnFalse> bounded;
+    assert(bounded.Push(1) && bounded.EmplaceBack(2) && bounded.Insert(bounded.begin(), 0));
+    assert(!bounded.Push(4) && !bounded.EmplaceBack(5) && !bounded.Insert(bounded.begin(), 6));
+    assert(!bounded.Resize(4) && bounded.Size() == 3);
+    assert(bounded[0] == 0 && bounded[1] == 1 && bounded[2] == 2);
+    bounded.Erase(bounded.begin() + 1);
+    const int more[] = { 7, 8 };
+    assert(!bounded.Insert(bounded.end(), more, more + 2) && bounded.Insert(bounded.end(), more, more + 1));
+    assert(bounded.Full() && bounded.Back() == 7);
+
+    // Within capacity the asserting policy behaves like the others.
+    InlineVec<int, 2, OverflowPolicy::Assert> asserting;
+    assert(asserting.Push(1) && asserting.Push(2) && asserting.Full());
+}
+
+void TestIterators()
+{
+    static_assert(std::contiguous_iterator<Vec<int>::Iterator> && std::contiguous_iterator<Vec<int>::ConstIterator>);
+    static_assert(std::random_access_iterator<Vec<bool>::Iterator>);
+    static_assert(std::random_access_iterator<Vec<bool>::ConstIterator>);
+    // A const Vec<bool> hands out plain bools, so it cannot be written through.
+    static_assert(!std::is_assignable_v<decltype(std::declval<const Vec<bool>&>()[0]), bool>);
+    static_assert(!std::is_assignable_v<decltype(*std::declval<const Vec<bool>&>().begin()), bool>);
+
+    Vec<int> vec = { 5, 3, 9, 1, 7 };
+    std::sort(vec.begin(), vec.end());
+    assert(std::is_sorted(vec.begin(), vec.end()) && vec.end() - vec.begin() == 5);
+    assert(*std::lower_bound(vec.cbegin(), vec.cend(), 6) == 7 && vec.begin()[2] == 5);
+    int raw[5];
+    std::copy(vec.begin(), vec.end(), raw);
+    assert(raw[0] == 1 && raw[4] == 9);
+
+    Vec<bool> bits = Vec<bool>::FromString("1100101");
+    std::sort(bits.begin(), bits.end());
+    assert(bits.ToString() == "0001111");
+    std::reverse(bits.begin(), bits.end());
+    assert(bits.ToString() == "1111000");
+    std::fill(bits.begin() + 1, bits.begin() + 3, false);
+    assert(bits.ToString() == "1001000" && std::count(bits.cbegin(), bits.cend(), true) == 2);
+    const Vec<bool>& view = bits;
+    assert(view[0] && !view[1] && view.Front() && !view.Back() && view.At(3));
+}
+
+// Runs fn once per SIMD level up to the one this machine supports, so every kernel family gets checked.
+template <typename TFn>
+void ForEachSimdLevel(TFn&& fn)
+{
+    for (const SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 })
+    {
+        LimitSimdLevel(level);
+        if (CurrentSimdLevel() == level)
+            fn();
+    }
+    LimitSimdLevel(SimdLevel::AVX512);
+}
+
+template <typename T>
+void TestSearchKernelsFor(std::mt19937_64& rng)
+{
+    using Sum = simd::SumType<T>;
+    for (usize size = 0; size < 300; size += 1 + size / 8)
+    {
+        Vec<T> lhv, rhv;
+        for (usize i = 0; i < size; ++i)
+        {
+            lhv.Push(static_cast<T>(rng() % 100));
+            rhv.Push(static_cast<T>(rng() % 100));
+        }
+        const T probe = static_cast<T>(rng() % 100), missing = static_cast<T>(100);
+
+        assert(lhv.Find(probe) - lhv.begin() == std::find(lhv.begin(), lhv.end(), probe) - lhv.begin());
+        assert(lhv.Find(missing) == lhv.end() && !lhv.Contains(missing));
+        assert(lhv.Count(probe) == static_cast<usize>(std::count(lhv.begin(), lhv.end(), probe)));
+        assert(lhv.Sum() == std::accumulate(lhv.begin(), lhv.end(), Sum{}));
+        Sum dot = 0;
+        for (usize i = 0; i < size; ++i)
+            dot += static_cast<Sum>(lhv[i]) * static_cast<Sum>(rhv[i]);
+        assert(lhv.Dot(rhv) == dot);
+        if (size > 0)
+        {
+            const auto [min, max] = std::minmax_element(lhv.begin(), lhv.end());
+            assert(lhv.MinMax() == std::make_pair(*min, *max));
+            assert(lhv.Contains(lhv.Back()) && lhv.Find(lhv.Back()) <= lhv.end() - 1);
+        }
+    }
+}
+
+void TestSearchKernels()
+{
+    std::mt19937_64 rng(8);
+    ForEachSimdLevel(
+        [&]
+        {
+            TestSearchKernelsFor<i8>(rng);
+            TestSearchKernelsFor<u16>(rng);
+            TestSearchKernelsFor<i32>(rng);
+            TestSearchKernelsFor<u64>(rng);
+            TestSearchKernelsFor<f32>(rng);
+            TestSearchKernelsFor<f64>(rng);
+        });
+    assert(Throws<std::invalid_argument>([] { (void)Vec<int>(2).Dot(Vec<int>(3)); }));
+}
+
+template <typename T>
+void TestRadixSortFor(std::mt19937_64& rng)
+{
+    for (const usize size : { usize{ 0 }, usize{ 1 }, usize{ 63 }, usize{ 64 }, usize{ 65 }, usize{ 5000 } })
+    {
+        Vec<T> vec;
+        for (usize i = 0; i < size; ++i)
+            vec.Push(static_cast<T>(rng()));
+        if (size > 2)
+        {
+            vec[0] = std::numeric_limits<T>::min();
+            vec[1] = std::numeric_limits<T>::max();
+        }
+        std::vector<T> ref(vec.begin(), vec.end());
+        std::sort(ref.begin(), ref.end());
+        vec.Sort();
+        assert(std::equal(ref.begin(), ref.end(), vec.begin()));
+    }
+}
+
+void TestRadixSort()
+{
+    std::mt19937_64 rng(9);
+    TestRadixSortFor<i8>(rng);
+    TestRadixSortFor<u8>(rng);
+    TestRadixSortFor<i16>(rng);
+    TestRadixSortFor<i32>(rng);
+    TestRadixSortFor<u32>(rng);
+    TestRadixSortFor<i64>(rng);
+    TestRadixSortFor<u64>(rng);
+
+    // Sorting by a signed key has to be stable, which the payload checks.
+    struct Record
+    {
+        i32   m_Key;
+        usize m_Order;
+    };
+    for (const usize size : { usize{ 50 }, usize{ 10000 } })
+    {
+        Vec<Record> records;
+        for (usize i = 0; i < size; ++i)
+            records.Push({ static_cast<i32>(rng() % 200) - 100, i });
+        std::vector<Record> ref(records.begin(), records.end());
+        std::stable_sort(ref.begin(), ref.end(),
+                         [](const Record& lhv, const Record& rhv) { return lhv.m_Key < rhv.m_Key; });
+        records.Sort([](const Record& record) { return record.m_Key; });
+        for (usize i = 0; i < size; ++i)
+            assert(records[i].m_Key == ref[i].m_Key && records[i].m_Order == ref[i].m_Order);
+    }
+}
+
+void TestParallel()
+{
+    ThreadPool      pool(3);
+    std::mt19937_64 rng(10);
+    for (const usize size : { usize{ 0 }, usize{ 1 }, usize{ 1000 }, usize{ 300001 } })
+    {
+        Vec<u32> vec;
+        for (usize i = 0; i < size; ++i)
+            vec.Push(static_cast<u32>(rng()));
+
+        const u64 sum = std::accumulate(vec.begin(), vec.end(), u64{ 0 });
+        const Vec<u64> widened = vec.ParallelTransform([](const u32 e) { return u64{ e }; }, pool);
+        assert(widened.ParallelReduce(0, std::plus<>(), pool) == sum);
+        // Not commutative, so the partial results have to be combined in order.
+        Vec<std::string> digits;
+        for (usize i = 0; i < std::min<usize>(size, 20000); ++i)
+            digits.Push(std::to_string(vec[i] % 10));
+        std::string concatenated;
+        for (const auto& digit : digits)
+            concatenated += digit;
+        assert(digits.ParallelReduce(std::string(), std::plus<>(), pool) == concatenated);
+
+        const Vec<u64> squares = vec.ParallelTransform([](const u32 e) { return u64{ e } * e; }, pool);
+        assert(squares.Size() == size);
+        for (usize i = 0; i < size; i += 1 + i / 16)
+            assert(squares[i] == u64{ vec[i] } * vec[i]);
+
+        std::vector<u32> ref(vec.begin(), vec.end());
+        std::sort(ref.begin(), ref.end(), std::greater<>());
+        vec.ParallelSort(std::greater<>(), pool);
+        assert(std::equal(ref.begin(), ref.end(), vec.begin()));
+
+        vec.ParallelFill(7, pool);
+        vec.ParallelForEach([](u32& e) { e *= 3; }, pool);
+        assert(vec.Count(21) == size);
+    }
+}
+
+std::vector<bool> RandomBits(const usize size, std::mt19937_64& rng)
+{
+    std::vector<bool> bits(size);
+    for (usize i = 0; i < size; ++i)
+        bits[i] = rng() & 1;
+    return bits;
+}
+
+template <typename TAlloc = HeapAllocator>
+Vec<bool, TAlloc> ToBitVec(const std::vector<bool>& bits)
+{
+    Vec<bool, TAlloc> vec(bits.size());
+    for (usize i = 0; i < bits.size(); ++i)
+        vec[i] = bits[i];
+    return vec;
+}
+
+std::vector<bool> ToStdBits(const Vec<bool>& vec)
+{
+    return std::vector<bool>(vec.begin(), vec.end());
+}
+
+// Compares against reference bits, index 0 first, and checks that the bits past Size() stayed zero.
+template <typename TAlloc, typename TGrowth>
+bool SameBits(const Vec<bool, TAlloc, TGrowth>& vec, const std::vector<bool>& ref)
+{
+    if (vec.Size() != ref.size())
+        return false;
+    for (usize i = 0; i < ref.size(); ++i)
+        if (vec[i] != ref[i])
+            return false;
+    return vec.Size() % 64 == 0 || (vec.Data()[vec.Size() / 64] >> (vec.Size() % 64)) == 0;
+}
+
+void TestBitCount()
+{
+    std::mt19937_64 rng(11);
+    for (const usize size : { 0, 1, 63, 64, 65, 200, 4097 })
+    {
+        for (int pattern = 0; pattern < 3; ++pattern)
+        {
+            std::vector<bool> ref = RandomBits(size, rng);
+            if (pattern < 2)
+                std::fill(ref.begin(), ref.end(), pattern == 1);
+            Vec<bool>   vec   = ToBitVec(ref);
+            const usize count = static_cast<usize>(std::count(ref.begin(), ref.end(), true));
+            assert(SameBits(vec, ref) && vec.Count() == count);
+            assert(vec.Any() == (count > 0) && vec.None() == (count == 0) && vec.All() == (count == size));
+            assert(Throws<std::out_of_range>([&] { (void)vec.At(size); }));
+
+            vec.Push(true);
+            assert(vec.Count() == count + 1 && vec.Back() && vec.Pop() && SameBits(vec, ref));
+            vec.Resize(size + 70);
+            ref.resize(size + 70);
+            assert(SameBits(vec, ref) && vec.Count() == count);
+        }
+    }
+
+    const Vec<bool> empty;
+    assert(empty.Count() == 0 && !empty.Any() && empty.None() && empty.All());
+    assert(Throws<std::out_of_range>([&] { (void)empty.At(0); }));
+    assert(Throws<std::out_of_range>([&] { (void)empty.Back(); }));
+}
+
+void TestBitwiseOps()
+{
+    std::mt19937_64 rng(12);
+    ForEachSimdLevel(
+        [&]
+        {
+            for (const usize size : { 0, 1, 64, 100, 257, 1000, 5000 })
+            {
+                for (const usize otherSize : { size, size / 2, size + 130 })
+                {
+                    const std::vector<bool> lhvBits = RandomBits(size, rng), rhvBits = RandomBits(otherSize, rng);
+                    const Vec<bool>         lhv = ToBitVec(lhvBits), rhv = ToBitVec(rhvBits);
+                    std::vector<bool>       andBits(size), orBits(size), xorBits(size), andNotBits(size), notBits(size);
+                    usize                   both = 0;
+                    for (usize i = 0; i < size; ++i)
+                    {
+                        const bool l = lhvBits[i], r = i < otherSize && rhvBits[i];
+                        andBits[i]    = l && r;
+                        orBits[i]     = l || r;
+                        xorBits[i]    = l != r;
+                        andNotBits[i] = l && !r;
+                        notBits[i]    = !l;
+                        both += l && r;
+                    }
+
+                    assert(SameBits(lhv & rhv, andBits) && SameBits(lhv | rhv, orBits));
+                    assert(SameBits(lhv ^ rhv, xorBits) && SameBits(lhv.AndNot(rhv), andNotBits));
+                    assert(SameBits(~lhv, notBits) && lhv.AndCount(rhv) == both);
+
+                    Vec<bool> out = Vec<bool>::FromString("1");
+                    lhv.OrInto(rhv, out);
+                    assert(SameBits(out, orBits));
+                    Vec<bool> self = lhv;
+                    self.XorInto(rhv, self);
+                    assert(SameBits(self, xorBits));
+                    Vec<bool> other = rhv;
+                    lhv.AndInto(other, other);
+                    assert(SameBits(other, andBits));
+                    self = lhv;
+                    self &= rhv;
+                    assert(SameBits(self, andBits));
+                    self = lhv;
+                    self |= rhv;
+                    assert(SameBits(self, orBits));
+                    self.AndNotAssign(rhv);
+                    assert(SameBits(self, andNotBits));
+                }
+            }
+        });
+}
+
+void TestBitShifts()
+{
+    std::mt19937_64 rng(13);
+    for (const usize size : { 0, 1, 63, 64, 65, 127, 128, 130, 1000, 9000, 20011 })
+    {
+        const std::vector<bool> ref = RandomBits(size, rng);
+        const Vec<bool>         vec = ToBitVec(ref);
+        for (const usize shift : { usize{ 0 }, usize{ 1 }, usize{ 63 }, usize{ 64 }, usize{ 65 }, size / 3 + 1, size / 2,
+                                   size ? size - 1 : 0, size, size + 1, usize{ 4096 }, usize{ 4097 } })
+        {
+            std::vector<bool> front(size), back(size), left(size), right(size);
+            for (usize i = 0; i < size; ++i)
+            {
+                front[i] = i + shift < size && ref[i + shift];
+                back[i]  = i >= shift && ref[i - shift];
+                left[i]  = ref[(i + shift) % size];
+                right[i] = ref[(i + size - shift % size) % size];
+            }
+            assert(SameBits(vec << shift, front) && SameBits(vec >> shift, back));
+
+            Vec<bool> rotated = vec;
+            rotated.RotateLeft(shift);
+            assert(SameBits(rotated, left));
+            rotated = vec;
+            rotated.RotateRight(shift);
+            assert(SameBits(rotated, right));
+        }
+    }
+}
+
+void TestBitSearch()
+{
+    std::mt19937_64 rng(14);
+    for (const usize size : { 0, 1, 63, 64, 65, 128, 200, 4097 })
+    {
+        for (int pattern = 0; pattern < 4; ++pattern)
+        {
+            std::vector<bool> ref = RandomBits(size, rng);
+            if (pattern < 2)
+                std::fill(ref.begin(), ref.end(), pattern == 1);
+            else if (pattern == 2)
+                for (usize i = 0; i < size; ++i)
+                    ref[i] = (rng() % 100) == 0;
+            const Vec<bool> vec = ToBitVec(ref);
+
+            std::vector<usize> ones;
+            usize              firstZero = Vec<bool>::NPos;
+            for (usize i = 0; i < size; ++i)
+            {
+                if (ref[i])
+                    ones.push_back(i);
+                else if (firstZero == Vec<bool>::NPos)
+                    firstZero = i;
+            }
+            assert(vec.FindFirst() == (ones.empty() ? Vec<bool>::NPos : ones.front()));
+            assert(vec.FindLast() == (ones.empty() ? Vec<bool>::NPos : ones.back()));
+            assert(vec.FindFirstZero() == firstZero);
+
+            for (usize i = 0; i < size; ++i)
+            {
+                const auto next = std::upper_bound(ones.begin(), ones.end(), i);
+                assert(vec.FindNext(i) == (next == ones.end() ? Vec<bool>::NPos : *next));
+            }
+            assert(vec.FindNext(size) == Vec<bool>::NPos);
+
+            std::vector<usize> visited;
+            vec.ForEachSetBit([&](const usize i) { visited.push_back(i); });
+            assert(visited == ones);
+            visited.clear();
+            for (const usize i : vec.SetBits())
+                visited.push_back(i);
+            assert(visited == ones);
+        }
+    }
+}
+
+void TestRankSelect()
+{
+    std::mt19937_64 rng(15);
+    for (const usize size : { 0, 1, 64, 511, 512, 513, 4096, 4097, 20000 })
+    {
+        for (int pattern = 0; pattern < 3; ++pattern)
+        {
+            std::vector<bool> ref = RandomBits(size, rng);
+            if (pattern < 2)
+                std::fill(ref.begin(), ref.end(), pattern == 1);
+            Vec<bool>        vec = ToBitVec(ref);
+            const RankSelect index(vec);
+            index.Build();
+
+            const auto check = [&]
+            {
+                std::vector<usize> ones, zeros;
+                for (usize i = 0; i < ref.size(); ++i)
+                {
+                    assert(index.Rank1(i) == ones.size() && index.Rank0(i) == zeros.size());
+                    (ref[i] ? ones : zeros).push_back(i);
+                }
+                assert(index.Rank1(ref.size()) == ones.size() && index.Rank0(ref.size()) == zeros.size());
+                for (usize k = 0; k < ones.size(); ++k)
+                    assert(index.Select1(k) == ones[k]);
+                for (usize k = 0; k < zeros.size(); ++k)
+                    assert(index.Select0(k) == zeros[k]);
+                assert(index.Select1(ones.size()) == RankSelect<>::NPos);
+                assert(index.Select0(zeros.size()) == RankSelect<>::NPos);
+            };
+            check();
+
+            // Writes move the generation on, so the next query rebuilds the directory.
+            for (usize i = 0; i < size; i += 97)
+            {
+                ref[i] = !ref[i];
+                vec[i] = ref[i];
+            }
+            vec.Push(true);
+            ref.push_back(true);
+            check();
+        }
+    }
+}
+
+void TestBitRanges()
+{
+    std::mt19937_64 rng(16);
+    for (const usize size : { 0, 1, 63, 64, 65, 200, 1000 })
+    {
+        for (int round = 0; round < 20; ++round)
+        {
+            std::vector<bool> ref = RandomBits(size, rng);
+            Vec<bool>         vec = ToBitVec(ref);
+            const usize       a = size ? rng() % (size + 1) : 0, b = size ? rng() % (size + 1) : 0;
+            const usize       first = std::min(a, b), last = std::max(a, b);
+
+            vec.SetRange(first, last);
+            std::fill(ref.begin() + first, ref.begin() + last, true);
+            assert(SameBits(vec, ref));
+            vec.FlipRange(first / 2, last);
+            for (usize i = first / 2; i < last; ++i)
+                ref[i] = !ref[i];
+            assert(SameBits(vec, ref));
+            vec.ResetRange(first, (first + last) / 2);
+            std::fill(ref.begin() + first, ref.begin() + (first + last) / 2, false);
+            assert(SameBits(vec, ref));
+
+            // Copies from another vector and from overlapping ranges of the same one.
+            const std::vector<bool> srcBits  = RandomBits(size + 77, rng);
+            const Vec<bool>         src      = ToBitVec(srcBits);
+            const usize             count    = last - first;
+            const usize             srcFirst = rng() % (srcBits.size() - count + 1);
+            vec.CopyRange(src, srcFirst, count, first);
+            std::copy(srcBits.begin() + srcFirst, srcBits.begin() + srcFirst + count, ref.begin() + first);
+            assert(SameBits(vec, ref));
+            const usize selfFirst = rng() % (size - count + 1);
+            vec.CopyRange(vec, first, count, selfFirst);
+            const std::vector<bool> moved(ref.begin() + first, ref.begin() + last);
+            std::copy(moved.begin(), moved.end(), ref.begin() + selfFirst);
+            assert(SameBits(vec, ref));
+
+            vec.Append(src);
+            ref.insert(ref.end(), srcBits.begin(), srcBits.end());
+            assert(SameBits(vec, ref));
+            vec.Append(vec);
+            const std::vector<bool> twice = ref;
+            ref.insert(ref.end(), twice.begin(), twice.end());
+            assert(SameBits(vec, ref));
+
+            assert(Throws<std::out_of_range>([&] { vec.SetRange(1, 0); }));
+            assert(Throws<std::out_of_range>([&] { vec.FlipRange(0, vec.Size() + 1); }));
+            assert(Throws<std::out_of_range>([&] { vec.CopyRange(src, src.Size(), 1, 0); }));
+        }
+    }
+
+    Vec<bool> bits = Vec<bool>::FromString("101");
+    bits << Vec<bool>::FromString("0110011");
+    assert(SameBits(bits, { 1, 0, 1, 0, 1, 1, 0, 0, 1, 1 }));
+}
+
+void TestAtomicBitVec()
+{
+    std::mt19937_64 rng(17);
+    for (const usize size : { 1, 63, 64, 65, 1000, 100000 })
+    {
+        // Every thread claims random bits; each bit that ends up set must have been claimed by exactly one of them.
+        constexpr usize    threadCount = 4;
+        AtomicBitVec       bits(size);
+        std::vector<usize> claims[threadCount];
+        std::vector<u64>   seeds;
+        for (usize t = 0; t < threadCount; ++t)
+            seeds.push_back(rng());
+        std::vector<std::thread> threads;
+        for (usize t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back(
+                [&, t]
+                {
+                    std::mt19937_64 local(seeds[t]);
+                    for (usize i = 0; i < 20000; ++i)
+                    {
+                        const usize index = local() % size;
+                        if (!bits.TestAndSet(index, (i & 1) ? std::memory_order_acq_rel : std::memory_order_relaxed))
+                            claims[t].push_back(index);
+                    }
+                });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        std::vector<bool> ref(size);
+        usize             claimed = 0;
+        for (usize t = 0; t < threadCount; ++t)
+        {
+            for (const usize index : claims[t])
+            {
+                assert(!ref[index]);
+                ref[index] = true;
+            }
+            claimed += claims[t].size();
+        }
+        assert(bits.Count() == claimed && SameBits(bits.ToVec(), ref));
+        for (usize i = 0; i < size; ++i)
+            assert(bits.Test(i) == ref[i]);
+
+        for (usize i = 0; i < size; i += 3)
+        {
+            assert(bits.TestAndReset(i) == ref[i]);
+            ref[i] = false;
+        }
+        assert(SameBits(bits.ToVec(), ref));
+        const usize first = size / 4, last = size - size / 4;
+        usize       newlySet = 0;
+        for (usize i = first; i < last; ++i)
+        {
+            newlySet += !ref[i];
+            ref[i] = true;
+        }
+        assert(bits.SetRange(first, last) == newlySet && SameBits(bits.ToVec(), ref));
+
+        const std::vector<bool> more = RandomBits(size + 70, rng);
+        newlySet                     = 0;
+        for (usize i = 0; i < size; ++i)
+        {
+            newlySet += more[i] && !ref[i];
+            ref[i] = ref[i] || more[i];
+        }
+        assert(bits.SetBits(ToBitVec(more)) == newlySet && SameBits(bits.ToVec(), ref));
+        assert(Throws<std::out_of_range>([&] { bits.SetRange(0, size + 1); }));
+        bits.Clear();
+        assert(bits.Count() == 0);
+    }
+}
+
+void TestCompressedBitmap()
+{
+    std::mt19937_64 rng(18);
+    constexpr usize size = 300000;
+    // Sparse, dense and run-heavy chunks side by side, plus an empty one.
+    const auto make = [&]
+    {
+        std::vector<bool> bits(size);
+        for (usize i = 0; i < size; ++i)
+        {
+            if (i < 65536)
+                bits[i] = rng() % 100 == 0;
+            else if (i < 131072)
+                bits[i] = rng() & 1;
+            else if (i < 196608)
+                bits[i] = (i / 1000) % 2;
+            else if (i >= 262144)
+                bits[i] = rng() % 5000 == 0;
+        }
+        return bits;
+    };
+    const std::vector<bool> lhvBits = make(), rhvBits = make();
+    const Vec<bool>         lhv = ToBitVec(lhvBits), rhv = ToBitVec(rhvBits);
+    const CompressedBitmap  a = CompressedBitmap::FromVec(lhv), b = CompressedBitmap::FromVec(rhv);
+    assert(a.Cardinality() == lhv.Count() && SameBits(a.ToVec(size), lhvBits));
+    assert(a.Max() == lhv.FindLast());
+
+    ForEachSimdLevel(
+        [&]
+        {
+            assert(SameBits((a & b).ToVec(size), ToStdBits(lhv & rhv)));
+            assert(SameBits((a | b).ToVec(size), ToStdBits(lhv | rhv)));
+            assert(SameBits((a ^ b).ToVec(size), ToStdBits(lhv ^ rhv)));
+            assert(SameBits(a.AndNot(b).ToVec(size), ToStdBits(lhv.AndNot(rhv))));
+            CompressedBitmap self = a;
+            self |= b;
+            self &= a;
+            assert(SameBits(self.ToVec(size), lhvBits));
+            self ^= a;
+            assert(self.Empty());
+        });
+
+    CompressedBitmap  built;
+    std::vector<bool> ref(size);
+    built.AddRange(140000, 150000);
+    for (usize i = 140000; i < 150000; ++i)
+        ref[i] = true;
+    for (usize i = 0; i < 20000; ++i)
+    {
+        const u32 value = static_cast<u32>(rng() % size);
+        built.Add(value);
+        ref[value] = true;
+    }
+    assert(SameBits(built.ToVec(size), ref));
+    for (u32 value = 0; value < size; ++value)
+        assert(built.Contains(value) == ref[value]);
+    built.Optimize();
+    assert(SameBits(built.ToVec(size), ref));
+
+    std::vector<usize> visited;
+    built.ForEachSetBit([&](const usize i) { visited.push_back(i); });
+    assert(visited.size() == built.Cardinality() && std::is_sorted(visited.begin(), visited.end()));
+    for (const usize i : visited)
+        assert(ref[i]);
+    assert(CompressedBitmap().Empty() && CompressedBitmap().ToVec(0).Empty());
+}
+
+template <usize Bits>
+void TestPackedVecFor(std::mt19937_64& rng)
+{
+    using Packed = PackedVec<Bits>;
+    for (const usize size : { 0, 1, 63, 64, 65, 1000 })
+    {
+        Vec<u64> ref;
+        for (usize i = 0; i < size; ++i)
+            ref.Push(rng() & Packed::MaxValue);
+
+        Packed pushed;
+        for (const u64 value : ref)
+            pushed.Push(value);
+        const Packed packed = Packed::FromVec(ref);
+        assert(packed == pushed && packed.Size() == size);
+        for (usize i = 0; i < size; ++i)
+            assert(packed[i] == ref[i] && packed.At(i) == ref[i]);
+        assert(Throws<std::out_of_range>([&] { (void)packed.At(size); }));
+        const Vec<u64> unpacked = packed.template ToVec<u64>();
+        assert(unpacked.Size() == size && std::equal(ref.begin(), ref.end(), unpacked.begin()));
+
+        // Assigning fewer values over a longer vector has to shrink it.
+        Packed shorter = packed;
+        shorter.Assign(ref.Data(), size / 2);
+        assert(shorter.Size() == size / 2 && std::equal(shorter.begin(), shorter.end(), ref.begin()));
+
+        if (size < 2)
+            continue;
+        pushed[1] = 0;
+        assert(pushed[1] == 0 && pushed[0] == ref[0] && (size < 3 || pushed[2] == ref[2]));
+        assert(pushed.Pop() == ref.Back());
+        pushed.Resize(1);
+        assert(pushed.Size() == 1 && pushed.Back() == ref[0]);
+        pushed.Clear();
+        assert(pushed.Empty() && Throws<std::out_of_range>([&] { (void)pushed.Pop(); }));
+    }
+}
+
+void TestPackedVec()
+{
+    std::mt19937_64 rng(19);
+    ForEachSimdLevel(
+        [&]
+        {
+            TestPackedVecFor<1>(rng);
+            TestPackedVecFor<7>(rng);
+            TestPackedVecFor<13>(rng);
+            TestPackedVecFor<32>(rng);
+            TestPackedVecFor<64>(rng);
+        });
+}
+
+template <simd::CmpOp Op, typename T>
+void CheckCompare(const Vec<T>& vec, const T value)
+{
+    const Vec<bool> mask = Compare<Op>(vec, value);
+    assert(mask.Size() == vec.Size());
+    for (usize i = 0; i < vec.Size(); ++i)
+        assert(mask[i] == simd::CompareOne<Op>(vec[i], value));
+    assert(vec.Size() % 64 == 0 || (mask.Data()[vec.Size() / 64] >> (vec.Size() % 64)) == 0);
+}
+
+template <typename T>
+void TestFilterKernelsFor(std::mt19937_64& rng)
+{
+    for (const usize size : { 0, 1, 15, 63, 64, 65, 200, 1000 })
+    {
+        // A small value range so that every comparison has hits, with the extremes of T mixed in.
+        Vec<T> vec;
+        for (usize i = 0; i < size; ++i)
+        {
+            const u64 pick = rng() % 20;
+            if (pick == 0)
+                vec.Push(std::numeric_limits<T>::lowest());
+            else if (pick == 1)
+                vec.Push(std::numeric_limits<T>::max());
+            else if (pick == 2 && std::is_floating_point_v<T>)
+                vec.Push(std::numeric_limits<T>::quiet_NaN());
+            else
+                vec.Push(static_cast<T>(static_cast<i64>(pick) - 10));
+        }
+        for (const T value : { T(0), T(3), std::numeric_limits<T>::lowest(), std::numeric_limits<T>::max() })
+        {
+            CheckCompare<simd::CmpOp::Equal>(vec, value);
+            CheckCompare<simd::CmpOp::NotEqual>(vec, value);
+            CheckCompare<simd::CmpOp::Less>(vec, value);
+            CheckCompare<simd::CmpOp::LessEqual>(vec, value);
+            CheckCompare<simd::CmpOp::Greater>(vec, value);
+            CheckCompare<simd::CmpOp::GreaterEqual>(vec, value);
+        }
+
+        for (int density = 0; density < 4; ++density)
+        {
+            Vec<bool> mask(size);
+            Vec<T>    ref;
+            for (usize i = 0; i < size; ++i)
+            {
+                mask[i] = (density == 3) || (density > 0 && rng() % 3 < static_cast<u64>(density));
+                if (mask[i])
+                    ref.Push(vec[i]);
+            }
+            Vec<T> out = vec;
+            CompactInto(vec, mask, out);
+            // Compared bytewise, NaN is never equal to itself.
+            assert(out.Size() == ref.Size());
+            assert(ref.Empty() || std::memcmp(out.Data(), ref.Data(), ref.Size() * sizeof(T)) == 0);
+        }
+        assert(Throws<std::invalid_argument>([&] { (void)Compact(vec, Vec<bool>(size + 1)); }));
+    }
+}
+
+void TestFilterKernels()
+{
+    std::mt19937_64 rng(20);
+    ForEachSimdLevel(
+        [&]
+        {
+            TestFilterKernelsFor<i8>(rng);
+            TestFilterKernelsFor<u8>(rng);
+            TestFilterKernelsFor<i16>(rng);
+            TestFilterKernelsFor<u16>(rng);
+            TestFilterKernelsFor<i32>(rng);
+            TestFilterKernelsFor<u32>(rng);
+            TestFilterKernelsFor<i64>(rng);
+            TestFilterKernelsFor<u64>(rng);
+            TestFilterKernelsFor<f32>(rng);
+            TestFilterKernelsFor<f64>(rng);
+        });
+}
+
+#if defined(__linux__)
+// Counts how the vector asks for memory, so the test can tell mremap growth from allocate-copy-free.
+struct CountingMappedAllocator : MappedAllocator
+{
+    static inline usize s_Allocations   = 0;
+    static inline usize s_Reallocations = 0;
+
+    void* Allocate(const usize size, const usize alignment)
+    {
+        ++s_Allocations;
+        return MappedAllocator::Allocate(size, alignment);
+    }
+    void* Reallocate(void* ptr, const usize oldSize, const usize newSize, const usize alignment)
+    {
+        ++s_Reallocations;
+        return MappedAllocator::Reallocate(ptr, oldSize, newSize, alignment);
+    }
+};
+#endif
+
+void TestMappedVec()
+{
+#if defined(__linux__)
+    // Grows a page-sized buffer to 16 MiB: after the first mapping every growth step has to go through mremap.
+    Vec<u64, CountingMappedAllocator> vec;
+    for (u64 i = 0; i < (1 << 21); ++i)
+        vec.Push(i * 0x9E3779B97F4A7C15ull);
+    assert(CountingMappedAllocator::s_Allocations == 1 && CountingMappedAllocator::s_Reallocations > 5);
+    for (u64 i = 0; i < vec.Size(); ++i)
+        assert(vec[i] == i * 0x9E3779B97F4A7C15ull);
+
+    vec.Resize(1000);
+    vec.ShrinkToFit();
+    assert(vec.Capacity() == 1000 && CountingMappedAllocator::s_Allocations == 1);
+    for (u64 i = 0; i < vec.Size(); ++i)
+        assert(vec[i] == i * 0x9E3779B97F4A7C15ull);
+
+    // Elements that are not trivially relocatable still take the allocate-relocate-free route.
+    MappedVec<std::string> strings;
+    for (usize i = 0; i < 5000; ++i)
+        strings.Push(std::to_string(i));
+    for (usize i = 0; i < strings.Size(); ++i)
+        assert(strings[i] == std::to_string(i));
+
+    MappedVec<u32> huge{ MappedAllocator(true) };
+    huge.Resize(1 << 20);
+    huge.Back() = 7;
+    assert(huge.Allocator().HugePages() && huge.Size() == (1 << 20) && huge.Front() == 0 && huge.Back() == 7);
+#endif
+}
+
+void TestSaveLoad()
+{
+    const char* path = "test_vec.bin";
+
+    Vec<u32> values;
+    for (u32 i = 0; i < 10000; ++i)
+        values.Push(i * 2654435761u);
+    SaveVec(values, path);
+    const Vec<u32> loaded = LoadVec<u32>(path);
+    assert(loaded.Size() == values.Size() && std::equal(values.begin(), values.end(), loaded.begin()));
+    assert(Throws<std::runtime_error>([&] { (void)LoadVec<u16>(path); }));
+
+    std::mt19937_64         rng(22);
+    const std::vector<bool> ref = RandomBits(1000, rng);
+    SaveVec(ToBitVec(ref), path);
+    assert(SameBits(LoadVec<bool>(path), ref));
+    SaveVec(Vec<u64>(), path);
+    assert(LoadVec<u64>(path).Empty());
+
+#if defined(__linux__)
+    // Saving over a file that is still mapped replaces it, the view keeps reading the old contents.
+    SaveVec(values, path);
+    {
+        const FileView<u32> view(path);
+        SaveVec(Vec<u32>{ 1, 2, 3 }, path);
+        assert(view.Size() == values.Size() && view.Verify() && view[25] == values[25]);
+        assert(std::equal(values.begin(), values.end(), view.begin()));
+        assert(FileView<u32>(path).Size() == 3);
+    }
+    SaveVec(ToBitVec(ref), path);
+    assert(SameBits(FileView<bool>(path).ToVec(), ref));
+#endif
+
+    // Flip one payload byte, then cut the file short.
+    SaveVec(values, path);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(FileHeader::DataOffset + 100);
+        file.put(static_cast<char>(values.Data()[25] ^ 0xFF));
+    }
+    assert(Throws<std::runtime_error>([&] { (void)LoadVec<u32>(path); }));
+#if defined(__linux__)
+    assert(!FileView<u32>(path).Verify());
+#endif
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write("VEC", 3);
+    }
+    assert(Throws<std::runtime_error>([&] { (void)LoadVec<u32>(path); }));
+    std::remove(path);
+    assert(Throws<std::runtime_error>([&] { (void)LoadVec<u32>(path); }));
+    assert(Throws<std::runtime_error>([&] { SaveVec(values, "no_such_directory/test_vec.bin"); }));
+}
+
+void TestStreams()
+{
+    Vec<u32> values;
+    for (u32 i = 0; i < 10000; ++i)
+        values.Push(i * 2654435761u);
+    std::mt19937_64         rng(23);
+    const std::vector<bool> ref = RandomBits(1000, rng);
+
+    // Small chunks so that the stream holds several of them plus a partial one.
+    std::stringstream stream;
+    WriteVec(values, stream, 1000);
+    const Vec<u32> read = ReadVec<u32>(stream);
+    assert(read.Size() == values.Size() && std::equal(values.begin(), values.end(), read.begin()));
+    stream.str({});
+    WriteVec(ToBitVec(ref), stream, 64);
+    assert(SameBits(ReadVec<bool>(stream), ref));
+    stream.str({});
+    WriteVec(Vec<u32>(), stream);
+    assert(ReadVec<u32>(stream).Empty());
+
+    stream.str({});
+    WriteVec(values, stream, 1000);
+    const std::string bytes = stream.str();
+    std::string       corrupted(bytes);
+    corrupted[corrupted.size() / 2] ^= 0x40;
+    std::stringstream damaged(corrupted);
+    assert(Throws<std::runtime_error>([&] { (void)ReadVec<u32>(damaged); }));
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 10));
+    assert(Throws<std::runtime_error>([&] { (void)ReadVec<u32>(truncated); }));
+    std::stringstream wrongType(bytes);
+    assert(Throws<std::runtime_error>([&] { (void)ReadVec<u64>(wrongType); }));
+
+    // A chunk claiming far more data than the stream holds has to fail at the read, not at a terabyte allocation.
+    const auto claim = [](const u32 elementSize, const u64 count, const u64 bytes)
+    {
+        StreamHeader header;
+        std::memcpy(header.m_Magic, StreamHeader::Magic, sizeof(StreamHeader::Magic));
+        header.m_Version     = StreamHeader::Version;
+        header.m_ElementSize = elementSize;
+        const ChunkHeader chunk{ count, bytes, 0 };
+        std::string       text(reinterpret_cast<const char*>(&header), sizeof(header));
+        text.append(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+        return std::stringstream(text + std::string(4096, '\0'));
+    };
+    std::stringstream huge = claim(sizeof(u32), u64(1) << 40, (u64(1) << 40) * sizeof(u32));
+    assert(Throws<std::runtime_error>([&] { (void)ReadVec<u32>(huge); }));
+    std::stringstream hugeBits = claim(FileHeader::Bits, u64(1) << 50, (u64(1) << 50) / 8);
+    assert(Throws<std::runtime_error>([&] { (void)ReadVec<bool>(hugeBits); }));
+}
+
+template <typename T>
+void TestTextFor(std::mt19937_64& rng)
+{
+    for (const usize size : { 0, 1, 2, 1024, 3000 })
+    {
+        Vec<T> vec;
+        for (usize i = 0; i < size; ++i)
+        {
+            const u64 pick = rng() % 8;
+            if (pick == 0)
+                vec.Push(std::numeric_limits<T>::lowest());
+            else if (pick == 1)
+                vec.Push(std::numeric_limits<T>::max());
+            else if constexpr (std::is_floating_point_v<T>)
+                vec.Push(pick == 2 ? std::numeric_limits<T>::denorm_min() : static_cast<T>(rng()) / T(7) - T(1e9));
+            else
+                vec.Push(static_cast<T>(rng()));
+        }
+        for (const char delimiter : { ',', ';', '\n' })
+        {
+            const Vec<char> text = ToChars(vec, delimiter);
+            assert(std::count(text.begin(), text.end(), delimiter) == static_cast<std::ptrdiff_t>(size ? size - 1 : 0));
+            const Vec<T> parsed = FromChars<T>(text.Data(), text.Data() + text.Size(), delimiter);
+            assert(parsed.Size() == size && std::equal(vec.begin(), vec.end(), parsed.begin()));
+        }
+    }
+
+    const auto parse = [](const std::string_view text) { return FromChars<T>(text.data(), text.data() + text.size()); };
+    const Vec<T> spaced = parse(" 1 ,\t2\n,3");
+    assert(spaced.Size() == 3 && spaced[0] == T(1) && spaced[1] == T(2) && spaced[2] == T(3));
+    assert(parse("").Empty() && parse(" \n\t ").Empty());
+    for (const std::string_view bad : { "1,,2", "1,", ",1", "1 2", "x", "1,2x", "0x10" })
+        assert(Throws<std::invalid_argument>([&] { (void)parse(bad); }));
+    if constexpr (std::is_integral_v<T>)
+    {
+        assert(Throws<std::out_of_range>([&] { (void)parse("1,99999999999999999999999"); }));
+        if constexpr (std::is_unsigned_v<T>)
+            assert(Throws<std::invalid_argument>([&] { (void)parse("-1"); }));
+    }
+}
+
+void TestText()
+{
+    std::mt19937_64 rng(24);
+    ForEachSimdLevel(
+        [&]
+        {
+            TestTextFor<i8>(rng);
+            TestTextFor<u8>(rng);
+            TestTextFor<i32>(rng);
+            TestTextFor<u32>(rng);
+            TestTextFor<i64>(rng);
+            TestTextFor<u64>(rng);
+            TestTextFor<f32>(rng);
+            TestTextFor<f64>(rng);
+
+            for (const usize size : { 0, 1, 63, 64, 65, 1000 })
+            {
+                const std::vector<bool> ref = RandomBits(size, rng);
+                const std::string       text = ToBitVec(ref).ToString();
+                assert(text.size() == size);
+                for (usize i = 0; i < size; ++i)
+                    assert(text[i] == (ref[i] ? '1' : '0'));
+                assert(SameBits(Vec<bool>::FromString(text), ref));
+                if (size > 0)
+                {
+                    std::string bad = text;
+                    bad[size / 2]   = '2';
+                    assert(Throws<std::invalid_argument>([&] { (void)Vec<bool>::FromString(bad); }));
+                }
+            }
+        });
+}
+
+void TestConcurrentVec()
+{
+    // Producers push single elements and batches while a reader keeps checking the committed prefix.
+    constexpr usize    threadCount = 4, perThread = 50000, batch = 100;
+    ConcurrentVec<u64> vec;
+    std::atomic<bool>  done = false;
+    std::thread        reader(
+        [&]
+        {
+            usize last = 0;
+            while (!done.load())
+            {
+                const usize size = vec.Size();
+                assert(size >= last && size <= vec.ReservedSize());
+                for (usize i = last; i < size; ++i)
+                    assert(vec[i] < threadCount * perThread);
+                last = size;
+            }
+        });
+    std::vector<std::thread>           producers;
+    std::vector<std::pair<usize, u64>> placed[threadCount];
+    for (usize t = 0; t < threadCount; ++t)
+    {
+        producers.emplace_back(
+            [&, t]
+            {
+                const u64 base = t * perThread;
+                for (u64 i = 0; i < perThread / 2; ++i)
+                    placed[t].emplace_back(vec.PushBack(base + i), base + i);
+                u64 values[batch];
+                for (u64 i = perThread / 2; i < perThread; i += batch)
+                {
+                    std::iota(values, values + batch, base + i);
+                    placed[t].emplace_back(vec.PushBatch(values, batch), base + i);
+                }
+            });
     }
-    inline BitRef Back()
+    for (std::thread& producer : producers)
+        producer.join();
+    done = true;
+    reader.join();
+
+    assert(vec.Size() == threadCount * perThread && vec.ReservedSize() == vec.Size());
+    for (usize t = 0; t < threadCount; ++t)
+        for (const auto& [index, value] : placed[t])
+            assert(vec[index] == value);
+    Vec<u64> values = vec.ToVec();
+    std::sort(values.begin(), values.end());
+    for (usize i = 0; i < values.Size(); ++i)
+        assert(values[i] == i);
+    vec.Clear();
+    assert(vec.Empty() && Throws<std::out_of_range>([&] { (void)vec.At(0); }));
+    vec.PushBack(7);
+    assert(vec.Size() == 1 && vec.At(0) == 7);
+
+    // A push whose constructor throws leaves its slot unpublished, and the committed prefix stops in front of it.
     {
-        if (m_Size > 0)
-            return this->operator[](m_Size - 1);
-        else
-            throw std::out_of_range("Tried calling Back() on an empty vector.");
+        ConcurrentVec<ThrowingCopy> throwing;
+        const ThrowingCopy          value(5);
+        ThrowingCopy::s_CopyBudget = 2;
+        throwing.PushBack(value);
+        throwing.PushBack(value);
+        assert(Throws<std::bad_alloc>([&] { throwing.PushBack(value); }));
+        ThrowingCopy::s_CopyBudget = 1;
+        throwing.PushBack(value);
+        assert(throwing.Size() == 2 && throwing.ReservedSize() == 4 && throwing[1].m_Value == 5);
     }
-    inline const BitRef Back() const
+    assert(ThrowingCopy::s_Live == 0);
+}
+
+template <typename TAlloc>
+u64 BuildRequest(const TAlloc& alloc)
+{
+    u64 checksum = 0;
+    for (u32 v = 0; v < 500; ++v)
     {
-        if (m_Size > 0)
-            return this->operator[](m_Size - 1);
-        else
-            throw std::out_of_range("Tried calling Back() on an empty vector.");
+        Vec<u32, TAlloc> vec(alloc);
+        for (u32 i = 0; i < 24; ++i)
+            vec.Push(i * v);
+        checksum += vec.Back();
     }
-    inline BitRef At(const usize index)
+    return checksum;
+}
+
+void BenchAllocators()
+{
+    using Clock              = std::chrono::steady_clock;
+    constexpr usize requests = 2000;
+    u64             sink     = 0;
+
+    Vec<u32>::ResetAllocCount();
+    auto start = Clock::now();
+    for (usize r = 0; r < requests; ++r)
+        sink += BuildRequest(HeapAllocator());
+    auto elapsed = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+    std::cout << "heap:  " << elapsed << " ms, " << Vec<u32>::AllocCount() << " heap allocations" << std::endl;
+
+    MonotonicArena arena;
+    Vec<u32, ArenaAllocator>::ResetAllocCount();
+    start = Clock::now();
+    for (usize r = 0; r < requests; ++r)
     {
-        if (m_Size - 1 >= index)
-            return this->operator[](index);
-        else
-            throw std::out_of_range("Index out of bounds.");
+        sink += BuildRequest(ArenaAllocator(arena));
+        arena.Reset();
     }
-    inline const BitRef At(const usize index) const
+    elapsed = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+    std::cout << "arena: " << elapsed << " ms, " << Vec<u32, ArenaAllocator>::AllocCount() << " buffers, "
+              << arena.HeapAllocCount() << " heap allocations" << std::endl;
+
+    FixedPool pool(48 * sizeof(u32));
+    Vec<u32, PoolAllocator>::ResetAllocCount();
+    start = Clock::now();
+    for (usize r = 0; r < requests; ++r)
+        sink += BuildRequest(PoolAllocator(pool));
+    elapsed = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+    std::cout << "pool:  " << elapsed << " ms, " << Vec<u32, PoolAllocator>::AllocCount() << " buffers, "
+              << pool.HeapAllocCount() << " heap allocations" << std::endl;
+
+    std::cout << "(checksum " << sink << ")" << std::endl;
+}
+
+template <typename TVec>
+f64 TimeSmallPushes(const usize rounds, const usize count, u64& sink)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (usize r = 0; r < rounds; ++r)
     {
-        if (m_Size - 1 >= index)
-            return this->operator[](index);
-        else
-            throw std::out_of_range("Index out of bounds.");
+        TVec vec;
+        for (usize i = 0; i < count; ++i)
+            vec.Push(static_cast<u32>(r + i));
+        sink += vec[count / 2];
     }
-    constexpr void Swap(Vec<bool>& other)
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename TVec>
+f64 TimeSmallCopies(const usize rounds, const usize count, u64& sink)
+{
+    TVec source;
+    for (usize i = 0; i < count; ++i)
+        source.Push(static_cast<u32>(i));
+
+    const auto start = std::chrono::steady_clock::now();
+    for (usize r = 0; r < rounds; ++r)
     {
-        std::swap(m_Size, other.m_Size);
-        std::swap(m_Capacity, other.m_Capacity);
-        std::swap(m_Buffer, other.m_Buffer);
+        TVec copy = source;
+        sink += copy[r % count];
     }
-    inline void    Resize(const usize newSize) { Realloc(newSize); }
-    constexpr void Reserve(const usize newCapacity)
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchSmallVec()
+{
+    constexpr usize rounds = 2'000'000;
+    u64             sink   = 0;
+    for (const usize count : { 4, 8, 16 })
     {
-        if (newCapacity > m_Capacity)
-        {
-            const usize prev_capacity = m_Capacity;
-            m_Capacity                = newCapacity;
-            BufferType* temp          = m_Buffer;
-            m_Buffer                  = new BufferType[m_Capacity];
-            std::memcpy(m_Buffer, temp, (prev_capacity / BitSize) * sizeof(BufferType));
-            delete[] temp;
-        }
+        std::cout << count << " elements:" << std::endl;
+        std::cout << "  push  Vec<u32>:          " << TimeSmallPushes<Vec<u32>>(rounds, count, sink) << " ms"
+                  << std::endl;
+        std::cout << "  push  SmallVec<u32, 16>: " << TimeSmallPushes<SmallVec<u32, 16>>(rounds, count, sink)
+                  << " ms" << std::endl;
+        std::cout << "  copy  Vec<u32>:          " << TimeSmallCopies<Vec<u32>>(rounds, count, sink) << " ms"
+                  << std::endl;
+        std::cout << "  copy  SmallVec<u32, 16>: " << TimeSmallCopies<SmallVec<u32, 16>>(rounds, count, sink)
+                  << " ms" << std::endl;
     }
-    inline std::string ToString() const noexcept
+    std::cout << "(checksum " << sink << ")" << std::endl;
+}
+
+template <typename T>
+void BenchSortKeys(const char* name, const usize maxSize)
+{
+    std::mt19937_64 rng(42);
+    for (usize size = 1000; size <= maxSize; size *= 10)
     {
-        std::string str;
-        str.resize(m_Size);
-        for (usize i = 0; i < m_Size; ++i)
-            str[i] = 48 + BitAt(i);
-        return str;
+        Vec<T> keys;
+        keys.Reserve(size);
+        for (usize i = 0; i < size; ++i)
+            keys.Push(static_cast<T>(rng()));
+        Vec<T> copy = keys;
+
+        auto start = std::chrono::steady_clock::now();
+        keys.Sort();
+        const f64 radixMs = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        std::sort(copy.begin(), copy.end());
+        const f64 stdMs = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << name << " x " << size << ": Sort() " << radixMs << " ms, std::sort " << stdMs << " ms"
+                  << (std::equal(keys.begin(), keys.end(), copy.begin()) ? "" : " (MISMATCH)") << std::endl;
     }
-    inline void Flip() noexcept
+}
+
+void BenchSort(const usize maxSize = 100'000'000)
+{
+    BenchSortKeys<u32>("u32", maxSize);
+    BenchSortKeys<u64>("u64", maxSize);
+    BenchSortKeys<i32>("i32", maxSize);
+}
+
+template <typename TFn>
+f64 TimeMs(TFn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchParallel(const usize size = 50'000'000)
+{
+    Vec<u64> source;
+    source.Reserve(size);
+    std::mt19937_64 rng(7);
+    for (usize i = 0; i < size; ++i)
+        source.Push(rng());
+
+    u64 sink = 0;
+    for (usize threads = 1; threads <= std::max<usize>(std::thread::hardware_concurrency(), 1); threads *= 2)
     {
-        for (auto b : *this)
-            b.Flip();
+        ThreadPool pool(threads - 1);
+        Vec<u64>   vec = source;
+        const f64  forEachMs = TimeMs([&] { vec.ParallelForEach([](u64& e) { e = e * 2654435761u + 1; }, pool); });
+        const f64  transformMs =
+            TimeMs([&] { sink += vec.ParallelTransform([](const u64 e) { return e >> 3; }, pool)[size / 2]; });
+        const f64 reduceMs = TimeMs([&] { sink += vec.ParallelReduce(0, std::plus<>(), pool); });
+        const f64 sortMs   = TimeMs([&] { vec.ParallelSort(std::less<>(), pool); });
+        const f64 fillMs   = TimeMs([&] { vec.ParallelFill(sink, pool); });
+
+        std::cout << threads << " threads: for-each " << forEachMs << " ms, transform " << transformMs
+                  << " ms, reduce " << reduceMs << " ms, sort " << sortMs << " ms, fill " << fillMs << " ms"
+                  << std::endl;
     }
-    inline bool Any() const noexcept
+    std::cout << "(checksum " << sink << ")" << std::endl;
+}
+
+void BenchBitCount()
+{
+    constexpr usize bits   = 1 << 26;
+    constexpr usize rounds = 20;
+    std::mt19937_64 rng(11);
+
+    auto              bitset = std::make_unique<std::bitset<bits>>();
+    std::vector<bool> stdVec(bits);
+    Vec<bool>         vec(bits);
+    for (usize i = 0; i < bits; ++i)
     {
-        for (const auto b : *this)
-            if (b)
-                return true;
-        return false;
+        const bool b = (rng() & 7) == 0;
+        (*bitset)[i] = b;
+        stdVec[i]    = b;
+        vec[i]       = b;
     }
-    inline usize Count() const noexcept
+
+    usize sink = 0;
+    std::cout << "Count() over " << bits << " bits:" << std::endl;
+    std::cout << "  std::bitset:       " << TimeMs([&] { for (usize r = 0; r < rounds; ++r) sink += bitset->count(); })
+              << " ms" << std::endl;
+    std::cout << "  std::vector<bool>: "
+              << TimeMs([&] { for (usize r = 0; r < rounds; ++r) sink += std::count(stdVec.begin(), stdVec.end(), true); })
+              << " ms" << std::endl;
+    std::cout << "  Vec<bool>:         " << TimeMs([&] { for (usize r = 0; r < rounds; ++r) sink += vec.Count(); })
+              << " ms" << std::endl;
+
+    // An all-zero set forces Any()/None() to look at every word.
+    bitset->reset();
+    vec.Reset();
+    std::cout << "Any() over " << bits << " zero bits:" << std::endl;
+    std::cout << "  std::bitset:       " << TimeMs([&] { for (usize r = 0; r < rounds; ++r) sink += bitset->any(); })
+              << " ms" << std::endl;
+    std::cout << "  Vec<bool>:         " << TimeMs([&] { for (usize r = 0; r < rounds; ++r) sink += vec.Any(); })
+              << " ms" << std::endl;
+    std::cout << "(checksum " << sink << ")" << std::endl;
+}
+
+void BenchShift()
+{
+    constexpr usize bits   = 1 << 24;
+    constexpr usize rounds = 50;
+    std::mt19937_64 rng(13);
+
+    auto      bitset = std::make_unique<std::bitset<bits>>();
+    Vec<bool> vec(bits);
+    for (usize i = 0; i < bits; ++i)
     {
-        usize count = 0;
-        for (const auto b : *this)
-            count = (b) ? ++count : count;
-        return count;
+        const bool b = rng() & 1;
+        (*bitset)[i] = b;
+        vec[i]       = b;
     }
-    constexpr void Clear() noexcept { m_Size = 0; }
-    constexpr void Reset() noexcept { std::memset(m_Buffer, 0, m_Capacity); }
 
-public:
-    friend std::ostream& operator<<(std::ostream& stream, const Vec<bool>& other) noexcept
+    usize sink = 0;
+    std::cout << "Shifts over " << bits << " bits, " << rounds << " rounds:" << std::endl;
+    for (const usize pos : { usize{ 1 }, usize{ 37 }, usize{ 64 }, usize{ 1000003 } })
     {
-        stream << "[ ";
-        const auto size = other.Size();
-        for (usize i = 0; i < size; ++i)
-        {
-            stream << ((other.m_Buffer[i / BitSize] >> ((BitSize - 1) - i % BitSize)) & 1);
-            if (i + 1 != size)
-                stream << ", ";
-        }
-        stream << " ]";
-        return stream;
+        const f64 bitsetMs = TimeMs(
+            [&]
+            {
+                for (usize r = 0; r < rounds; ++r)
+                {
+                    *bitset >>= pos;
+                    *bitset <<= pos;
+                }
+            });
+        const f64 vecMs = TimeMs(
+            [&]
+            {
+                for (usize r = 0; r < rounds; ++r)
+                {
+                    vec <<= pos;
+                    vec >>= pos;
+                }
+            });
+        const f64 rotateMs = TimeMs(
+            [&]
+            {
+                for (usize r = 0; r < rounds; ++r)
+                {
+                    vec.RotateLeft(pos);
+                    vec.RotateRight(pos);
+                }
+            });
+        sink += bitset->count() + vec.Count();
+        std::cout << "  by " << pos << ": std::bitset " << bitsetMs << " ms, Vec<bool> " << vecMs << " ms, rotate "
+                  << rotateMs << " ms" << std::endl;
     }
-};
+    std::cout << "(checksum " << sink << ")" << std::endl;
+}
 
-void TestVec()
+void BenchRankSelect()
 {
-    Vec<int> vec;
-    Vec<int> vec2 = { 5, 3, 1 };
-    for (usize i = 0; i < 9; ++i)
-        vec.Push(std::rand() % 256);
+    constexpr usize bits    = 1 << 26;
+    constexpr usize queries = 10'000'000;
+    std::mt19937_64 rng(17);
 
-    std::cout << "Initial vec: " << vec << std::endl;
-    std::cout << "Initial vec2: " << vec2 << std::endl;
+    Vec<bool> vec(bits);
+    for (usize i = 0; i < bits; ++i)
+        vec[i] = (rng() & 3) == 0;
+    // The directory is built lazily by the first query, so that is part of what gets timed.
+    usize     sink    = 0;
+    const f64 buildMs = TimeMs(
+        [&]
+        {
+            const RankSelect fresh(vec);
+            sink += fresh.MemoryBytes();
+        });
+    const RankSelect index(vec);
+    std::cout << "Index over " << bits << " bits: " << buildMs << " ms to build, "
+              << 100.0 * static_cast<f64>(index.MemoryBytes()) / (bits / 8) << "% overhead" << std::endl;
 
-    vec.Swap(vec2);
+    Vec<usize> positions;
+    positions.Reserve(queries);
+    for (usize q = 0; q < queries; ++q)
+        positions.Push(rng() % bits);
+    const usize ones = index.Rank1(bits);
 
-    std::cout << "\nAfter swap vec: " << vec << std::endl;
-    std::cout << "InAfter swap vec2: " << vec2 << std::endl;
+    const f64 rankMs = TimeMs(
+        [&]
+        {
+            for (const usize pos : positions)
+                sink += index.Rank1(pos);
+        });
+    const f64 selectMs = TimeMs(
+        [&]
+        {
+            for (const usize pos : positions)
+                sink += index.Select1(pos % ones);
+        });
+    const f64 select0Ms = TimeMs(
+        [&]
+        {
+            for (const usize pos : positions)
+                sink += index.Select0(pos % (bits - ones));
+        });
+    std::cout << "Rank1:   " << queries / rankMs / 1000.0 << " M queries/s" << std::endl;
+    std::cout << "Select1: " << queries / selectMs / 1000.0 << " M queries/s" << std::endl;
+    std::cout << "Select0: " << queries / select0Ms / 1000.0 << " M queries/s" << std::endl;
+    std::cout << "(checksum " << sink << ")" << std::endl;
+}
 
-    std::cout << "\nvec ptr: " << vec.Data() << std::endl;
+void BenchAtomicBits()
+{
+    constexpr usize bits      = 1 << 20;
+    constexpr usize perThread = 4'000'000;
 
-    vec.Clear();
-    std::cout << "\nAfter vec clear: " << vec << std::endl;
+    const auto run = [&](const usize threads, auto&& visit)
+    {
+        Vec<std::thread> workers;
+        return TimeMs(
+            [&]
+            {
+                for (usize t = 0; t < threads; ++t)
+                    workers.Push(std::thread(
+                        [&, t]
+                        {
+                            std::mt19937_64 rng(t);
+                            for (usize i = 0; i < perThread; ++i)
+                                visit(rng() % bits);
+                        }));
+                for (auto& worker : workers)
+                    worker.join();
+            });
+    };
 
-    vec = { 1, 5, 10, 9 };
-    std::cout << "\nInit cap: " << vec.Capacity() << std::endl;
-    vec.ShrinkToFit();
-    std::cout << "After cap: " << vec.Capacity() << std::endl;
+    for (usize threads = 1; threads <= std::max<usize>(std::thread::hardware_concurrency(), 1); threads *= 2)
+    {
+        AtomicBitVec<> relaxed(bits), ordered(bits);
+        Vec<bool>      locked(bits);
+        std::mutex     mutex;
 
-    std::cout << "\nBefore list assign: " << vec << std::endl;
-    vec.Assign({ 9, 10, 5, 1 });
-    std::cout << "After list assign: " << vec << std::endl;
+        const f64 relaxedMs = run(threads, [&](const usize i) { relaxed.TestAndSet(i, std::memory_order_relaxed); });
+        const f64 orderedMs = run(threads, [&](const usize i) { ordered.TestAndSet(i); });
+        const f64 lockedMs  = run(threads,
+                                  [&](const usize i)
+                                  {
+                                      std::lock_guard lock(mutex);
+                                      locked[i] = true;
+                                  });
+        std::cout << threads << " threads: relaxed " << relaxedMs << " ms, acq_rel " << orderedMs
+                  << " ms, mutex + Vec<bool> " << lockedMs << " ms (" << relaxed.Count() << " bits set)" << std::endl;
+    }
+}
 
-    std::cout << "\nBefore vec assign: " << vec << std::endl;
-    vec2 = { 5, 1, 6, 10, 8 };
-    std::cout << "vec2: " << vec2 << std::endl;
-    vec.Assign(vec2.begin() + 2, vec2.end() - 1);
-    std::cout << "After vec assign: " << vec << std::endl;
+void BenchCompressedBitmap()
+{
+    constexpr usize bits   = 1 << 26;
+    constexpr usize rounds = 20;
 
-    vec.Insert(vec.end(), 88);
-    std::cout << "\nAfter insert: ";
-    std::cout << vec << std::endl;
-    vec.Clear();
-    vec.ShrinkToFit();
-    vec.Assign({ 1, 5, 10, 99, 199 });
-    std::cout << "\nAfter total reset: " << vec << std::endl;
+    std::mt19937_64 rng(42);
+    const auto      make = [&](const char* shape)
+    {
+        Vec<bool> vec(bits);
+        if (shape[0] == 's')
+            for (usize i = 0; i < bits / 1000; ++i)
+                vec[rng() % bits] = true;
+        else if (shape[0] == 'r')
+            for (usize i = 0; i < 2000; ++i)
+            {
+                const usize first = rng() % bits;
+                vec.SetRange(first, std::min(bits, first + rng() % 8192));
+            }
+        else
+            for (usize i = 0; i < bits / 2; ++i)
+                vec[rng() % bits] = true;
+        return vec;
+    };
 
-    vec.Resize(vec.Size() / 2);
-    std::cout << "\nAfter resize: " << vec << std::endl;
+    for (const char* shape : { "sparse", "runs", "dense" })
+    {
+        const Vec<bool>        lhv = make(shape), rhv = make(shape);
+        const CompressedBitmap lhvPacked = CompressedBitmap::FromVec(lhv), rhvPacked = CompressedBitmap::FromVec(rhv);
 
-    std::cout << "\nvec2: " << vec2 << std::endl;
-    vec << vec2;
-    std::cout << "After merge: " << vec << std::endl;
+        usize      sink = 0;
+        const auto time = [&](auto&& op)
+        {
+            return TimeMs(
+                [&]
+                {
+                    for (usize r = 0; r < rounds; ++r)
+                        sink += op();
+                });
+        };
+        std::cout << shape << " (" << lhv.Count() << " of " << bits << " bits):" << std::endl;
+        std::cout << "  memory:  Vec<bool> " << lhv.Capacity() / 8 << " B, compressed " << lhvPacked.MemoryBytes()
+                  << " B" << std::endl;
+        std::cout << "  and:     Vec<bool> " << time([&] { return (lhv & rhv).Count(); }) << " ms, compressed "
+                  << time([&] { return (lhvPacked & rhvPacked).Cardinality(); }) << " ms" << std::endl;
+        std::cout << "  or:      Vec<bool> " << time([&] { return (lhv | rhv).Count(); }) << " ms, compressed "
+                  << time([&] { return (lhvPacked | rhvPacked).Cardinality(); }) << " ms" << std::endl;
+        std::cout << "  xor:     Vec<bool> " << time([&] { return (lhv ^ rhv).Count(); }) << " ms, compressed "
+                  << time([&] { return (lhvPacked ^ rhvPacked).Cardinality(); }) << " ms" << std::endl;
+        std::cout << "  count:   Vec<bool> " << time([&] { return lhv.Count(); }) << " ms, compressed "
+                  << time([&] { return lhvPacked.Cardinality(); }) << " ms" << std::endl;
+        std::cout << "  iterate: Vec<bool> " << time([&] {
+            usize sum = 0;
+            lhv.ForEachSetBit([&](const usize i) { sum += i; });
+            return sum;
+        }) << " ms, compressed "
+                  << time([&] {
+                         usize sum = 0;
+                         lhvPacked.ForEachSetBit([&](const u32 i) { sum += i; });
+                         return sum;
+                     })
+                  << " ms (" << sink % 10 << ")" << std::endl;
+    }
+}
 
-    vec.Erase(vec.begin() + 3);
-    std::cout << "\nAfter erasing the third element: " << vec << std::endl;
-    vec.Erase(vec.begin() + 1, vec.begin() + 4);
-    std::cout << "After first elements: " << vec << std::endl;
+template <usize Bits>
+void BenchPackedVecWidth(const usize size)
+{
+    std::mt19937_64 rng(Bits);
+    Vec<u32>        codes;
+    codes.Reserve(size);
+    for (usize i = 0; i < size; ++i)
+        codes.Push(static_cast<u32>(rng() & simd::PackMask<Bits>));
+    Vec<usize> probes;
+    probes.Reserve(size);
+    for (usize i = 0; i < size; ++i)
+        probes.Push(rng() % size);
+
+    PackedVec<Bits> packed;
+    Vec<u32>        unpacked;
+    unpacked.Resize(size);
+    u64 sink = 0;
+
+    const f64 packMs   = TimeMs([&] { packed = PackedVec<Bits>::FromVec(codes); });
+    const f64 unpackMs = TimeMs([&] { packed.CopyTo(unpacked.Data()); });
+    const f64 loopMs   = TimeMs(
+        [&]
+        {
+            for (usize i = 0; i < size; ++i)
+                unpacked[i] = packed[i];
+        });
+    const f64 randomMs = TimeMs(
+        [&]
+        {
+            for (const usize i : probes)
+                sink += packed[i];
+        });
+    const f64 plainMs = TimeMs(
+        [&]
+        {
+            for (const usize i : probes)
+                sink += codes[i];
+        });
+    const f64 ratio = static_cast<f64>(codes.Capacity() * sizeof(u32)) / static_cast<f64>(packed.MemoryBytes());
+    std::cout << Bits << " bits: " << ratio << "x smaller, pack "
+              << packMs << " ms, unpack " << unpackMs << " ms (per-element loop " << loopMs << " ms), random reads "
+              << randomMs << " ms vs Vec<u32> " << plainMs << " ms (" << sink % 10 << ")" << std::endl;
+}
+
+void BenchPackedVec(const usize size = 50'000'000)
+{
+    BenchPackedVecWidth<3>(size);
+    BenchPackedVecWidth<7>(size);
+    BenchPackedVecWidth<12>(size);
+    BenchPackedVecWidth<20>(size);
+}
+
+void BenchFilter(const usize size = 50'000'000)
+{
+    std::mt19937_64 rng(7);
+    Vec<i32>        column;
+    column.Reserve(size);
+    for (usize i = 0; i < size; ++i)
+        column.Push(static_cast<i32>(rng() % 1000));
 
-    decltype(vec[0]) max = vec[0];
-    for (const auto& e : vec)
+    Vec<bool> mask;
+    Vec<i32>  selected, branchy;
+    branchy.Reserve(size);
+    for (const i32 threshold : { 10, 500, 990 })
     {
-        if (e > max)
-            max = e;
+        const f64 compareMs = TimeMs([&] { CompareInto<simd::CmpOp::Less>(column, threshold, mask); });
+        const f64 compactMs = TimeMs([&] { CompactInto(column, mask, selected); });
+        const f64 loopMs    = TimeMs(
+            [&]
+            {
+                branchy.Clear();
+                for (const i32 e : column)
+                    if (e < threshold)
+                        branchy.Push(e);
+            });
+        std::cout << "x < " << threshold << " (" << selected.Size() << " selected): compare " << compareMs
+                  << " ms + compact " << compactMs << " ms, branchy loop " << loopMs << " ms" << std::endl;
     }
-    std::cout << "\nMax is: " << max << std::endl;
+}
 
-    std::cout << "\nvec: " << vec << std::endl;
-    std::cout << "vec2: " << vec2 << std::endl;
-    vec2 = vec;
-    vec  = { 1, 1, 1, 1 };
-    std::cout << "vec2 after copy assigning to: " << vec2 << std::endl;
-    std::cout << "vec: " << vec << std::endl;
-    vec = std::move(vec2);
-    std::cout << "vec2 after move assign: " << vec2 << std::endl;
-    std::cout << "vec: " << vec << std::endl;
+template <typename T>
+void BenchTextOf(const char* name, const Vec<T>& vec)
+{
+    Vec<char>          chars;
+    Vec<T>             parsed;
+    std::ostringstream stream;
+    const f64          streamMs = TimeMs(
+        [&]
+        {
+            for (const T e : vec)
+                stream << e << ',';
+        });
+    const f64 formatMs = TimeMs([&] { ToCharsInto(vec, chars); });
+    const f64 parseMs  = TimeMs([&] { FromCharsInto(chars.Data(), chars.Data() + chars.Size(), parsed); });
+    const f64 mib      = f64(chars.Size()) / (1024 * 1024);
+    std::cout << name << ": ostream " << mib / streamMs * 1000 << " MiB/s, ToChars " << mib / formatMs * 1000
+              << " MiB/s, FromChars " << mib / parseMs * 1000 << " MiB/s" << std::endl;
+}
 
-    vec2 = { 5, 5, 1, 6, 7 };
-    std::cout << "\nvec: " << vec << std::endl;
-    std::cout << "vec2: " << vec2 << std::endl;
-    vec.Insert(vec.begin() + 1, vec2.begin() + 1, vec2.begin() + 3);
-    std::cout << "vec after inserting vec2's range (at 1 range: 2..5): " << vec << std::endl;
+void BenchText(const usize size = 10'000'000)
+{
+    std::mt19937_64 rng(11);
+    Vec<u32>        small;
+    Vec<u64>        large;
+    Vec<f64>        reals;
+    for (usize i = 0; i < size; ++i)
+    {
+        small.Push(static_cast<u32>(rng() % 100'000));
+        large.Push(rng());
+        reals.Push(static_cast<f64>(rng() % 1'000'000'000) / 1000);
+    }
+    BenchTextOf("u32 < 100000", small);
+    BenchTextOf("u64         ", large);
+    BenchTextOf("f64         ", reals);
+
+    Vec<bool> bits;
+    for (usize i = 0; i < size * 8; ++i)
+        bits.Push(rng() & 1);
+    std::string str;
+    const f64   loopMs = TimeMs(
+        [&]
+        {
+            str.resize(bits.Size());
+            for (usize i = 0; i < bits.Size(); ++i)
+                str[i] = bits[i] ? '1' : '0';
+        });
+    const f64 toMs   = TimeMs([&] { str = bits.ToString(); });
+    const f64 fromMs = TimeMs([&] { bits = Vec<bool>::FromString(str); });
+    const f64 mib    = f64(str.size()) / (1024 * 1024);
+    std::cout << "Vec<bool>   : per-bit loop " << mib / loopMs * 1000 << " MiB/s, ToString " << mib / toMs * 1000
+              << " MiB/s, FromString " << mib / fromMs * 1000 << " MiB/s" << std::endl;
 }
 
-void TestBitset()
+#if defined(__linux__)
+// Reads a "Key:   123 kB" line of /proc/self/status, in bytes.
+usize ProcStatusBytes(const char* key)
 {
-    Vec<bool> vec  = { 1, 0, 1, 0, 0, 1, 1, 0, 0 };
-    Vec<bool> vec1 = { 1, 1, 1, 0, 0, 1, 1, 0, 1 };
-    vec << vec1;
-    std::cout << vec.ToString() << std::endl;
-    vec <<= 3;
-    std::cout << vec.ToString() << std::endl;
-    vec >>= 1;
-    std::cout << vec.ToString() << std::endl;
+    std::ifstream status("/proc/self/status");
+    std::string   line;
+    while (std::getline(status, line))
+        if (line.starts_with(key))
+            return std::strtoull(line.c_str() + std::strlen(key), nullptr, 10) * 1024;
+    return 0;
+}
+
+// Times pushing size elements one by one and reports how far the resident set peaked above where it started.
+// Writing 5 to clear_refs resets VmHWM, the peak, to the current resident set size.
+template <typename TVec>
+void BenchGrowth(const char* name, const usize size, TVec vec)
+{
+    std::ofstream("/proc/self/clear_refs") << "5";
+    const usize before = ProcStatusBytes("VmRSS:");
+    u64         sink   = 0;
+    const f64   ms     = TimeMs(
+        [&]
+        {
+            for (usize i = 0; i < size; ++i)
+                vec.Push(i);
+            sink += vec[size / 2];
+        });
+    const usize peak = ProcStatusBytes("VmHWM:") - before;
+    std::cout << name << ": " << ms << " ms, peak RSS +" << peak / (1024 * 1024) << " MiB for "
+              << size * sizeof(u64) / (1024 * 1024) << " MiB of data (" << sink % 10 << ")" << std::endl;
+}
+
+void BenchMappedVec(const usize size = 1 << 27)
+{
+    BenchGrowth("Vec<u64>                 ", size, Vec<u64>());
+    BenchGrowth("MappedVec<u64>           ", size, MappedVec<u64>());
+    BenchGrowth("MappedVec<u64>, huge pages", size, MappedVec<u64>(MappedAllocator(true)));
+}
+
+// Writes back and drops a file's pages from the page cache, so that the next open reads from the disk like the first
+// one after a reboot.
+void EvictFromPageCache(const char* path)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+// Cold-start cost of getting a saved lookup table into a process: reading and verifying it up front against mapping
+// it and touching only what is used.
+void BenchFileView(const usize size = 1 << 26, const char* path = "bench_vec.bin")
+{
+    Vec<u64> table;
+    table.Reserve(size);
+    for (usize i = 0; i < size; ++i)
+        table.Push(i * 0x9E3779B97F4A7C15);
+    SaveVec(table, path);
+    table.Clear();
+
+    std::mt19937_64 rng(42);
+    Vec<usize>      probes;
+    for (usize i = 0; i < 1000; ++i)
+        probes.Push(rng() % size);
+
+    u64        sink = 0;
+    const auto cold = [&](const char* name, auto&& load)
+    {
+        EvictFromPageCache(path);
+        std::cout << name << ": " << TimeMs(load) << " ms" << std::endl;
+    };
+    cold("LoadVec (read + checksum)      ", [&] { sink += LoadVec<u64>(path)[size / 2]; });
+    cold("FileView open                  ", [&] { sink += FileView<u64>(path).Size(); });
+    cold("FileView open + 1000 lookups   ",
+         [&]
+         {
+             FileView<u64> view(path);
+             for (const usize i : probes)
+                 sink += view[i];
+         });
+    cold("FileView open + Verify         ", [&] { sink += FileView<u64>(path).Verify(); });
+    cold("FileView open + ToVec          ", [&] { sink += FileView<u64>(path).ToVec()[size / 2]; });
+    std::cout << "(" << sink % 10 << ")" << std::endl;
+    std::remove(path);
+}
+
+// Dumping a vector to disk, timed until the data is on the disk rather than in the page cache: the text operator<<
+// against one raw write of the buffer, the chunked and checksummed WriteVec(), and a producer that generates its
+// elements on the fly through a ChunkWriter, whose peak memory stays at two chunk buffers.
+void BenchStreaming(const usize size = 1 << 26, const char* path = "bench_stream.bin")
+{
+    Vec<u64> vec;
+    vec.Reserve(size);
+    for (usize i = 0; i < size; ++i)
+        vec.Push(i * 0x9E3779B97F4A7C15);
+
+    const f64  mib  = f64(size * sizeof(u64)) / (1024 * 1024);
+    const auto dump = [&](const char* name, const f64 share, auto&& write)
+    {
+        const f64 ms = TimeMs(
+            [&]
+            {
+                {
+                    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                    write(file);
+                }
+                EvictFromPageCache(path);
+            });
+        std::cout << name << ": " << ms << " ms, " << mib * share / ms * 1000 << " MiB/s" << std::endl;
+    };
+    // Text is so much slower that a sixteenth of the vector is plenty to measure it.
+    Vec<u64> slice;
+    slice.Assign(vec.cbegin(), vec.cbegin() + size / 16);
+    dump("operator<< (1/16 of the data)", 1.0 / 16, [&](std::ostream& file) { file << slice; });
+    dump("ostream::write               ", 1,
+         [&](std::ostream& file) { file.write(reinterpret_cast<const char*>(vec.Data()), size * sizeof(u64)); });
+    dump("WriteVec                     ", 1, [&](std::ostream& file) { WriteVec(vec, file); });
+    vec   = Vec<u64>();
+    slice = Vec<u64>();
+
+    std::ofstream("/proc/self/clear_refs") << "5";
+    const usize before = ProcStatusBytes("VmRSS:");
+    dump("ChunkWriter::Push, generated ", 1,
+         [&](std::ostream& file)
+         {
+             ChunkWriter<u64> writer(file);
+             for (usize i = 0; i < size; ++i)
+                 writer.Push(i * 0x9E3779B97F4A7C15);
+             writer.Finish();
+         });
+    std::cout << "  peak RSS +" << (ProcStatusBytes("VmHWM:") - before) / (1024 * 1024) << " MiB" << std::endl;
+
+    EvictFromPageCache(path);
+    u64       sink = 0;
+    const f64 ms   = TimeMs(
+        [&]
+        {
+            std::ifstream file(path, std::ios::binary);
+            sink += ReadVec<u64>(file)[size / 2];
+        });
+    std::cout << "ReadVec, cold                : " << ms << " ms, " << mib / ms * 1000 << " MiB/s (" << sink % 10
+              << ")" << std::endl;
+    std::remove(path);
+}
+#endif
+
+// Producer scaling of one shared result set: a mutex around Vec::Push, whose reallocations stall every producer,
+// against ConcurrentVec pushing one element at a time and in batches.
+void BenchConcurrentVec(const usize perThread = 5'000'000)
+{
+    constexpr usize batch = 256;
+
+    const auto run = [&](const usize threads, auto&& produce)
+    {
+        Vec<std::thread> workers;
+        return TimeMs(
+            [&]
+            {
+                for (usize t = 0; t < threads; ++t)
+                    workers.Push(std::thread([&, t] { produce(t); }));
+                for (auto& worker : workers)
+                    worker.join();
+            });
+    };
+
+    for (usize threads = 1; threads <= std::max<usize>(std::thread::hardware_concurrency(), 1); threads *= 2)
+    {
+        Vec<u64>           locked;
+        std::mutex         mutex;
+        ConcurrentVec<u64> single, batched;
+
+        const f64 lockedMs = run(threads,
+                                 [&](const usize t)
+                                 {
+                                     for (usize i = 0; i < perThread; ++i)
+                                     {
+                                         std::lock_guard lock(mutex);
+                                         locked.Push(t * perThread + i);
+                                     }
+                                 });
+        const f64 singleMs = run(threads,
+                                 [&](const usize t)
+                                 {
+                                     for (usize i = 0; i < perThread; ++i)
+                                         single.PushBack(t * perThread + i);
+                                 });
+        const f64 batchedMs = run(threads,
+                                  [&](const usize t)
+                                  {
+                                      u64 buffer[batch];
+                                      for (usize i = 0; i < perThread; i += batch)
+                                      {
+                                          const usize count = std::min(batch, perThread - i);
+                                          for (usize j = 0; j < count; ++j)
+                                              buffer[j] = t * perThread + i + j;
+                                          batched.PushBatch(buffer, count);
+                                      }
+                                  });
+        const f64 total = f64(threads * perThread) / 1000;
+        std::cout << threads << " producers: mutex + Vec " << total / lockedMs << " M/s, PushBack " << total / singleMs
+                  << " M/s, PushBatch " << total / batchedMs << " M/s (" << single.Size() << " committed)"
+                  << std::endl;
+    }
 }
 
 int main()
@@ -1305,5 +8695,48 @@ int main()
     auto           d = 10;
     std::srand(std::time(nullptr));
 
+    TestInsertErase();
+    TestEmptyVec();
+    TestInsertExceptionSafety();
+    TestAllocators();
+    TestGrowthPolicies();
+    TestSmallVec();
+    TestInlineVec();
+    TestIterators();
+    TestSearchKernels();
+    TestRadixSort();
+    TestParallel();
+    TestBitCount();
+    TestBitwiseOps();
+    TestBitShifts();
+    TestBitSearch();
+    TestRankSelect();
+    TestBitRanges();
+    TestAtomicBitVec();
+    TestCompressedBitmap();
+    TestPackedVec();
+    TestFilterKernels();
+    TestMappedVec();
+    TestSaveLoad();
+    TestStreams();
+    TestText();
+    TestConcurrentVec();
+
     // TestVec();
+    // BenchAllocators();
+    // BenchSmallVec();
+    // BenchSort();
+    // BenchParallel();
+    // BenchBitCount();
+    // BenchShift();
+    // BenchRankSelect();
+    // BenchAtomicBits();
+    // BenchCompressedBitmap();
+    // BenchPackedVec();
+    // BenchFilter();
+    // BenchText();
+    // BenchMappedVec();
+    // BenchFileView();
+    // BenchStreaming();
+    // BenchConcurrentVec();
 }